@@ -0,0 +1,301 @@
+// Microbenchmark that drives HashMap directly, without the HTTP layer.
+//
+// The engine's policies are picked with the same options as the server, so
+// `make bench-run` can compare configurations from one binary.
+//
+// Usage: bench [--threads N] [--ops N] [--keys N] [--key-size B]
+//              [--value-size B] [--read-ratio R]
+//              [--dist uniform|zipf|hotspot] [--zipf-theta T]
+//              [--hot-fraction F] [--hot-prob P] [--seed N] [--csv]
+//              [--hash fnv|fnv-mixed] [--eviction lru|none]
+//              [--reclaim refcount|epoch] [--concurrency lockfree|striped]
+//              [--near-cache N] [--compress-threshold BYTES]
+//        bench --csv-header
+//
+// Latency is measured around each public call. Writes are queued, so write
+// latency is the cost of admission, not of applying them.
+
+#include "hash_map_rcu.h"
+#include "zipf.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+const char* const CSV_HEADER =
+    "engine,threads,keys,key_size,value_size,read_ratio,dist,ops,seconds,ops_per_sec,p50_us,p99_us,p999_us,misses,rejected";
+
+enum class Distribution { UNIFORM, ZIPF, HOTSPOT };
+
+struct BenchConfig {
+    size_t threads = 4;
+    size_t opsPerThread = 100000;
+    size_t keys = 10000;
+    size_t keySize = 16;
+    size_t valueSize = 100;
+    double readRatio = 0.9;
+    Distribution dist = Distribution::UNIFORM;
+    double zipfTheta = 0.99;
+    double hotFraction = 0.2;
+    double hotProb = 0.8;
+    uint64_t seed = 42;
+    bool csv = false;
+    size_t nearCache = 0;
+    size_t compressThreshold = 0;
+    EngineConfig engine;
+};
+
+enum class OpOutcome { HIT, MISS, REJECTED };
+
+static OpOutcome engineGet(HashMap& map, const std::string& key, std::string& value)
+{
+    switch (map.get(key, value)) {
+        case OpStatus::OK: return OpOutcome::HIT;
+        case OpStatus::NOT_FOUND: return OpOutcome::MISS;
+        default: return OpOutcome::REJECTED;
+    }
+}
+
+static OpOutcome engineSet(HashMap& map, const std::string& key, const std::string& value)
+{
+    return map.set(key, value) == OpStatus::OK ? OpOutcome::HIT : OpOutcome::REJECTED;
+}
+
+// Picks key indexes in [0, n). Zipfian makes index 0 the hottest key. Hotspot
+// sends hotProb of the operations to the first hotFraction of the keys,
+// uniformly within each set.
+class KeyChooser
+{
+    private:
+    const BenchConfig& config;
+    size_t n;
+    std::uniform_real_distribution<double> unit;
+    ZipfianGenerator zipf;
+    size_t hotKeys;
+
+    public:
+    KeyChooser(const BenchConfig& cfg, const ZipfianGenerator& zipf)
+        : config(cfg), n(cfg.keys), unit(0.0, 1.0), zipf(zipf),
+          hotKeys(std::max<size_t>(1, std::min(n, static_cast<size_t>(n * cfg.hotFraction))))
+    {
+    }
+
+    template <typename Rng>
+    size_t next(Rng& rng)
+    {
+        switch (config.dist) {
+            case Distribution::ZIPF:
+                return zipf.next(rng);
+            case Distribution::HOTSPOT: {
+                double u = unit(rng);
+                double v = unit(rng);
+                if (u < config.hotProb || hotKeys == n) return static_cast<size_t>(v * hotKeys) % hotKeys;
+                return hotKeys + static_cast<size_t>(v * (n - hotKeys)) % (n - hotKeys);
+            }
+            default:
+                return static_cast<size_t>(unit(rng) * n) % n;
+        }
+    }
+};
+
+struct ThreadResult {
+    std::vector<uint64_t> latenciesNs;
+    size_t reads = 0;
+    size_t writes = 0;
+    size_t misses = 0;
+    size_t rejected = 0;
+};
+
+static const char* distName(Distribution dist)
+{
+    switch (dist) {
+        case Distribution::ZIPF: return "zipf";
+        case Distribution::HOTSPOT: return "hotspot";
+        default: return "uniform";
+    }
+}
+
+// Keys are "k" plus the zero-padded index, padded out to keySize.
+static std::string makeKey(size_t index, size_t keySize)
+{
+    std::string digits = std::to_string(index);
+    std::string key = "k";
+    if (keySize > digits.size() + 1) key.append(keySize - digits.size() - 1, '0');
+    return key + digits;
+}
+
+static double percentileUs(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    return sorted[idx] / 1000.0;
+}
+
+static bool parseArgs(int argc, char* argv[], BenchConfig& config)
+{
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            config.threads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--ops") == 0 && hasValue) {
+            config.opsPerThread = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--keys") == 0 && hasValue) {
+            config.keys = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--key-size") == 0 && hasValue) {
+            config.keySize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--value-size") == 0 && hasValue) {
+            config.valueSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--read-ratio") == 0 && hasValue) {
+            config.readRatio = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--dist") == 0 && hasValue) {
+            std::string dist = argv[++i];
+            if (dist == "uniform") config.dist = Distribution::UNIFORM;
+            else if (dist == "zipf") config.dist = Distribution::ZIPF;
+            else if (dist == "hotspot") config.dist = Distribution::HOTSPOT;
+            else {
+                std::cerr << "Unknown distribution: " << dist << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--zipf-theta") == 0 && hasValue) {
+            config.zipfTheta = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--hot-fraction") == 0 && hasValue) {
+            config.hotFraction = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--hot-prob") == 0 && hasValue) {
+            config.hotProb = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+            config.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--near-cache") == 0 && hasValue) {
+            config.nearCache = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--compress-threshold") == 0 && hasValue) {
+            config.compressThreshold = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--csv") == 0) {
+            config.csv = true;
+        } else if (hasValue && config.engine.set(argv[i], argv[i + 1])) {
+            ++i;
+        } else {
+            std::cerr << "Unknown or incomplete option: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+    if (config.threads == 0 || config.keys == 0) {
+        std::cerr << "--threads and --keys must be positive" << std::endl;
+        return false;
+    }
+    if (config.dist == Distribution::ZIPF && (config.zipfTheta <= 0 || config.zipfTheta >= 1)) {
+        std::cerr << "--zipf-theta must be in (0, 1)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 2 && std::strcmp(argv[1], "--csv-header") == 0) {
+        std::cout << CSV_HEADER << std::endl;
+        return 0;
+    }
+
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config)) return 1;
+
+    // Built up front so the timed loop does not allocate keys or values.
+    std::vector<std::string> keys;
+    keys.reserve(config.keys);
+    for (size_t i = 0; i < config.keys; ++i) keys.push_back(makeKey(i, config.keySize));
+    const std::string value(config.valueSize, 'v');
+
+    // Only pays the O(keys) setup when the Zipfian distribution is used.
+    const ZipfianGenerator zipf(config.dist == Distribution::ZIPF ? config.keys : 1, config.zipfTheta);
+
+    std::vector<ThreadResult> results(config.threads);
+    double seconds = 0;
+    std::string engineName;
+    HashMap::BatchStats batch;
+    {
+        // No persistence file: the run starts empty and saves nothing.
+        std::unique_ptr<HashMap> engine = makeHashMap(config.engine, "");
+        HashMap& map = *engine;
+        map.enableNearCache(config.nearCache);
+        map.setCompressionThreshold(config.compressThreshold);
+        engineName = map.engine_name();
+        if (config.nearCache) engineName += "+near" + std::to_string(config.nearCache);
+        if (config.compressThreshold) engineName += "+compress" + std::to_string(config.compressThreshold);
+        for (const auto& key : keys) map.restore(key, value);
+
+        std::atomic<size_t> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < config.threads; ++t) {
+            threads.emplace_back([&, t] {
+                ThreadResult& result = results[t];
+                result.latenciesNs.reserve(config.opsPerThread);
+                std::mt19937_64 rng(config.seed + t);
+                std::uniform_real_distribution<double> unit(0.0, 1.0);
+                KeyChooser chooser(config, zipf);
+                std::string out;
+
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+
+                for (size_t i = 0; i < config.opsPerThread; ++i) {
+                    const std::string& key = keys[chooser.next(rng)];
+                    bool isRead = unit(rng) < config.readRatio;
+                    auto begin = std::chrono::steady_clock::now();
+                    OpOutcome outcome = isRead ? engineGet(map, key, out) : engineSet(map, key, value);
+                    auto end = std::chrono::steady_clock::now();
+                    result.latenciesNs.push_back(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+                    ++(isRead ? result.reads : result.writes);
+                    if (outcome == OpOutcome::MISS) ++result.misses;
+                    if (outcome == OpOutcome::REJECTED) ++result.rejected;
+                }
+            });
+        }
+
+        while (ready.load() < config.threads) std::this_thread::yield();
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& thread : threads) thread.join();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        batch = map.batchStats();
+    }
+
+    ThreadResult total;
+    for (auto& result : results) {
+        total.latenciesNs.insert(total.latenciesNs.end(), result.latenciesNs.begin(), result.latenciesNs.end());
+        total.reads += result.reads;
+        total.writes += result.writes;
+        total.misses += result.misses;
+        total.rejected += result.rejected;
+    }
+    std::sort(total.latenciesNs.begin(), total.latenciesNs.end());
+    size_t ops = total.reads + total.writes;
+    double throughput = seconds > 0 ? ops / seconds : 0;
+    double p50 = percentileUs(total.latenciesNs, 0.50);
+    double p99 = percentileUs(total.latenciesNs, 0.99);
+    double p999 = percentileUs(total.latenciesNs, 0.999);
+
+    if (config.csv) {
+        std::cout << engineName << ',' << config.threads << ',' << config.keys << ',' << config.keySize << ','
+                  << config.valueSize << ',' << config.readRatio << ',' << distName(config.dist) << ','
+                  << ops << ',' << seconds << ',' << throughput << ',' << p50 << ',' << p99 << ','
+                  << p999 << ',' << total.misses << ',' << total.rejected << std::endl;
+    } else {
+        std::cout << "engine=" << engineName << " threads=" << config.threads << " keys=" << config.keys
+                  << " key_size=" << config.keySize << " value_size=" << config.valueSize
+                  << " read_ratio=" << config.readRatio << " dist=" << distName(config.dist) << "\n"
+                  << "  ops=" << ops << " (" << total.reads << " reads, " << total.writes << " writes)"
+                  << " time=" << seconds << "s throughput=" << throughput << " ops/s\n"
+                  << "  latency_us p50=" << p50 << " p99=" << p99 << " p999=" << p999 << "\n"
+                  << "  misses=" << total.misses << " rejected=" << total.rejected << "\n"
+                  << "  worker_batches=" << batch.batches << " mean_batch=" << (batch.batches ? static_cast<double>(batch.tasks) / batch.batches : 0.0)
+                  << " collapsed_sets=" << batch.collapsed << std::endl;
+    }
+    return 0;
+}
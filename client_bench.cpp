@@ -0,0 +1,184 @@
+// Throughput of the client library against a running server, compared with
+// opening a new connection for every request (what hand-rolled callers do).
+//
+// Usage: client_bench [--nodes HOST:PORT,...] [--threads N] [--requests N]
+//                     [--keys N] [--value-size B] [--batch N] [--connections N]
+//
+// Modes, each reading random keys from the preloaded set:
+//   naive      one TCP connection per request, closed after the reply
+//   pooled     KvClient::get from every thread, no pipelining (depth 1)
+//   pipelined  KvClient::get from every thread, pipelined connections
+//   batched    KvClient::getMany with --batch keys per call
+
+#include "fastkv_client.h"
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    std::vector<std::string> nodes{"127.0.0.1:8080"};
+    size_t threads = 8;
+    size_t requests = 100000;       // per mode, across all threads
+    size_t keys = 10000;
+    size_t valueSize = 100;
+    size_t batch = 64;
+    size_t connections = CLIENT_CONNECTIONS_PER_NODE;
+};
+
+static std::string benchKey(size_t index)
+{
+    return "bench" + std::to_string(index);
+}
+
+// One request on a fresh connection; returns the status code, 0 on failure.
+static int naiveGet(const std::string& node, const std::string& key)
+{
+    size_t colon = node.rfind(':');
+    try {
+        asio::io_context io;
+        tcp::socket socket(io);
+        tcp::resolver resolver(io);
+        asio::connect(socket, resolver.resolve(node.substr(0, colon), node.substr(colon + 1)));
+        std::string request = "GET /kv/" + key + " HTTP/1.1\r\nHost: " + node + "\r\nConnection: close\r\n\r\n";
+        asio::write(socket, asio::buffer(request));
+        std::string response;
+        char buf[4096];
+        asio::error_code ec;
+        while (true) {
+            size_t n = socket.read_some(asio::buffer(buf), ec);
+            if (ec) break;
+            response.append(buf, n);
+        }
+        size_t space = response.find(' ');
+        if (response.compare(0, 5, "HTTP/") != 0 || space == std::string::npos) return 0;
+        return std::atoi(response.c_str() + space + 1);
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+// Runs `perThread(thread, count, errors)` on every thread and prints the rate.
+template <class Body>
+static void runMode(const char* name, const BenchOptions& options, Body perThread)
+{
+    std::atomic<size_t> errors(0);
+    std::vector<std::thread> threads;
+    size_t share = options.requests / options.threads;
+    auto start = Clock::now();
+    for (size_t t = 0; t < options.threads; ++t) {
+        threads.emplace_back([&, t] { perThread(t, share, errors); });
+    }
+    for (auto& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t ops = share * options.threads;
+    std::cout << "mode=" << name << " threads=" << options.threads << " ops=" << ops << " seconds=" << seconds
+              << " throughput=" << (seconds > 0 ? ops / seconds : 0) << " ops/s errors=" << errors.load() << std::endl;
+}
+
+static bool parseArgs(int argc, char* argv[], BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        std::string arg = argv[i];
+        if (arg == "--nodes" && hasValue) {
+            options.nodes.clear();
+            std::stringstream list(argv[++i]);
+            std::string node;
+            while (std::getline(list, node, ',')) {
+                if (!node.empty()) options.nodes.push_back(node);
+            }
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--requests" && hasValue) {
+            options.requests = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--keys" && hasValue) {
+            options.keys = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--value-size" && hasValue) {
+            options.valueSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--batch" && hasValue) {
+            options.batch = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--connections" && hasValue) {
+            options.connections = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.nodes.empty() || options.threads == 0 || options.keys == 0 || options.batch == 0) {
+        std::cerr << "--nodes, --threads, --keys and --batch must not be empty or 0" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) return 1;
+
+    KvClientOptions clientOptions;
+    clientOptions.nodes = options.nodes;
+    clientOptions.connectionsPerNode = options.connections;
+    KvClient client(clientOptions);
+
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (size_t i = 0; i < options.keys; ++i) entries.emplace_back(benchKey(i), std::string(options.valueSize, 'x'));
+    size_t loadFailures = 0;
+    for (const KvResult& r : client.setMany(entries)) loadFailures += !r.ok();
+    if (loadFailures) {
+        std::cerr << loadFailures << " of " << options.keys << " keys failed to load; is the server running?" << std::endl;
+        return 1;
+    }
+    // Sets are applied by the server's workers; give them a moment.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto randomKey = [&](std::mt19937_64& rng) { return benchKey(rng() % options.keys); };
+    auto blockingGets = [&](KvClient& c) {
+        return [&](size_t t, size_t count, std::atomic<size_t>& errors) {
+            std::mt19937_64 rng(t + 1);
+            for (size_t i = 0; i < count; ++i) {
+                if (!c.get(randomKey(rng)).ok()) errors.fetch_add(1);
+            }
+        };
+    };
+
+    runMode("naive", options, [&](size_t t, size_t count, std::atomic<size_t>& errors) {
+        std::mt19937_64 rng(t + 1);
+        for (size_t i = 0; i < count; ++i) {
+            std::string key = randomKey(rng);
+            if (naiveGet(client.ownerOf(key), key) != 200) errors.fetch_add(1);
+        }
+    });
+
+    KvClientOptions unpipelined = clientOptions;
+    unpipelined.pipelineDepth = 1;
+    KvClient pooled(unpipelined);
+    runMode("pooled", options, blockingGets(pooled));
+
+    runMode("pipelined", options, blockingGets(client));
+
+    runMode("batched", options, [&](size_t t, size_t count, std::atomic<size_t>& errors) {
+        std::mt19937_64 rng(t + 1);
+        std::vector<std::string> keys;
+        for (size_t done = 0; done < count;) {
+            keys.clear();
+            for (size_t i = 0; i < options.batch && done + i < count; ++i) keys.push_back(randomKey(rng));
+            for (const KvResult& r : client.getMany(keys)) {
+                if (!r.ok()) errors.fetch_add(1);
+            }
+            done += keys.size();
+        }
+    });
+    return 0;
+}
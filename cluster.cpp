@@ -0,0 +1,366 @@
+#include "cluster.h"
+#include <asio.hpp>
+#include <nlohmann/json.hpp>
+#include <cctype>
+#include <functional>
+#include <iostream>
+
+using asio::ip::tcp;
+
+static const std::string NO_OWNER;
+
+static std::string urlEncode(std::string_view value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : value) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back(static_cast<char>(c));
+        } else {
+            out.push_back('%');
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xf]);
+        }
+    }
+    return out;
+}
+
+// The steps run as async operations on a private io_context so one deadline
+// covers all of them; run_for() returning with work left means it passed.
+int clusterRequest(const std::string& node, const std::string& method, const std::string& target,
+                   const std::string& requestBody, std::string& body, std::chrono::milliseconds timeout)
+{
+    size_t colon = node.rfind(':');
+    if (colon == std::string::npos) return 0;
+
+    std::string request = method + " " + target + " HTTP/1.1\r\n"
+                          "Host: " + node + "\r\n"
+                          "Connection: close\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Content-Length: " + std::to_string(requestBody.size()) + "\r\n\r\n" + requestBody;
+    std::string response;
+    char buf[4096];
+    asio::error_code failure;
+    bool finished = false;
+
+    asio::io_context io;
+    tcp::socket socket(io);
+    tcp::resolver resolver(io);
+    // Any read error, usually EOF after Connection: close, ends the response.
+    std::function<void(const asio::error_code&, size_t)> onRead = [&](const asio::error_code& ec, size_t n) {
+        response.append(buf, n);
+        if (ec) {
+            finished = true;
+            return;
+        }
+        socket.async_read_some(asio::buffer(buf), onRead);
+    };
+    resolver.async_resolve(node.substr(0, colon), node.substr(colon + 1),
+                           [&](const asio::error_code& ec, tcp::resolver::results_type endpoints) {
+        if (ec) {
+            failure = ec;
+            return;
+        }
+        asio::async_connect(socket, endpoints, [&](const asio::error_code& ec, const tcp::endpoint&) {
+            if (ec) {
+                failure = ec;
+                return;
+            }
+            asio::async_write(socket, asio::buffer(request), [&](const asio::error_code& ec, size_t) {
+                if (ec) {
+                    failure = ec;
+                    return;
+                }
+                socket.async_read_some(asio::buffer(buf), onRead);
+            });
+        });
+    });
+    io.run_for(timeout);
+
+    if (!finished) {
+        std::cerr << "Cluster request to " << node << " failed: "
+                  << (failure ? failure.message() : "timed out after " + std::to_string(timeout.count()) + " ms") << std::endl;
+        return 0;
+    }
+
+    size_t headerEnd = response.find("\r\n\r\n");
+    if (response.compare(0, 5, "HTTP/") != 0 || headerEnd == std::string::npos) return 0;
+    size_t space = response.find(' ');
+    body = response.substr(headerEnd + 4);
+    return std::atoi(response.c_str() + space + 1);
+}
+
+Cluster::Cluster(HashMap& map, const std::string& self, const std::vector<std::string>& members)
+    : hashmap(map), self(self), enabled(!members.empty()), epoch(0), running(true), migratedEpoch(0)
+{
+    if (!enabled) return;
+
+    for (const auto& node : members) ring.addNode(node);
+    if (!ring.contains(self)) {
+        // Joining: the members still hold our keys until they migrate them.
+        previousRing = ring;
+        pendingMigrations = ring.nodes();
+        announceTo = members;
+        ring.addNode(self);
+    }
+    epoch = ring.fingerprint();
+    migratedEpoch = epoch;
+    migrationThread = std::thread(&Cluster::migrationLoop, this);
+}
+
+Cluster::~Cluster()
+{
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(migrationMutex);
+    }
+    migrationCV.notify_all();
+    if (migrationThread.joinable()) migrationThread.join();
+}
+
+std::string Cluster::remoteOwner(std::string_view key) const
+{
+    if (!enabled) return NO_OWNER;
+    std::shared_lock<std::shared_mutex> lock(ringMutex);
+    const std::string& owner = ring.owner(key);
+    return owner == self ? NO_OWNER : owner;
+}
+
+bool Cluster::pullIfMigrating(std::string_view key)
+{
+    if (!enabled) return true;
+    std::string from;
+    {
+        std::shared_lock<std::shared_mutex> lock(ringMutex);
+        if (pendingMigrations.empty()) return true;
+        const std::string& previous = previousRing.owner(key);
+        if (previous.empty() || previous == self || pendingMigrations.count(previous) == 0) return true;
+        from = previous;
+    }
+
+    HashMap::NodeData local;
+    if (hashmap.lookupEntry(key, local)) return true;
+
+    std::string body;
+    int code = clusterRequest(from, "GET", "/cluster/export?key=" + urlEncode(key), "", body, CLUSTER_PULL_TIMEOUT);
+    if (code == 0) return false;
+    if (code != 200) return true;
+    try {
+        auto j = nlohmann::json::parse(body);
+        importKey(std::string(key), j.value("value", ""), j.value("expiry", static_cast<time_t>(0)));
+    } catch (const std::exception& e) {
+        std::cerr << "Cluster pull of '" << key << "' failed: " << e.what() << std::endl;
+    }
+    return true;
+}
+
+std::vector<std::string> Cluster::addNode(const std::string& node)
+{
+    std::vector<std::string> peers;
+    if (!enabled) return peers;
+    {
+        std::unique_lock<std::shared_mutex> lock(ringMutex);
+        if (ring.contains(node)) return peers;
+        previousRing = ring;
+        ring.addNode(node);
+        epoch = ring.fingerprint();
+        pendingMigrations = previousRing.nodes();
+        for (const auto& member : ring.nodes()) {
+            if (member != self) peers.push_back(member);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(migrationMutex);
+    }
+    migrationCV.notify_all();
+    return peers;
+}
+
+std::vector<std::string> Cluster::removeNode(const std::string& node)
+{
+    std::vector<std::string> peers;
+    if (!enabled) return peers;
+    {
+        std::unique_lock<std::shared_mutex> lock(ringMutex);
+        if (!ring.contains(node) || ring.nodes().size() == 1) return peers;
+        previousRing = ring;
+        ring.removeNode(node);
+        epoch = ring.fingerprint();
+        pendingMigrations = previousRing.nodes();
+        for (const auto& member : previousRing.nodes()) {
+            if (member != self) peers.push_back(member);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(migrationMutex);
+    }
+    migrationCV.notify_all();
+    return peers;
+}
+
+bool Cluster::markMigrated(const std::string& node, uint64_t forEpoch)
+{
+    std::unique_lock<std::shared_mutex> lock(ringMutex);
+    if (forEpoch != epoch) return false;
+    pendingMigrations.erase(node);
+    if (pendingMigrations.empty()) {
+        std::lock_guard<std::mutex> tombstoneLock(tombstoneMutex);
+        migrationTombstones.clear();
+    }
+    return true;
+}
+
+ClusterStatus Cluster::status() const
+{
+    std::shared_lock<std::shared_mutex> lock(ringMutex);
+    ClusterStatus st;
+    st.self = self;
+    st.epoch = epoch;
+    st.nodes.assign(ring.nodes().begin(), ring.nodes().end());
+    st.migratingNodes.assign(pendingMigrations.begin(), pendingMigrations.end());
+    return st;
+}
+
+bool Cluster::exportKey(const std::string& key, HashMap::NodeData& out) const
+{
+    return hashmap.lookupEntry(key, out);
+}
+
+OpStatus Cluster::removeKey(const std::string& key)
+{
+    bool migrating;
+    {
+        std::shared_lock<std::shared_mutex> lock(ringMutex);
+        migrating = enabled && !pendingMigrations.empty();
+    }
+    if (migrating) {
+        // Waits for an import of the key in progress; the remove below follows it.
+        std::lock_guard<std::mutex> lock(tombstoneMutex);
+        migrationTombstones.insert(key);
+    }
+    return hashmap.remove(key);
+}
+
+OpStatus Cluster::importKey(const std::string& key, const std::string& value, time_t expiry)
+{
+    // Held over the write so a delete either comes first and is seen here, or
+    // comes after and removes what was imported.
+    std::lock_guard<std::mutex> lock(tombstoneMutex);
+    // Deleted here since the migration began: acknowledged, so the sender drops it.
+    if (migrationTombstones.count(key)) return OpStatus::OK;
+    int ttl = 0;
+    if (expiry != 0) {
+        time_t now = time(nullptr);
+        if (expiry <= now) return OpStatus::OK;
+        ttl = static_cast<int>(expiry - now);
+    }
+    // Only if absent: a write that already reached the new owner wins.
+    uint64_t version = 0;
+    return hashmap.compareAndSet(key, 0, value, ttl, version);
+}
+
+void Cluster::migrationLoop()
+{
+    for (const auto& node : announceTo) {
+        std::string body;
+        // Already sent to every member, so they must not forward it again.
+        std::string request = nlohmann::json{{"node", self}, {"forwarded", true}}.dump();
+        while (running.load() && clusterRequest(node, "POST", "/cluster/nodes", request, body) != 200) {
+            std::this_thread::sleep_for(MIGRATION_RETRY_DELAY);
+        }
+    }
+
+    while (running.load()) {
+        uint64_t target;
+        {
+            std::unique_lock<std::mutex> lock(migrationMutex);
+            migrationCV.wait(lock, [&] {
+                std::shared_lock<std::shared_mutex> ringLock(ringMutex);
+                return !running.load() || epoch != migratedEpoch;
+            });
+            if (!running.load()) break;
+            std::shared_lock<std::shared_mutex> ringLock(ringMutex);
+            target = epoch;
+        }
+
+        if (migrate(target)) {
+            {
+                std::lock_guard<std::mutex> lock(migrationMutex);
+                migratedEpoch = target;
+            }
+            broadcastMigrated(target);
+        } else {
+            std::unique_lock<std::mutex> lock(migrationMutex);
+            migrationCV.wait_for(lock, MIGRATION_RETRY_DELAY, [&] { return !running.load(); });
+        }
+    }
+}
+
+// One pass over the local table pushing every key this node no longer owns.
+// Returns false if the ring changed or any push failed; the caller retries.
+bool Cluster::migrate(uint64_t forEpoch)
+{
+    bool complete = true;
+    uint64_t cursor = 0;
+    do {
+        {
+            std::shared_lock<std::shared_mutex> lock(ringMutex);
+            if (epoch != forEpoch) return false;
+        }
+        if (!running.load()) return false;
+
+        HashMap::ScanPage page = hashmap.scan(cursor, MIGRATION_BATCH);
+        cursor = page.cursor;
+        for (const auto& key : page.keys) {
+            std::string owner = remoteOwner(key);
+            if (owner.empty()) continue;
+
+            HashMap::NodeData data;
+            if (!hashmap.lookupEntry(key, data)) continue;
+            nlohmann::json j = {{"key", key}, {"value", data.value}, {"expiry", data.expiry}};
+            std::string body;
+            int code = clusterRequest(owner, "POST", "/cluster/import", j.dump(), body);
+            if (code == 200) {
+                hashmap.restoreRemove(key);
+            } else {
+                complete = false;
+            }
+        }
+    } while (cursor != 0);
+    return complete;
+}
+
+void Cluster::broadcastMigrated(uint64_t forEpoch)
+{
+    // Previous members too, so a node that has just left hears the others finish.
+    std::set<std::string> members;
+    {
+        std::shared_lock<std::shared_mutex> lock(ringMutex);
+        if (epoch != forEpoch) return;
+        members = ring.nodes();
+        members.insert(previousRing.nodes().begin(), previousRing.nodes().end());
+    }
+    markMigrated(self, forEpoch);
+
+    // A member may hear of the ring change after this node has finished moving
+    // keys; it refuses the notice until then, so keep resending it while the
+    // ring stays at `forEpoch`.
+    members.erase(self);
+    std::string request = nlohmann::json{{"node", self}, {"epoch", forEpoch}}.dump();
+    while (!members.empty()) {
+        for (auto it = members.begin(); it != members.end();) {
+            std::string body;
+            if (clusterRequest(*it, "POST", "/cluster/migrated", request, body) == 200) {
+                it = members.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (members.empty()) break;
+        std::unique_lock<std::mutex> lock(migrationMutex);
+        migrationCV.wait_for(lock, MIGRATION_RETRY_DELAY, [&] { return !running.load(); });
+        if (!running.load()) return;
+        std::shared_lock<std::shared_mutex> ringLock(ringMutex);
+        if (epoch != forEpoch) return;
+    }
+}
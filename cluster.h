@@ -0,0 +1,108 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "hash_map_rcu.h"
+#include "hash_ring.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+const size_t MIGRATION_BATCH = 256;
+const std::chrono::seconds MIGRATION_RETRY_DELAY(1);
+// Deadline for a whole node-to-node call (resolve, connect, send, read). Pulls
+// run on request threads and get a much shorter one.
+const std::chrono::milliseconds CLUSTER_REQUEST_TIMEOUT(2000);
+const std::chrono::milliseconds CLUSTER_PULL_TIMEOUT(250);
+
+struct ClusterStatus {
+    std::string self;
+    std::vector<std::string> nodes;
+    uint64_t epoch;
+    std::vector<std::string> migratingNodes;
+};
+
+// Cluster membership and key ownership. Requests for keys this node does not
+// own are redirected by the server. When a node joins or leaves, every
+// previous member pushes the keys it no longer owns to their new owners in the
+// background; a leaving node owns nothing, so it pushes all of them. Until all
+// of them report completion, an owner that misses a key pulls it from the
+// key's previous owner, so no key goes missing during the move.
+class Cluster
+{
+    private:
+    HashMap& hashmap;
+    std::string self;
+    bool enabled;
+
+    HashRing ring;
+    HashRing previousRing;
+    uint64_t epoch;                       // ring.fingerprint()
+    std::set<std::string> pendingMigrations;
+    mutable std::shared_mutex ringMutex;
+
+    // Keys deleted here while migrations were still moving keys in. Imports of
+    // them are dropped, so a previous owner that still holds one cannot bring
+    // it back. Cleared once every migration has finished.
+    std::set<std::string> migrationTombstones;
+    std::mutex tombstoneMutex;
+
+    // Background thread: announces a joining node, then moves keys whenever
+    // the ring changes.
+    std::thread migrationThread;
+    std::atomic<bool> running;
+    std::vector<std::string> announceTo;
+    uint64_t migratedEpoch;
+    std::mutex migrationMutex;
+    std::condition_variable migrationCV;
+    void migrationLoop();
+    bool migrate(uint64_t forEpoch);
+    void broadcastMigrated(uint64_t forEpoch);
+
+    public:
+    // An empty member list disables cluster mode. If `self` is not among the
+    // members it joins them: it announces itself and pulls keys as they move.
+    Cluster(HashMap& map, const std::string& self, const std::vector<std::string>& members);
+    ~Cluster();
+
+    bool isEnabled() const { return enabled; }
+    const std::string& selfAddress() const { return self; }
+    // Owner of `key`, or an empty string if it is this node.
+    std::string remoteOwner(std::string_view key) const;
+    // Pulls `key` from its previous owner if a migration is still moving it here.
+    // False if the previous owner may still hold it but did not answer in time.
+    bool pullIfMigrating(std::string_view key);
+
+    // Adds a node to the ring and starts migrating keys that moved. Returns the
+    // nodes that should hear about the change (all members except this one).
+    std::vector<std::string> addNode(const std::string& node);
+    // Removes a node from the ring (the last one is kept) and starts migrating
+    // its keys. Returns the nodes that should hear about the change, including
+    // the one leaving. Once its keys have moved the leaving node can be stopped.
+    std::vector<std::string> removeNode(const std::string& node);
+    // False if this node is not at `forEpoch` yet; the sender retries.
+    bool markMigrated(const std::string& node, uint64_t forEpoch);
+    ClusterStatus status() const;
+
+    // Deletes a key this node owns. While keys are still migrating here the
+    // delete is remembered, so a late import does not restore the key.
+    OpStatus removeKey(const std::string& key);
+
+    // Local-only access used by migration between nodes.
+    bool exportKey(const std::string& key, HashMap::NodeData& out) const;
+    OpStatus importKey(const std::string& key, const std::string& value, time_t expiry);
+};
+
+// Minimal blocking HTTP/1.1 client for node-to-node calls. Returns the status
+// code (0 on connection failure or when `timeout` passes) and fills `body`.
+int clusterRequest(const std::string& node, const std::string& method, const std::string& target,
+                   const std::string& requestBody, std::string& body,
+                   std::chrono::milliseconds timeout = CLUSTER_REQUEST_TIMEOUT);
+
+#endif
@@ -0,0 +1,134 @@
+#!/usr/bin/env bash
+# Rebalancing test for cluster mode, with real server processes on 127.0.0.1.
+#
+# Usage: cluster_test.sh [SERVER_BINARY] [KEYS]
+#
+# Starts three nodes and loads KEYS keys (default 300). Then:
+#   1. a fourth node joins, and every tenth key is deleted through it while
+#      the keys are still moving;
+#   2. one of the original nodes is removed and stopped.
+# After each step it waits for migration to finish and checks that every key
+# is served, with its value, by its owner itself (no redirect), and that no
+# deleted key has come back. Needs curl.
+
+set -u
+
+SERVER=${1:-./hash_map.exe}
+KEYS=${2:-300}
+BASE_PORT=${CLUSTER_TEST_PORT:-18100}
+WORK=$(mktemp -d)
+PIDS=()
+DELETED=0
+
+NODE1=127.0.0.1:$((BASE_PORT + 1))
+NODE2=127.0.0.1:$((BASE_PORT + 2))
+NODE3=127.0.0.1:$((BASE_PORT + 3))
+NODE4=127.0.0.1:$((BASE_PORT + 4))
+MEMBERS=$NODE1,$NODE2,$NODE3
+
+cleanup() {
+    for pid in "${PIDS[@]}"; do kill "$pid" 2>/dev/null; done
+    wait 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+# start NODE MEMBERS: runs a node and waits until it answers.
+start() {
+    local node=$1 port=${1##*:}
+    "$SERVER" --port "$port" --data "$WORK/$port.json" --cluster "$2" --self "$node" >"$WORK/$port.log" 2>&1 &
+    PIDS+=($!)
+    LAST_PID=$!
+    for _ in $(seq 50); do
+        curl -sf "http://$node/cluster/nodes" >/dev/null && return 0
+        sleep 0.1
+    done
+    fail "node $node did not start; see $WORK/$port.log"
+}
+
+# settle NODE...: waits until none of the nodes has a migration pending.
+settle() {
+    local node
+    for _ in $(seq 300); do
+        local busy=0
+        for node in "$@"; do
+            curl -sf "http://$node/cluster/nodes" | grep -q '"migrating":\[\]' || busy=1
+        done
+        [ "$busy" = 0 ] && return 0
+        sleep 0.1
+    done
+    fail "migration did not finish on $*"
+}
+
+# deleted I: whether key I is one of those deleted during the join.
+deleted() {
+    [ "$DELETED" = 1 ] && [ $(($1 % 10)) = 0 ]
+}
+
+# check ENTRY EXCLUDED: every key, asked of ENTRY, is at an owner other than
+# EXCLUDED, and that owner returns it without redirecting; deleted keys are
+# not found.
+check() {
+    local entry=$1 excluded=$2 i owner value code
+    for i in $(seq "$KEYS"); do
+        if deleted "$i"; then
+            code=$(curl -s -L -o /dev/null -w '%{http_code}' "http://$entry/kv/key$i")
+            [ "$code" = 404 ] || fail "deleted key$i came back: $code"
+            continue
+        fi
+        owner=$(curl -s -o /dev/null -D - "http://$entry/kv/key$i" | tr -d '\r' | awk 'tolower($1) == "x-fastkv-owner:" { print $2 }')
+        owner=${owner:-$entry}
+        [ "$owner" = "$excluded" ] && fail "key$i is still owned by removed node $excluded"
+        code=$(curl -s -o "$WORK/value" -w '%{http_code}' "http://$owner/kv/key$i")
+        value=$(cat "$WORK/value")
+        [ "$code" = 200 ] || fail "key$i: owner $owner answered $code"
+        [ "$value" = "value$i" ] || fail "key$i: owner $owner returned '$value'"
+    done
+}
+
+[ -x "$SERVER" ] || fail "server binary $SERVER not found; build it with make"
+
+start "$NODE1" "$MEMBERS"
+start "$NODE2" "$MEMBERS"
+NODE2_PID=$LAST_PID
+start "$NODE3" "$MEMBERS"
+
+for i in $(seq "$KEYS"); do
+    code=$(curl -s -L -o /dev/null -w '%{http_code}' -X PUT --data-binary "value$i" "http://$NODE1/kv/key$i")
+    [ "$code" = 200 ] || [ "$code" = 202 ] || fail "loading key$i: $code"
+done
+sleep 0.5    # sets are applied by the workers
+check "$NODE1" ""
+echo "loaded $KEYS keys on 3 nodes"
+
+start "$NODE4" "$MEMBERS"
+# Before the old owners have pushed them: node4 pulls each key it now owns and
+# deletes it, and the later push must not restore it.
+# The deletes are sent all at once to land while the keys are moving.
+DELETES=()
+for i in $(seq 10 10 "$KEYS"); do
+    curl -s -L -o /dev/null -w '%{http_code}' -X DELETE "http://$NODE4/kv/key$i" >"$WORK/delete$i" &
+    DELETES+=($!)
+done
+wait "${DELETES[@]}"
+for i in $(seq 10 10 "$KEYS"); do
+    code=$(cat "$WORK/delete$i")
+    [ "$code" = 200 ] || fail "deleting key$i during migration: $code"
+done
+DELETED=1
+settle "$NODE1" "$NODE2" "$NODE3" "$NODE4"
+check "$NODE4" ""
+echo "join: every key readable at its owner on 4 nodes, deleted keys stay deleted"
+
+code=$(curl -s -o /dev/null -w '%{http_code}' -X DELETE --data "{\"node\":\"$NODE2\"}" "http://$NODE1/cluster/nodes")
+[ "$code" = 200 ] || fail "removing $NODE2: $code"
+settle "$NODE1" "$NODE2" "$NODE3" "$NODE4"
+kill "$NODE2_PID"
+check "$NODE3" "$NODE2"
+echo "leave: every key readable at its owner on 3 nodes after $NODE2 stopped"
+echo "PASS"
@@ -0,0 +1,92 @@
+#ifndef FASTKV_H
+#define FASTKV_H
+
+/* C API for embedding the engine in-process (libfastkv.a / libfastkv.so).
+ * Only these functions are exported from the shared library, so its ABI does
+ * not change with the engine's C++ internals. C++ callers linking the static
+ * library may use hash_map_rcu.h directly instead.
+ *
+ * All functions are thread-safe. Keys and values are byte strings with
+ * explicit lengths and may contain NUL bytes. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define FASTKV_API __declspec(dllexport)
+#else
+#define FASTKV_API __attribute__((visibility("default")))
+#endif
+
+typedef struct fastkv fastkv;
+
+enum {
+    FASTKV_OK = 0,
+    FASTKV_NOT_FOUND = 1,
+    FASTKV_BUFFER_TOO_SMALL = 2,   /* fastkv_get: *value_len holds the size needed */
+    FASTKV_OVERLOADED = 3,         /* the write queue is full; retry later */
+    FASTKV_TIMEOUT = 4,
+    FASTKV_FULL = 5,               /* memory quota reached and eviction is off */
+    FASTKV_INVALID = 6,            /* bad argument */
+    FASTKV_ERROR = 7
+};
+
+/* Opens an engine. `snapshot_file` is loaded now and written back by
+ * fastkv_close(); NULL keeps the data in memory only. `config` is NULL or a
+ * comma-separated list of name=value settings:
+ *   hash=fnv|fnv-mixed  eviction=lru|none  reclaim=refcount|epoch
+ *   concurrency=lockfree|striped  memory_quota=BYTES
+ *   compress_threshold=BYTES  max_queue_depth=N
+ * Returns NULL if a setting is unknown or the engine could not start. */
+FASTKV_API fastkv *fastkv_open(const char *snapshot_file, const char *config);
+/* Stops the engine, saves the snapshot if any and frees `db`. */
+FASTKV_API void fastkv_close(fastkv *db);
+
+/* Stores a value and returns once it is applied. ttl_seconds 0 = no expiry. */
+FASTKV_API int fastkv_set(fastkv *db, const char *key, size_t key_len, const void *value, size_t value_len,
+                          int ttl_seconds);
+/* Copies the value into `buffer` and sets *value_len to its length. If the
+ * buffer is too small nothing is copied and FASTKV_BUFFER_TOO_SMALL is
+ * returned with *value_len set to the size needed. */
+FASTKV_API int fastkv_get(fastkv *db, const char *key, size_t key_len, void *buffer, size_t buffer_len,
+                          size_t *value_len);
+FASTKV_API int fastkv_remove(fastkv *db, const char *key, size_t key_len);
+
+/* Zero-copy read: calls `fn` with a pointer to the stored value, valid only
+ * until `fn` returns. The entry is pinned while `fn` runs, so `fn` must be
+ * short and must not call into `db`. Compressed values are decoded into a
+ * temporary first. */
+typedef void (*fastkv_read_fn)(const void *value, size_t value_len, uint64_t version, void *context);
+FASTKV_API int fastkv_read(fastkv *db, const char *key, size_t key_len, fastkv_read_fn fn, void *context);
+
+/* Read-through loading. On a miss for a key starting with `prefix` ("" for
+ * every key), fastkv_get and fastkv_read call `fn` to fetch the value from the
+ * caller's backing store. `fn` hands it back with fastkv_loaded_set() and
+ * returns FASTKV_OK; FASTKV_NOT_FOUND is a miss and nothing is cached; any
+ * other return is reported to the reader as FASTKV_ERROR. Concurrent misses
+ * on one key make one call; the other readers wait for its result. With
+ * `refresh_ahead_seconds` > 0, a key read that close to its TTL expiring is
+ * reloaded in the background. The longest matching prefix is used. Call
+ * before other threads use `db`; `fn` may run on any reading thread and must
+ * not read the key it is loading. */
+typedef struct fastkv_loaded fastkv_loaded;
+typedef int (*fastkv_load_fn)(const char *key, size_t key_len, fastkv_loaded *out, void *context);
+FASTKV_API int fastkv_set_loader(fastkv *db, const char *prefix, fastkv_load_fn fn, void *context,
+                                 int refresh_ahead_seconds);
+/* Copies the loaded value; ttl_seconds 0 = no expiry. Only valid inside `fn`. */
+FASTKV_API void fastkv_loaded_set(fastkv_loaded *out, const void *value, size_t value_len, int ttl_seconds);
+
+/* Number of live entries. */
+FASTKV_API size_t fastkv_count(fastkv *db);
+/* Static description of a status code. */
+FASTKV_API const char *fastkv_strerror(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+#include "fastkv.h"
+#include "hash_map_rcu.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+struct fastkv {
+    std::unique_ptr<HashMap> map;
+};
+
+struct fastkv_loaded {
+    std::string &value;
+    int &ttl;
+};
+
+namespace {
+
+int toStatus(OpStatus status)
+{
+    switch (status) {
+        case OpStatus::OK: return FASTKV_OK;
+        case OpStatus::NOT_FOUND: return FASTKV_NOT_FOUND;
+        case OpStatus::OVERLOADED: return FASTKV_OVERLOADED;
+        case OpStatus::TIMEOUT: return FASTKV_TIMEOUT;
+        case OpStatus::FULL: return FASTKV_FULL;
+        case OpStatus::INVALID: return FASTKV_INVALID;
+        default: return FASTKV_ERROR;
+    }
+}
+
+struct OpenSettings {
+    EngineConfig engine;
+    size_t memoryQuota = 0;
+    size_t compressThreshold = 0;
+    size_t maxQueueDepth = DEFAULT_MAX_QUEUE_DEPTH;
+};
+
+bool parseSize(const std::string &text, size_t &out)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    out = std::strtoull(text.c_str(), nullptr, 10);
+    return true;
+}
+
+bool parseConfig(const char *config, OpenSettings &settings)
+{
+    if (!config) return true;
+    std::stringstream list(config);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        if (item.empty()) continue;
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            std::cerr << "fastkv_open: expected name=value, got '" << item << "'" << std::endl;
+            return false;
+        }
+        std::string name = item.substr(0, eq);
+        std::string value = item.substr(eq + 1);
+        bool ok;
+        if (name == "memory_quota") ok = parseSize(value, settings.memoryQuota);
+        else if (name == "compress_threshold") ok = parseSize(value, settings.compressThreshold);
+        else if (name == "max_queue_depth") ok = parseSize(value, settings.maxQueueDepth) && settings.maxQueueDepth > 0;
+        else ok = settings.engine.set("--" + name, value);
+        if (!ok) {
+            std::cerr << "fastkv_open: bad setting '" << item << "'" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+// No exception may cross into C callers; anything unexpected is FASTKV_ERROR.
+fastkv *fastkv_open(const char *snapshot_file, const char *config)
+{
+    try {
+        OpenSettings settings;
+        if (!parseConfig(config, settings)) return nullptr;
+        std::unique_ptr<fastkv> db(new fastkv());
+        db->map = makeHashMap(settings.engine, snapshot_file ? snapshot_file : std::string(), settings.maxQueueDepth);
+        db->map->setMemoryQuota(settings.memoryQuota);
+        db->map->setCompressionThreshold(settings.compressThreshold);
+        return db.release();
+    } catch (const std::exception &e) {
+        std::cerr << "fastkv_open: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void fastkv_close(fastkv *db)
+{
+    try {
+        delete db;
+    } catch (const std::exception &e) {
+        std::cerr << "fastkv_close: " << e.what() << std::endl;
+    }
+}
+
+int fastkv_set(fastkv *db, const char *key, size_t key_len, const void *value, size_t value_len, int ttl_seconds)
+{
+    if (!db || (!key && key_len) || (!value && value_len) || ttl_seconds < 0) return FASTKV_INVALID;
+    try {
+        uint64_t version = 0;
+        return toStatus(db->map->setBlocking(std::string(key, key_len), std::string(static_cast<const char*>(value), value_len),
+                                             ttl_seconds, version));
+    } catch (const std::exception&) {
+        return FASTKV_ERROR;
+    }
+}
+
+int fastkv_get(fastkv *db, const char *key, size_t key_len, void *buffer, size_t buffer_len, size_t *value_len)
+{
+    if (!db || (!key && key_len) || (!buffer && buffer_len) || !value_len) return FASTKV_INVALID;
+    try {
+        bool fits = false;
+        OpStatus status = db->map->view(std::string_view(key, key_len), [&](std::string_view value, uint64_t) {
+            *value_len = value.size();
+            fits = value.size() <= buffer_len;
+            if (fits && !value.empty()) std::memcpy(buffer, value.data(), value.size());
+        });
+        if (status == OpStatus::OK && !fits) return FASTKV_BUFFER_TOO_SMALL;
+        return toStatus(status);
+    } catch (const std::exception&) {
+        return FASTKV_ERROR;
+    }
+}
+
+int fastkv_remove(fastkv *db, const char *key, size_t key_len)
+{
+    if (!db || (!key && key_len)) return FASTKV_INVALID;
+    try {
+        return toStatus(db->map->remove(std::string_view(key, key_len)));
+    } catch (const std::exception&) {
+        return FASTKV_ERROR;
+    }
+}
+
+int fastkv_read(fastkv *db, const char *key, size_t key_len, fastkv_read_fn fn, void *context)
+{
+    if (!db || (!key && key_len) || !fn) return FASTKV_INVALID;
+    try {
+        return toStatus(db->map->view(std::string_view(key, key_len), [&](std::string_view value, uint64_t version) {
+            fn(value.data(), value.size(), version, context);
+        }));
+    } catch (const std::exception&) {
+        return FASTKV_ERROR;
+    }
+}
+
+int fastkv_set_loader(fastkv *db, const char *prefix, fastkv_load_fn fn, void *context, int refresh_ahead_seconds)
+{
+    if (!db || !fn || refresh_ahead_seconds < 0) return FASTKV_INVALID;
+    try {
+        db->map->setLoader(prefix ? prefix : "", [fn, context](const std::string &key, std::string &value, int &ttl) {
+            fastkv_loaded out{value, ttl};
+            int status = fn(key.data(), key.size(), &out, context);
+            if (status == FASTKV_OK) return OpStatus::OK;
+            return status == FASTKV_NOT_FOUND ? OpStatus::NOT_FOUND : OpStatus::FAILED;
+        }, refresh_ahead_seconds);
+        return FASTKV_OK;
+    } catch (const std::exception&) {
+        return FASTKV_ERROR;
+    }
+}
+
+void fastkv_loaded_set(fastkv_loaded *out, const void *value, size_t value_len, int ttl_seconds)
+{
+    if (!out || (!value && value_len)) return;
+    try {
+        out->value.assign(static_cast<const char*>(value), value_len);
+        out->ttl = ttl_seconds > 0 ? ttl_seconds : 0;
+    } catch (const std::exception&) {
+    }
+}
+
+size_t fastkv_count(fastkv *db)
+{
+    return db ? db->map->current_size() : 0;
+}
+
+const char *fastkv_strerror(int status)
+{
+    switch (status) {
+        case FASTKV_OK: return "ok";
+        case FASTKV_NOT_FOUND: return "key not found";
+        case FASTKV_BUFFER_TOO_SMALL: return "buffer too small";
+        case FASTKV_OVERLOADED: return "write queue full";
+        case FASTKV_TIMEOUT: return "timed out";
+        case FASTKV_FULL: return "memory quota exceeded";
+        case FASTKV_INVALID: return "invalid argument";
+        case FASTKV_ERROR: return "internal error";
+        default: return "unknown status";
+    }
+}
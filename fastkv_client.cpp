@@ -0,0 +1,341 @@
+#include "fastkv_client.h"
+#include <asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+using asio::ip::tcp;
+
+struct KvClient::Request {
+    const char *method;
+    std::string key;
+    std::string body;
+    int ttl = 0;
+    int redirects = 0;
+    std::promise<KvResult> promise;
+};
+
+namespace {
+
+std::string pathEncode(std::string_view key)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : key) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back(static_cast<char>(c));
+        } else {
+            out.push_back('%');
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xf]);
+        }
+    }
+    return out;
+}
+
+// Value of header `name` (lower case, with the colon), located in the
+// lower-cased block and copied from the original one.
+std::string headerValue(const std::string &lowered, const std::string &original, const char *name)
+{
+    size_t at = lowered.find(std::string("\r\n") + name);
+    if (at == std::string::npos) return std::string();
+    size_t begin = at + 2 + std::strlen(name);
+    size_t end = lowered.find("\r\n", begin);
+    while (begin < end && original[begin] == ' ') ++begin;
+    return original.substr(begin, end - begin);
+}
+
+}
+
+class KvClient::Connection
+{
+    private:
+    KvClient &client;
+    std::string node;
+    std::string host;
+    std::string port;
+    size_t depth;
+
+    asio::io_context io;
+    tcp::socket socket;
+    asio::streambuf buffer;
+    bool connected = false;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCV;
+    std::deque<std::unique_ptr<Request>> queue;
+    bool running = true;
+    std::thread ioThread;
+
+    static void appendRequest(std::string &wire, const std::string &node, const Request &r)
+    {
+        wire.append(r.method).append(" /kv/").append(pathEncode(r.key)).append(" HTTP/1.1\r\nHost: ").append(node).append("\r\n");
+        if (std::strcmp(r.method, "PUT") == 0) {
+            wire.append("Content-Type: application/octet-stream\r\n");
+            if (r.ttl) wire.append("X-Fastkv-TTL: ").append(std::to_string(r.ttl)).append("\r\n");
+            wire.append("Content-Length: ").append(std::to_string(r.body.size())).append("\r\n\r\n").append(r.body);
+        } else {
+            wire.append("\r\n");
+        }
+    }
+
+    void reset()
+    {
+        asio::error_code ignored;
+        socket.close(ignored);
+        buffer.consume(buffer.size());
+        connected = false;
+    }
+
+    // Reads one response; false if the connection broke.
+    bool readResponse(KvResult &result, bool &closeAfter, std::string &redirectTo)
+    {
+        size_t headerBytes = asio::read_until(socket, buffer, "\r\n\r\n");
+        std::string headers(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + headerBytes);
+        buffer.consume(headerBytes);
+        std::string lowered(headers);
+        std::transform(lowered.begin(), lowered.end(), lowered.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        size_t space = lowered.find(' ');
+        if (lowered.compare(0, 5, "http/") != 0 || space == std::string::npos) return false;
+        result.status = std::atoi(lowered.c_str() + space + 1);
+
+        size_t contentLength = std::strtoull(headerValue(lowered, headers, "content-length:").c_str(), nullptr, 10);
+        if (buffer.size() < contentLength) asio::read(socket, buffer, asio::transfer_exactly(contentLength - buffer.size()));
+        result.value.assign(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + contentLength);
+        buffer.consume(contentLength);
+
+        result.version = std::strtoull(headerValue(lowered, headers, "x-fastkv-version:").c_str(), nullptr, 10);
+        redirectTo = result.status == 307 ? headerValue(lowered, headers, "x-fastkv-owner:") : std::string();
+        closeAfter = lowered.find("\r\nconnection: close") != std::string::npos;
+        return true;
+    }
+
+    void run()
+    {
+        std::vector<std::unique_ptr<Request>> batch;
+        std::string wire;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCV.wait(lock, [this] { return !running || !queue.empty(); });
+                if (queue.empty()) return;
+                while (!queue.empty() && batch.size() < depth) {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+
+            size_t answered = 0;
+            try {
+                if (!connected) {
+                    tcp::resolver resolver(io);
+                    asio::connect(socket, resolver.resolve(host, port));
+                    socket.set_option(tcp::no_delay(true));
+                    connected = true;
+                }
+                wire.clear();
+                for (const auto& request : batch) appendRequest(wire, node, *request);
+                asio::write(socket, asio::buffer(wire));
+
+                for (; answered < batch.size(); ++answered) {
+                    KvResult result;
+                    bool closeAfter = false;
+                    std::string redirectTo;
+                    if (!readResponse(result, closeAfter, redirectTo)) break;
+                    std::unique_ptr<Request> request = std::move(batch[answered]);
+                    if (!redirectTo.empty() && request->redirects < CLIENT_MAX_REDIRECTS) {
+                        request->redirects++;
+                        client.dispatch(redirectTo, std::move(request));
+                    } else {
+                        client.complete(std::move(request), std::move(result));
+                    }
+                    if (closeAfter) {
+                        ++answered;
+                        break;
+                    }
+                }
+            } catch (const std::exception&) {
+            }
+            if (answered < batch.size()) {
+                // Requests after a broken or closed connection are not retried:
+                // a write may or may not have been applied.
+                reset();
+                for (size_t i = answered; i < batch.size(); ++i) {
+                    if (batch[i]) client.complete(std::move(batch[i]), KvResult());
+                }
+            }
+            batch.clear();
+        }
+    }
+
+    public:
+    Connection(KvClient &owner, const std::string &address, size_t pipelineDepth)
+        : client(owner), node(address), depth(std::max<size_t>(pipelineDepth, 1)), socket(io)
+    {
+        size_t colon = address.rfind(':');
+        host = colon == std::string::npos ? address : address.substr(0, colon);
+        port = colon == std::string::npos ? "80" : address.substr(colon + 1);
+        ioThread = std::thread(&Connection::run, this);
+    }
+
+    ~Connection()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            running = false;
+        }
+        queueCV.notify_all();
+        if (ioThread.joinable()) ioThread.join();
+    }
+
+    void enqueue(std::unique_ptr<Request> request)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(request));
+        }
+        queueCV.notify_one();
+    }
+
+    size_t queued()
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        return queue.size();
+    }
+};
+
+KvClient::KvClient(const KvClientOptions &options) : options(options)
+{
+    for (const auto& node : options.nodes) ring.addNode(node);
+    size_t perNode = std::max<size_t>(options.connectionsPerNode, 1);
+    for (const auto& node : ring.nodes()) {
+        auto& pool = pools[node];
+        for (size_t i = 0; i < perNode; ++i) pool.emplace_back(new Connection(*this, node, options.pipelineDepth));
+    }
+}
+
+// Connections drain their queues before their threads exit, so every
+// outstanding future is satisfied. A redirect may still be dispatching into
+// another pool while they close, hence the pools are cleared one by one with
+// the lock released.
+KvClient::~KvClient()
+{
+    while (true) {
+        std::vector<std::unique_ptr<Connection>> closing;
+        {
+            std::unique_lock<std::shared_mutex> lock(poolsMutex);
+            if (pools.empty()) return;
+            closing = std::move(pools.begin()->second);
+            pools.erase(pools.begin());
+        }
+        closing.clear();
+    }
+}
+
+// Picks the connection with the shortest queue, so a slow reply on one does
+// not hold up requests that could go out on another.
+void KvClient::dispatch(const std::string &node, std::unique_ptr<Request> request)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(poolsMutex);
+        auto it = pools.find(node);
+        if (it != pools.end() && !it->second.empty()) {
+            Connection* best = it->second.front().get();
+            size_t bestQueued = best->queued();
+            for (size_t i = 1; i < it->second.size() && bestQueued > 0; ++i) {
+                size_t queued = it->second[i]->queued();
+                if (queued < bestQueued) {
+                    best = it->second[i].get();
+                    bestQueued = queued;
+                }
+            }
+            best->enqueue(std::move(request));
+            return;
+        }
+    }
+    if (node.empty()) {
+        complete(std::move(request), KvResult());
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(poolsMutex);
+    auto& pool = pools[node];
+    if (pool.empty()) pool.emplace_back(new Connection(*this, node, options.pipelineDepth));
+    pool.front()->enqueue(std::move(request));
+}
+
+void KvClient::complete(std::unique_ptr<Request> request, KvResult result)
+{
+    request->promise.set_value(std::move(result));
+}
+
+std::future<KvResult> KvClient::submit(const char *method, const std::string &key, std::string body, int ttl)
+{
+    std::unique_ptr<Request> request(new Request());
+    request->method = method;
+    request->key = key;
+    request->body = std::move(body);
+    request->ttl = ttl;
+    std::future<KvResult> future = request->promise.get_future();
+    dispatch(ring.owner(key), std::move(request));
+    return future;
+}
+
+std::future<KvResult> KvClient::getAsync(const std::string &key)
+{
+    return submit("GET", key, std::string(), 0);
+}
+
+std::future<KvResult> KvClient::setAsync(const std::string &key, const std::string &value, int ttl)
+{
+    return submit("PUT", key, value, ttl);
+}
+
+std::future<KvResult> KvClient::removeAsync(const std::string &key)
+{
+    return submit("DELETE", key, std::string(), 0);
+}
+
+KvResult KvClient::get(const std::string &key)
+{
+    return getAsync(key).get();
+}
+
+KvResult KvClient::set(const std::string &key, const std::string &value, int ttl)
+{
+    return setAsync(key, value, ttl).get();
+}
+
+KvResult KvClient::remove(const std::string &key)
+{
+    return removeAsync(key).get();
+}
+
+std::vector<KvResult> KvClient::getMany(const std::vector<std::string> &keys)
+{
+    std::vector<std::future<KvResult>> futures;
+    futures.reserve(keys.size());
+    for (const auto& key : keys) futures.push_back(getAsync(key));
+    std::vector<KvResult> results;
+    results.reserve(keys.size());
+    for (auto& f : futures) results.push_back(f.get());
+    return results;
+}
+
+std::vector<KvResult> KvClient::setMany(const std::vector<std::pair<std::string, std::string>> &entries, int ttl)
+{
+    std::vector<std::future<KvResult>> futures;
+    futures.reserve(entries.size());
+    for (const auto& entry : entries) futures.push_back(setAsync(entry.first, entry.second, ttl));
+    std::vector<KvResult> results;
+    results.reserve(entries.size());
+    for (auto& f : futures) results.push_back(f.get());
+    return results;
+}
@@ -0,0 +1,87 @@
+#ifndef FASTKV_CLIENT_H
+#define FASTKV_CLIENT_H
+
+#include "hash_ring.h"
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+const size_t CLIENT_CONNECTIONS_PER_NODE = 4;
+const size_t CLIENT_PIPELINE_DEPTH = 32;
+const int CLIENT_MAX_REDIRECTS = 2;
+
+struct KvResult {
+    int status = 0;             // HTTP status; 0 if the node could not be reached
+    std::string value;          // get: the value; otherwise the server's message
+    uint64_t version = 0;       // get: the version /cas expects
+
+    bool ok() const { return status >= 200 && status < 300; }
+    bool notFound() const { return status == 404; }
+    // 503 from load shedding or a queue timeout; worth retrying later.
+    bool overloaded() const { return status == 503; }
+};
+
+struct KvClientOptions {
+    // "host:port" of every cluster member, or just the one server.
+    std::vector<std::string> nodes;
+    size_t connectionsPerNode = CLIENT_CONNECTIONS_PER_NODE;
+    // Requests written back to back on one connection before reading replies.
+    size_t pipelineDepth = CLIENT_PIPELINE_DEPTH;
+};
+
+// Client for the raw /kv/<key> routes. Keys are sent straight to their owner
+// on the same consistent-hash ring the servers build (hash_ring.h), so a
+// request only sees a redirect while the cluster is changing, and redirects
+// are followed. Each node has a small pool of keep-alive connections; each
+// connection has one I/O thread that writes every queued request (up to
+// pipelineDepth) before reading the replies in order, so concurrent callers
+// and batches share round trips instead of paying one each.
+//
+// Every call is thread-safe. The blocking calls wait on the async ones.
+class KvClient
+{
+    public:
+    explicit KvClient(const KvClientOptions &options);
+    ~KvClient();
+    KvClient(const KvClient&) = delete;
+    KvClient& operator=(const KvClient&) = delete;
+
+    KvResult get(const std::string &key);
+    // ttl 0 = no expiry. A set is applied asynchronously by the server (202).
+    KvResult set(const std::string &key, const std::string &value, int ttl = 0);
+    KvResult remove(const std::string &key);
+
+    std::future<KvResult> getAsync(const std::string &key);
+    std::future<KvResult> setAsync(const std::string &key, const std::string &value, int ttl = 0);
+    std::future<KvResult> removeAsync(const std::string &key);
+
+    // All requests are queued before any reply is awaited; results are in
+    // the order of the input.
+    std::vector<KvResult> getMany(const std::vector<std::string> &keys);
+    std::vector<KvResult> setMany(const std::vector<std::pair<std::string, std::string>> &entries, int ttl = 0);
+
+    // The node a key is sent to first.
+    const std::string& ownerOf(std::string_view key) const { return ring.owner(key); }
+
+    private:
+    struct Request;
+    class Connection;
+
+    KvClientOptions options;
+    HashRing ring;
+    // node -> its connections; nodes learned from redirects are added lazily.
+    std::map<std::string, std::vector<std::unique_ptr<Connection>>> pools;
+    mutable std::shared_mutex poolsMutex;
+
+    std::future<KvResult> submit(const char *method, const std::string &key, std::string body, int ttl);
+    void dispatch(const std::string &node, std::unique_ptr<Request> request);
+    void complete(std::unique_ptr<Request> request, KvResult result);
+};
+
+#endif
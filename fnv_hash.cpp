@@ -3,7 +3,7 @@
 const size_t FNV_PRIME = 16777619ULL;
 const size_t OFFSET_BASIS = 2166136261ULL;
 
-size_t fnv1a_hash(const std::string& key)
+size_t fnv1a_hash(std::string_view key)
 {
     size_t hash = OFFSET_BASIS;
     for (char c: key)
@@ -12,4 +12,15 @@ size_t fnv1a_hash(const std::string& key)
         hash *=FNV_PRIME;
     }
     return hash;
-}
\ No newline at end of file
+}
+
+uint64_t fnv1a_hash_mixed(std::string_view key)
+{
+    uint64_t h = fnv1a_hash(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
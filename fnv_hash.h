@@ -1,8 +1,13 @@
 #ifndef FNV_HASH_H
 #define FNV_HASH_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
-size_t fnv1a_hash(const std::string &str);
+size_t fnv1a_hash(std::string_view str);
+// fnv1a_hash folded through a 64-bit finalizer. Plain FNV leaves similar
+// strings (user:1, user:2) close together in the high bits; this spreads them.
+uint64_t fnv1a_hash_mixed(std::string_view str);
 
 #endif 
\ No newline at end of file
@@ -2,34 +2,729 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <cerrno>
+#include <cstdlib>
+#include <type_traits>
 #include "persistence.h"
+#include "value_codec.h"
 
-inline void HashMap::incrementRefCount(Node* node) const{
-    if (node) {
-        node->refCount.fetch_add(1, std::memory_order_relaxed);
+#define BASIC_HASH_MAP_TEMPLATE template <class HashPolicy, class EvictionPolicy, class ReclaimPolicy, class ConcurrencyPolicy>
+#define BASIC_HASH_MAP BasicHashMap<HashPolicy, EvictionPolicy, ReclaimPolicy, ConcurrencyPolicy>
+
+static std::atomic<uint64_t> nextInstanceId(1);
+
+HashMap::HashMap(const std::string &persistenceFile, size_t maxQueueDepth) : versionCounter(0), workersRunning(true), maxQueueDepth(maxQueueDepth), rejectedTasks(0), orderedIndexEnabled(false), events(nullptr), eventsEnabled(false), droppedEvents(0), eventWaiters(0), eventWakeups(0), hasMutationListener(false), compressionThreshold(0), logicalValueBytes(0), storedValueBytes(0), compressedEntries(0), entryBytes(0), memoryQuota(0), quotaEvicts(true), refresherRunning(false), nearCacheSlots(0), instanceId(nextInstanceId.fetch_add(1)), heapPending(0), heapLoaderRunning(false), PersistenceFileName(persistenceFile), batches(0), batchedTasks(0), collapsedSets(0), batchSizes{}
+{
+}
+
+namespace {
+
+struct NearCacheEntry {
+    std::string key;
+    std::string value;
+    uint64_t version = 0;
+    uint64_t stamp = 0;
+    size_t bucket = 0;
+    time_t expiry = 0;
+    uint32_t hits = 0;             // not yet passed to the hot-key sampler
+    bool valid = false;
+};
+
+// One per thread. It only ever holds entries of the map it was last used
+// with; switching maps (or slot counts) starts it over, dropping the hits
+// not yet folded into the old map's counters.
+struct NearCache {
+    uint64_t owner = 0;
+    std::vector<NearCacheEntry> slots;
+    uint32_t pendingHits = 0;
+    uint32_t rng = 0x2545f491u;
+
+    std::vector<NearCacheEntry>& forMap(uint64_t instance, size_t count)
+    {
+        if (owner != instance || slots.size() != count) {
+            owner = instance;
+            slots.assign(count, NearCacheEntry());
+            pendingHits = 0;
+        }
+        return slots;
+    }
+    uint32_t nextRandom()
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    }
+};
+
+thread_local NearCache nearCache;
+
+// Hands this thread's near-cache hits to the map's shared counters.
+void flushNearCacheHits(HotKeyTracker &hotReads, StripedCounter &readHits)
+{
+    for (NearCacheEntry &entry : nearCache.slots) {
+        for (; entry.hits > 0; --entry.hits) hotReads.record(entry.key);
     }
+    readHits.add(nearCache.pendingHits);
+    nearCache.pendingHits = 0;
 }
 
-inline void HashMap::decrementRefCount(Node* node) const{
-    if (node) {
-        node->refCount.fetch_sub(1, std::memory_order_release);
+// Set while this thread copies an entry in from the heap image.
+thread_local bool loadingFromHeap = false;
+
+const uint8_t HEAP_PENDING = 0;
+const uint8_t HEAP_LOADING = 1;
+const uint8_t HEAP_LOADED = 2;
+
+std::atomic<size_t> nextCounterCell(0);
+
+bool decodeValue(const HashNode *node, std::string &out)
+{
+    if (!node->compressed) {
+        out.assign(node->value.data(), node->value.size());
+        return true;
     }
+    return ValueCodec::decompress(node->value, out);
 }
 
-HashMap:: HashMap(const std::string &persistenceFile) : capacity(INITIAL_CAPACITY), size(0), running(true), lruRunning(true), workersRunning(true)
+bool decodeRange(const HashNode *node, const HashMap::ByteRange &range, std::string &out, uint64_t &totalSize)
 {
-    table = std::vector<std::atomic<Node*>>(this->capacity);
+    std::string decoded;
+    std::string_view whole(node->value.data(), node->value.size());
+    if (node->compressed) {
+        if (!ValueCodec::decompress(node->value, decoded)) return false;
+        whole = decoded;
+    }
+    totalSize = whole.size();
+    uint64_t length = std::min<uint64_t>(range.length, whole.size());
+    uint64_t first = range.suffix ? whole.size() - length : std::min<uint64_t>(range.first, whole.size());
+    out.assign(whole.data() + first, std::min<uint64_t>(length, whole.size() - first));
+    return true;
+}
+
+}
+
+size_t StripedCounter::cellIndex()
+{
+    static thread_local size_t cell = nextCounterCell.fetch_add(1, std::memory_order_relaxed) % CELLS;
+    return cell;
+}
 
-    unsigned int num_workers = std::thread::hardware_concurrency();
-    if (num_workers == 0) num_workers = 2;
+uint64_t StripedCounter::total() const
+{
+    uint64_t sum = 0;
+    for (const Cell& c : cells) sum += c.value.load(std::memory_order_relaxed);
+    return sum;
+}
 
-    for (int i=0;i<std::thread::hardware_concurrency();++i)
+HashMap::~HashMap() = default;
+
+void HashMap::stopWorkers()
+{
     {
-        workerThread.emplace_back(&HashMap::workerFunction,this);
+        std::lock_guard<std::mutex> lock(taskMutex);
+        workersRunning = false;
+    }
+    taskCV.notify_all();
+}
+
+// Takes a fair share of what is queued rather than a full batch, so one
+// worker does not drain the queues while the others sleep.
+bool HashMap::nextTasks(std::vector<Task> &batch, size_t workers)
+{
+    batch.clear();
+    {
+        std::unique_lock<std::mutex> lock(taskMutex);
+        taskCV.wait(lock, [&]() {
+            return !readQueue.empty() || !writeQueue.empty() || !workersRunning;
+        });
+        size_t queued = readQueue.size() + writeQueue.size();
+        if (queued == 0) return false;
+        size_t take = std::min(WORKER_BATCH_SIZE, (queued + workers - 1) / std::max<size_t>(workers, 1));
+        while (batch.size() < take && !readQueue.empty()) {
+            batch.push_back(std::move(readQueue.front()));
+            readQueue.pop();
+        }
+        while (batch.size() < take && !writeQueue.empty()) {
+            batch.push_back(std::move(writeQueue.front()));
+            writeQueue.pop();
+        }
+    }
+    size_t slot = 0;
+    while ((size_t(2) << slot) <= batch.size() && slot + 1 < BATCH_HISTOGRAM_SLOTS) ++slot;
+    batchSizes[slot].fetch_add(1, std::memory_order_relaxed);
+    batches.fetch_add(1, std::memory_order_relaxed);
+    batchedTasks.fetch_add(batch.size(), std::memory_order_relaxed);
+    return true;
+}
+
+HashMap::BatchStats HashMap::batchStats() const
+{
+    BatchStats s;
+    s.batches = batches.load(std::memory_order_relaxed);
+    s.tasks = batchedTasks.load(std::memory_order_relaxed);
+    s.collapsed = collapsedSets.load(std::memory_order_relaxed);
+    for (const auto& slot : batchSizes) s.histogram.push_back(slot.load(std::memory_order_relaxed));
+    return s;
+}
+
+// Reads may fill their own queue up to the high-water mark even while writes
+// are being shed, so a write burst cannot starve lookups. A task queued by a
+// sampled request carries its trace to the worker, which records the wait.
+bool HashMap::enqueueRead(Task &&task)
+{
+    task.traceId = Trace::current();
+    if (task.traceId) task.enqueuedNs = Trace::now();
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        if (readQueue.size() >= maxQueueDepth) {
+            rejectedTasks.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        readQueue.push(std::move(task));
+    }
+    taskCV.notify_one();
+    return true;
+}
+
+bool HashMap::enqueueWrite(Task &&task)
+{
+    task.traceId = Trace::current();
+    if (task.traceId) task.enqueuedNs = Trace::now();
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        if (readQueue.size() + writeQueue.size() >= maxQueueDepth) {
+            rejectedTasks.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        writeQueue.push(std::move(task));
+    }
+    taskCV.notify_one();
+    return true;
+}
+
+size_t HashMap::queue_depth()
+{
+    std::lock_guard<std::mutex> lock(taskMutex);
+    return readQueue.size() + writeQueue.size();
+}
+
+OpStatus HashMap::getAsync(const std::string &key, Completion done)
+{
+    return enqueueRead(Task(TaskType::GET, key, std::move(done))) ? OpStatus::OK : OpStatus::OVERLOADED;
+}
+
+OpStatus HashMap::setAsync(const std::string &key, const std::string &value, int ttl, Completion done)
+{
+    if (quotaFull()) return OpStatus::FULL;
+    return enqueueWrite(Task(TaskType::SET, key, value, ttl, std::move(done))) ? OpStatus::OK : OpStatus::OVERLOADED;
+}
+
+OpStatus HashMap::removeAsync(const std::string &key, Completion done)
+{
+    return enqueueWrite(Task(TaskType::REMOVE, key, std::move(done))) ? OpStatus::OK : OpStatus::OVERLOADED;
+}
+
+OpStatus HashMap::set(const std::string &key, const std::string &value, int ttl)
+{
+    return setAsync(key, value, ttl, nullptr);
+}
+
+void HashMap::clear()
+{
+    for (const auto& item : getAllForPersistence()) {
+        restoreRemove(item.key);
+    }
+}
+
+void HashMap::setMutationListener(MutationListener listener)
+{
+    mutationListener = std::move(listener);
+    hasMutationListener.store(static_cast<bool>(mutationListener), std::memory_order_release);
+}
+
+void HashMap::notifyMutation(const std::string &key)
+{
+    if (hasMutationListener.load(std::memory_order_acquire)) mutationListener(key);
+}
+
+bool HashMap::encodeValue(const std::string &raw, std::string &packed) const
+{
+    size_t threshold = compressionThreshold.load(std::memory_order_relaxed);
+    if (threshold == 0 || raw.size() <= threshold) return false;
+    if (!ValueCodec::compress(raw, packed)) return false;
+    return packed.size() <= raw.size() - raw.size() / COMPRESSION_MIN_SAVING_DIVISOR;
+}
+
+void HashMap::accountValue(const HashNode *node, int64_t sign)
+{
+    int64_t logical = static_cast<int64_t>(node->compressed ? ValueCodec::rawLength(node->value) : node->value.size());
+    logicalValueBytes.fetch_add(sign * logical, std::memory_order_relaxed);
+    storedValueBytes.fetch_add(sign * static_cast<int64_t>(node->value.size()), std::memory_order_relaxed);
+    entryBytes.fetch_add(sign * static_cast<int64_t>(sizeof(HashNode) + node->key.size() + node->value.size()), std::memory_order_relaxed);
+    if (node->compressed) compressedEntries.fetch_add(sign, std::memory_order_relaxed);
+}
+
+HashMap::Stats HashMap::stats() const
+{
+    Stats s;
+    s.entries = current_size();
+    s.memoryBytes = static_cast<uint64_t>(std::max<int64_t>(entryBytes.load(std::memory_order_relaxed), 0));
+    s.readHits = readHits.total();
+    s.readMisses = readMisses.total();
+    s.compressedEntries = static_cast<size_t>(std::max<int64_t>(compressedEntries.load(std::memory_order_relaxed), 0));
+    s.logicalValueBytes = static_cast<uint64_t>(std::max<int64_t>(logicalValueBytes.load(std::memory_order_relaxed), 0));
+    s.storedValueBytes = static_cast<uint64_t>(std::max<int64_t>(storedValueBytes.load(std::memory_order_relaxed), 0));
+    return s;
+}
+
+bool HashMap::attachHeap(const std::string &file, std::string &error)
+{
+    heapFileName = file;
+    heap = MappedHeap::open(file, error);
+    if (!heap) return false;
+    heapClaims.reset(new std::atomic<uint8_t>[heap->entries()]());
+    heapPending.store(heap->entries(), std::memory_order_release);
+    heapLoaderRunning.store(true);
+    heapLoader = std::thread(&HashMap::loadHeap, this);
+    return true;
+}
+
+void HashMap::hydrate(std::string_view key) const
+{
+    if (heapPending.load(std::memory_order_acquire) == 0) return;
+    MappedHeap::Entry entry;
+    if (heap->find(key, entry)) hydrateEntry(entry);
+}
+
+size_t HashMap::hydrateAll(const std::atomic<bool> *keepGoing) const
+{
+    if (heapPending.load(std::memory_order_acquire) == 0) return 0;
+    size_t damaged = 0;
+    MappedHeap::Entry entry;
+    bool valid;
+    MappedHeap::Cursor cursor;
+    while (heap->next(cursor, entry, valid)) {
+        if (keepGoing && !keepGoing->load(std::memory_order_relaxed)) return damaged;
+        if (valid) {
+            hydrateEntry(entry);
+        } else {
+            ++damaged;
+        }
+    }
+    // Every valid entry is now loaded (hydrateEntry waits for one another
+    // thread has claimed); damaged ones are never found by hydrate() either.
+    heapPending.store(0, std::memory_order_release);
+    return damaged;
+}
+
+// The first thread to claim an entry copies it in; any other waits until that
+// is done, so nobody acts on the key while the table is still missing it.
+void HashMap::hydrateEntry(const MappedHeap::Entry &entry) const
+{
+    std::atomic<uint8_t> &state = heapClaims[entry.index];
+    uint8_t expected = HEAP_PENDING;
+    if (!state.compare_exchange_strong(expected, HEAP_LOADING, std::memory_order_acquire)) {
+        while (state.load(std::memory_order_acquire) != HEAP_LOADED) std::this_thread::yield();
+        return;
+    }
+    time_t now = time(nullptr);
+    if (entry.expiry == 0 || entry.expiry > now) {
+        loadingFromHeap = true;
+        try {
+            const_cast<HashMap*>(this)->loadEntry(std::string(entry.key), std::string(entry.value),
+                                                  entry.expiry ? static_cast<int>(entry.expiry - now) : 0, entry.compressed);
+        } catch (const std::exception& e) {
+            std::cerr << "Heap image: failed to load key '" << entry.key << "': " << e.what() << std::endl;
+        }
+        loadingFromHeap = false;
+    }
+    heapPending.fetch_sub(1, std::memory_order_release);
+    state.store(HEAP_LOADED, std::memory_order_release);
+}
+
+void HashMap::loadHeap()
+{
+    auto started = std::chrono::steady_clock::now();
+    size_t damaged = hydrateAll(&heapLoaderRunning);
+    if (!heapLoaderRunning.load()) return;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    std::cout << "Heap image: loaded in " << elapsed.count() << " ms" << std::endl;
+    if (damaged) std::cerr << "Heap image: skipped " << damaged << " damaged entries" << std::endl;
+}
+
+void HashMap::stopHeapLoader()
+{
+    heapLoaderRunning.store(false);
+    if (heapLoader.joinable()) heapLoader.join();
+}
+
+void HashMap::saveHeap()
+{
+    hydrateAll();
+    std::vector<NodeData> data = getAllForPersistence();
+    std::vector<MappedHeap::Entry> entries;
+    entries.reserve(data.size());
+    for (const auto& item : data) {
+        entries.push_back(MappedHeap::Entry{item.key, item.value, item.expiry, item.lastAccessed, item.compressed, 0});
+    }
+    // Windows cannot replace a file that is still mapped.
+    heap.reset();
+    if (!MappedHeap::write(heapFileName, entries)) {
+        std::cerr << "Heap image: failed to write " << heapFileName << std::endl;
     }
-    
-    cleanupThread = std::thread(&HashMap::cleanupExpired, this);
-    lruThread = std::thread(&HashMap::lruMonitor,this);
+}
+
+void HashMap::setLoader(const std::string &prefix, Loader loader, int refreshAheadSeconds)
+{
+    auto it = std::find_if(loaders.begin(), loaders.end(), [&](const LoaderEntry& e) { return e.prefix == prefix; });
+    if (it != loaders.end()) loaders.erase(it);
+    LoaderEntry entry{prefix, std::move(loader), std::max(refreshAheadSeconds, 0)};
+    auto at = std::find_if(loaders.begin(), loaders.end(), [&](const LoaderEntry& e) { return e.prefix.size() < prefix.size(); });
+    loaders.insert(at, std::move(entry));
+    if (refreshAheadSeconds > 0 && !refresherRunning) {
+        refresherRunning = true;
+        refresher = std::thread(&HashMap::refreshLoop, this);
+    }
+}
+
+const HashMap::LoaderEntry* HashMap::loaderFor(std::string_view key) const
+{
+    for (const auto& entry : loaders) {
+        if (key.compare(0, entry.prefix.size(), entry.prefix) == 0) return &entry;
+    }
+    return nullptr;
+}
+
+// Exceptions from a loader, of any type, are reported as FAILED to every
+// reader waiting on it.
+static OpStatus runLoader(const Loader &loader, const std::string &key, std::string &value, int &ttl)
+{
+    try {
+        return loader(key, value, ttl);
+    } catch (const std::exception& e) {
+        std::cerr << "Loader failed for key " << key << ": " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Loader failed for key " << key << ": non-standard exception" << std::endl;
+    }
+    return OpStatus::FAILED;
+}
+
+// The first reader to miss runs the load; the flight is removed before its
+// result is published, so a reader arriving later finds the value in the
+// table, or starts a new load if it could not be cached. Both happen in a
+// guard, so even a leader that unwinds releases its waiters (with FAILED).
+OpStatus HashMap::loadMissing(std::string_view key, std::string &value, uint64_t *version)
+{
+    const LoaderEntry* entry = loaderFor(key);
+    if (!entry) return OpStatus::NOT_FOUND;
+
+    std::string name(key);
+    std::promise<LoadResult> promise;
+    std::shared_future<LoadResult> flight;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(flightsMutex);
+        auto it = flights.find(name);
+        if (it == flights.end()) {
+            flight = promise.get_future().share();
+            flights.emplace(name, flight);
+            leader = true;
+        } else {
+            flight = it->second;
+        }
+    }
+
+    if (leader) {
+        struct Publish {
+            HashMap &map;
+            const std::string &key;
+            std::promise<LoadResult> &promise;
+            LoadResult result{OpStatus::FAILED, std::string(), 0};
+            ~Publish()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(map.flightsMutex);
+                    map.flights.erase(key);
+                }
+                promise.set_value(std::move(result));
+            }
+        } publish{*this, name, promise};
+
+        Trace::Span span("load");
+        int ttl = 0;
+        LoadResult& result = publish.result;
+        result.status = runLoader(entry->loader, name, result.value, ttl);
+        // Version 0 means the key must be absent. If it was not cached (a
+        // write got in first, or no room) readers still get the loaded value,
+        // with version 0.
+        if (result.status == OpStatus::OK && storeLoaded(name, 0, result.value, ttl, result.version) != OpStatus::OK) {
+            result.version = 0;
+        }
+    } else {
+        Trace::Span span("await_load");
+        if (flight.wait_for(TASK_TIMEOUT) == std::future_status::timeout) return OpStatus::TIMEOUT;
+    }
+
+    const LoadResult& result = flight.get();
+    if (result.status == OpStatus::OK) {
+        value.assign(result.value);
+        if (version) *version = result.version;
+    }
+    return result.status;
+}
+
+void HashMap::refreshIfExpiring(std::string_view key, uint64_t version, time_t expiry)
+{
+    if (expiry == 0) return;
+    const LoaderEntry* entry = loaderFor(key);
+    if (!entry || entry->refreshAhead == 0 || expiry - time(nullptr) > entry->refreshAhead) return;
+    {
+        std::lock_guard<std::mutex> lock(refreshMutex);
+        if (!refresherRunning || !refreshPending.emplace(key).second) return;
+        refreshQueue.emplace(std::string(key), version);
+    }
+    refreshCV.notify_one();
+}
+
+// A key stays in refreshPending until its reload is applied, so reads in the
+// refresh window queue it once. A failed reload is retried by the next read.
+void HashMap::refreshLoop()
+{
+    while (true) {
+        std::pair<std::string, uint64_t> item;
+        {
+            std::unique_lock<std::mutex> lock(refreshMutex);
+            refreshCV.wait(lock, [this] { return !refresherRunning || !refreshQueue.empty(); });
+            if (!refresherRunning) return;
+            item = std::move(refreshQueue.front());
+            refreshQueue.pop();
+        }
+        const LoaderEntry* entry = loaderFor(item.first);
+        std::string value;
+        int ttl = 0;
+        uint64_t version = 0;
+        // CONFLICT means the key was written or expired since it was read; that wins.
+        if (entry && runLoader(entry->loader, item.first, value, ttl) == OpStatus::OK) {
+            storeLoaded(item.first, item.second, value, ttl, version);
+        }
+        std::lock_guard<std::mutex> lock(refreshMutex);
+        refreshPending.erase(item.first);
+    }
+}
+
+void HashMap::stopRefresher()
+{
+    {
+        std::lock_guard<std::mutex> lock(refreshMutex);
+        refresherRunning = false;
+    }
+    refreshCV.notify_all();
+    if (refresher.joinable()) refresher.join();
+}
+
+void HashMap::setHotKeySampleRate(uint32_t sampleEvery)
+{
+    hotReads.setSampleRate(sampleEvery);
+    hotWrites.setSampleRate(sampleEvery);
+}
+
+// The blocking calls wait on the async path; the promise is shared with the
+// completion so a worker finishing after a timeout still has somewhere to write.
+OpResult HashMap::runBlocking(Task &&task, bool isRead)
+{
+    auto result = std::make_shared<std::promise<OpResult>>();
+    std::future<OpResult> future = result->get_future();
+    // Removes and TTL changes are let through: they are how a full map gets room again.
+    if (!isRead && task.type != TaskType::REMOVE && task.type != TaskType::TOUCH && quotaFull()) {
+        return OpResult{OpStatus::FULL, std::string()};
+    }
+    Trace::Span wait("await_worker");
+    task.done = [result](const OpResult& r) { result->set_value(r); };
+    bool queued = isRead ? enqueueRead(std::move(task)) : enqueueWrite(std::move(task));
+    if (!queued) return OpResult{OpStatus::OVERLOADED, std::string()};
+
+    if (future.wait_for(TASK_TIMEOUT) == std::future_status::timeout) {
+        return OpResult{OpStatus::TIMEOUT, std::string()};
+    }
+    return future.get();
+}
+
+OpStatus HashMap::remove(std::string_view key)
+{
+    return runBlocking(Task(TaskType::REMOVE, std::string(key), nullptr), false).status;
+}
+
+OpStatus HashMap::incrBy(const std::string &key, int64_t delta, int64_t &value)
+{
+    Task task(TaskType::INCR, key, nullptr);
+    task.delta = delta;
+    OpResult r = runBlocking(std::move(task), false);
+    if (r.status == OpStatus::OK) value = std::stoll(r.value);
+    return r.status;
+}
+
+OpStatus HashMap::compareAndSet(const std::string &key, uint64_t expectedVersion, const std::string &value, int ttl, uint64_t &version)
+{
+    Task task(TaskType::CAS, key, value, ttl, nullptr);
+    task.version = expectedVersion;
+    OpResult r = runBlocking(std::move(task), false);
+    version = r.version;
+    return r.status;
+}
+
+OpStatus HashMap::setBlocking(const std::string &key, const std::string &value, int ttl, uint64_t &version)
+{
+    OpResult r = runBlocking(Task(TaskType::SET, key, value, ttl, nullptr), false);
+    version = r.version;
+    return r.status;
+}
+
+OpStatus HashMap::append(const std::string &key, const std::string &suffix, uint64_t &version)
+{
+    OpResult r = runBlocking(Task(TaskType::APPEND, key, suffix, 0, nullptr), false);
+    version = r.version;
+    return r.status;
+}
+
+OpStatus HashMap::touch(const std::string &key, int ttl)
+{
+    return runBlocking(Task(TaskType::TOUCH, key, std::string(), ttl, nullptr), false).status;
+}
+
+void HashMap::enableEvents(bool enabled)
+{
+    if (enabled && !events.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(eventsMutex);
+        if (!eventRing) {
+            eventRing.reset(new EventRing<ChangeEvent>(EVENT_RING_CAPACITY));
+            events.store(eventRing.get(), std::memory_order_release);
+        }
+    }
+    eventsEnabled.store(enabled, std::memory_order_release);
+}
+
+void HashMap::publishEvent(ChangeEvent::Type type, const std::string &key, uint64_t version)
+{
+    if (!eventsEnabled.load(std::memory_order_acquire)) return;
+    if (!events.load(std::memory_order_acquire)->tryPush(ChangeEvent{type, key, version})) {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // Pairs with the fence in waitEvent(): either the consumer sees this event
+    // when it checks the ring, or this sees it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (eventWaiters.load(std::memory_order_relaxed) > 0) eventsCV.notify_one();
+}
+
+bool HashMap::pollEvent(ChangeEvent &event)
+{
+    EventRing<ChangeEvent> *ring = events.load(std::memory_order_acquire);
+    return ring && ring->tryPop(event);
+}
+
+bool HashMap::waitEvent(ChangeEvent &event, std::chrono::milliseconds timeout)
+{
+    if (pollEvent(event)) return true;
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock<std::mutex> lock(eventsMutex);
+    uint64_t wakeups = eventWakeups;
+    eventWaiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool popped = false;
+    // A writer can push and notify between the poll and the wait, since it does
+    // not take the lock; waiting in slices catches that event soon after.
+    while (!(popped = pollEvent(event)) && eventWakeups == wakeups) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) break;
+        eventsCV.wait_for(lock, std::min<std::chrono::steady_clock::duration>(deadline - now, EVENT_WAIT_SLICE));
+    }
+    eventWaiters.fetch_sub(1);
+    return popped;
+}
+
+void HashMap::wakeEventWaiters()
+{
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    ++eventWakeups;
+    eventsCV.notify_all();
+}
+
+void HashMap::enableOrderedIndex()
+{
+    // Loading takes an index lock for every insert, so finish it first.
+    hydrateAll();
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    for (OrderedIndexStripe& stripe : orderedIndex) locks.emplace_back(stripe.mutex);
+    if (orderedIndexEnabled.load(std::memory_order_relaxed)) return;
+    // Publish the flag first so writers racing with the rebuild queue up on the locks.
+    orderedIndexEnabled.store(true, std::memory_order_release);
+    for (const auto& item : getAllForPersistence()) {
+        orderedIndexStripe(item.key).keys.insert(item.key);
+    }
+}
+
+// Merges the stripes in key order, starting at `from` (or just past `after`)
+// and stopping at the first key outside the range.
+std::vector<std::string> HashMap::scanOrdered(const std::string &from, const std::string &after, size_t limit,
+                                              const std::function<bool(const std::string&)> &inRange) const
+{
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    std::set<std::string>::const_iterator next[ORDERED_INDEX_STRIPES];
+    bool fromAfter = !after.empty() && after >= from;
+    for (size_t i = 0; i < ORDERED_INDEX_STRIPES; ++i) {
+        locks.emplace_back(orderedIndex[i].mutex);
+        next[i] = fromAfter ? orderedIndex[i].keys.upper_bound(after) : orderedIndex[i].keys.lower_bound(from);
+    }
+
+    std::vector<std::string> keys;
+    while (keys.size() < limit) {
+        size_t smallest = ORDERED_INDEX_STRIPES;
+        for (size_t i = 0; i < ORDERED_INDEX_STRIPES; ++i) {
+            if (next[i] == orderedIndex[i].keys.end()) continue;
+            if (smallest == ORDERED_INDEX_STRIPES || *next[i] < *next[smallest]) smallest = i;
+        }
+        if (smallest == ORDERED_INDEX_STRIPES || !inRange(*next[smallest])) break;
+        keys.push_back(*next[smallest]++);
+    }
+    return keys;
+}
+
+std::vector<std::string> HashMap::scanPrefix(const std::string &prefix, size_t limit, const std::string &after) const
+{
+    return scanOrdered(prefix, after, limit, [&prefix](const std::string &key) {
+        return key.compare(0, prefix.size(), prefix) == 0;
+    });
+}
+
+std::vector<std::string> HashMap::scanRange(const std::string &from, const std::string &to, size_t limit, const std::string &after) const
+{
+    return scanOrdered(from, after, limit, [&to](const std::string &key) {
+        return to.empty() || key < to;
+    });
+}
+
+static size_t defaultWorkerCount()
+{
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware == 0 ? 2 : hardware;
+}
+
+BASIC_HASH_MAP_TEMPLATE
+BASIC_HASH_MAP::BasicHashMap(const std::string &persistenceFile, size_t maxQueueDepth) : HashMap(persistenceFile, maxQueueDepth), capacity(INITIAL_CAPACITY), size(0), running(true), workerCount(defaultWorkerCount())
+{
+    table = std::vector<std::atomic<Node*>>(this->capacity);
+    quotaEvicts = !std::is_same<EvictionPolicy, NoEviction>::value;
+    contention.reset(new std::atomic<uint64_t>[this->capacity]());
+    bucketStamps.reset(new std::atomic<uint64_t>[this->capacity]());
+
+    for (size_t i=0;i<workerCount;++i)
+    {
+        workerThread.emplace_back(&BasicHashMap::workerFunction,this);
+    }
+
+    cleanupThread = std::thread(&BasicHashMap::cleanupExpired, this);
+    evictionThread = std::thread(&BasicHashMap::evictionMonitor,this);
     if (!persistenceFile.empty())
     {
         try{
@@ -42,35 +737,40 @@ HashMap:: HashMap(const std::string &persistenceFile) : capacity(INITIAL_CAPACIT
     }
 }
 
-HashMap::~HashMap()
+BASIC_HASH_MAP_TEMPLATE
+BASIC_HASH_MAP::~BasicHashMap()
 {
-
-    running = false;
-    lruRunning = false;
-    workersRunning = false;
-
-    taskCV.notify_all();
+    // Refreshes write through the workers, so they stop first.
+    stopRefresher();
+    {
+        std::lock_guard<std::mutex> lock(expiryGlobalMutex);
+        std::lock_guard<std::mutex> evictionLock(evictionMutex);
+        running = false;
+    }
+    stopWorkers();
+    stopHeapLoader();
     expiryGlobalCV.notify_all();
-    lruCV.notify_all();
-    
+    evictionCV.notify_all();
+
     for (auto &t: workerThread)
     {
         if (t.joinable()) t.join();
     }
     if (cleanupThread.joinable()) cleanupThread.join();
 
-    if (lruThread.joinable()) lruThread.join();
+    if (evictionThread.joinable()) evictionThread.join();
 
 
+    if (!heapFileName.empty()) saveHeap();
     try {
-        Persistence::saveToFile(*this, "hashmap.json");
+        if (!PersistenceFileName.empty()) Persistence::saveToFile(*this, PersistenceFileName);
     }
     catch (const std::exception& e)
     {
         std::cerr << "Falied to save to persistence file:"<<e.what() <<std::endl;
     }
 
-    processDeferredDeletes(true);
+    reclaim.collect(true);
 
     for (size_t i = 0; i < table.size(); ++i) {
         deleteList(table[i].load(std::memory_order_relaxed));
@@ -78,7 +778,14 @@ HashMap::~HashMap()
     }
 }
 
-void HashMap::deleteList(Node* head) {
+BASIC_HASH_MAP_TEMPLATE
+std::string BASIC_HASH_MAP::engine_name() const
+{
+    return std::string(HashPolicy::name()) + "/" + EvictionPolicy::name() + "/" + ReclaimPolicy::name() + "/" + ConcurrencyPolicy::name();
+}
+
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::deleteList(Node* head) {
     Node* current = head;
     while (current) {
         Node* temp = current;
@@ -87,414 +794,990 @@ void HashMap::deleteList(Node* head) {
     }
 }
 
-void HashMap::scheduleDeferredDelete(Node* node) {
-    if (!node) return;
-    std::lock_guard<std::mutex> lock(deferredDeleteMutex);
-    deferredDeleteQueue.push_back(node);
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::prefetchBucket(size_t index) const
+{
+#if defined(__GNUC__)
+    // Only the address is used; the node may be retired meanwhile, which a
+    // prefetch does not mind.
+    __builtin_prefetch(table[index].load(std::memory_order_relaxed));
+#else
+    (void)index;
+#endif
 }
 
-void HashMap::processDeferredDeletes(bool forceAll) {
-    std::vector<Node*> toDeleteNow;
-    {
-        std::lock_guard<std::mutex> lock(deferredDeleteMutex);
-        if (deferredDeleteQueue.empty()) return;
-
-        deferredDeleteQueue.erase(
-            std::remove_if(deferredDeleteQueue.begin(), deferredDeleteQueue.end(),
-                           [&](Node* node) {
-                               if (node && node->refCount.load(std::memory_order_acquire) == 0) {
-                                   toDeleteNow.push_back(node);
-                                   return true;
-                               }
-                               if (forceAll && node && node->refCount.load(std::memory_order_acquire) > 0) {
-                                   std::cerr << "Warning: Node " << node->key << " has refCount "
-                                            << node->refCount.load() << " during forced delete processing." << std::endl;
-                               }
-                               return false;
-                           }),
-            deferredDeleteQueue.end());
-    }
+// Each wakeup runs a batch ordered by bucket, so neighbouring tasks share
+// bucket heads and stripe locks. The sort is stable: tasks on one key keep
+// their order. A set directly followed by another set to the same key is not
+// applied (last writer wins) and completes with the later set's result.
+// While one task runs, the bucket heads of the next few are prefetched.
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::workerFunction() {
+    std::vector<Task> batch;
+    std::vector<size_t> buckets;
+    std::vector<size_t> order;
+    std::vector<size_t> supersededBy;
+    std::vector<OpResult> results;
+    const size_t none = SIZE_MAX;
 
-    for (Node* node : toDeleteNow) {
-        delete node;
-    }
-}
+    while (nextTasks(batch, workerCount)) {
+        const size_t n = batch.size();
+        buckets.resize(n);
+        order.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            buckets[i] = hashFunction(batch[i].key, capacity);
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return buckets[a] < buckets[b]; });
 
-void HashMap::workerFunction() {
-    while (workersRunning.load(std::memory_order_relaxed)) {
-        std::shared_ptr<Task> task;
-        {
-            std::unique_lock<std::mutex> lock(taskMutex);
-            taskCV.wait(lock, [&]() {
-                return !taskQueue.empty() || !workersRunning;
-            });
-            if (!workersRunning.load(std::memory_order_relaxed) && taskQueue.empty()) {
+        supersededBy.assign(n, none);
+        for (size_t i = 0; i < n; ++i) {
+            const Task& task = batch[order[i]];
+            if (task.type != TaskType::SET) continue;
+            for (size_t j = i + 1; j < n && buckets[order[j]] == buckets[order[i]]; ++j) {
+                if (batch[order[j]].key != task.key) continue;
+                if (batch[order[j]].type == TaskType::SET) supersededBy[order[i]] = order[j];
                 break;
             }
-            if (taskQueue.empty()) { 
+        }
+
+        results.assign(n, OpResult{OpStatus::OK, std::string()});
+        for (size_t i = 0; i < std::min(n, PREFETCH_DISTANCE); ++i) prefetchBucket(buckets[order[i]]);
+        size_t collapsed = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (i + PREFETCH_DISTANCE < n) prefetchBucket(buckets[order[i + PREFETCH_DISTANCE]]);
+            size_t t = order[i];
+            if (supersededBy[t] != none) {
+                ++collapsed;
                 continue;
             }
-            task = taskQueue.front();
-            taskQueue.pop();
+            if (batch[t].traceId) {
+                Trace::Scope trace(batch[t].traceId);
+                Trace::record("queued", batch[t].enqueuedNs, Trace::now(), "batch", static_cast<int64_t>(n));
+                Trace::Span span("execute");
+                runTask(batch[t], results[t]);
+            } else {
+                runTask(batch[t], results[t]);
+            }
         }
-        if (task)
-        {
+        if (collapsed) collapsedSets.fetch_add(collapsed, std::memory_order_relaxed);
+
+        // Completions run after the whole batch, so a superseded set can
+        // report the result of the set that replaced it.
+        for (size_t t = 0; t < n; ++t) {
+            if (!batch[t].done) continue;
+            size_t source = t;
+            while (supersededBy[source] != none) source = supersededBy[source];
+            // A throwing completion must not take the worker down with it.
             try {
-                switch (task->type) {
-                    case TaskType::SET:
-                        setInternal(task->key, task->value, task->ttl);
-                        // task->result.set_value("OK");
-                        break;
-                    case TaskType::GET:
-                        task->result.set_value(getInternal(task->key));
-                        break;
-                    case TaskType::REMOVE:
-                        task->result.set_value(removeInternal(task->key) ? "true" : "false");
-                        break;
-                }
+                batch[t].done(results[source]);
             } catch (const std::exception& e) {
-                try {
-                    task->result.set_exception(std::current_exception());
-                } catch (...) {
-
-                }
+                std::cerr << "Completion for key " << batch[t].key << " threw: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "Completion for key " << batch[t].key << " threw a non-standard exception" << std::endl;
             }
         }
     }
 }
 
-void HashMap::set(const std::string &key, const std::string &value, int ttl)
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::runTask(Task &task, OpResult &result)
 {
-    auto task=std::make_shared<Task>(TaskType::SET, key, value, ttl);
-    {
-        std::lock_guard<std::mutex> lock(taskMutex);
-        taskQueue.push(task);
+    try {
+        hydrate(task.key);
+        switch (task.type) {
+            case TaskType::SET:
+                result.version = setInternal(task.key, task.value, task.ttl);
+                break;
+            case TaskType::GET:
+                result.status = getInternal(task.key, result.value, &result.version);
+                break;
+            case TaskType::REMOVE:
+                result.status = removeInternal(task.key) ? OpStatus::OK : OpStatus::NOT_FOUND;
+                break;
+            case TaskType::INCR:
+                incrInternal(task.key, task.delta, result);
+                break;
+            case TaskType::CAS:
+                casInternal(task.key, task.version, task.value, task.ttl, result);
+                break;
+            case TaskType::APPEND:
+                appendInternal(task.key, task.value, result);
+                break;
+            case TaskType::TOUCH:
+                result.status = touchInternal(task.key, task.ttl);
+                break;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Worker error for key '" << task.key << "': " << e.what() << std::endl;
+        result.status = OpStatus::FAILED;
     }
-    taskCV.notify_one();
 }
 
-std::string HashMap::get(const std::string &key)
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::restore(const std::string &key, const std::string &value, int ttl, bool compressed)
 {
-    auto task = std::make_shared<Task>(TaskType::GET, key);
-    std::future<std::string> future = task->result.get_future();
-    {
-        std::lock_guard<std::mutex> lock(taskMutex);
-        taskQueue.push(task);
-    }
-    taskCV.notify_one();
-    try {
-        if (future.wait_for(std::chrono::seconds(5)) == std::future_status::timeout) {
+    hydrate(key);
+    setInternal(key, value, ttl, compressed);
+}
 
-            return "Error: Timeout";
-        }
-        return future.get();
-    } catch (const std::exception& e) { 
-        return "Error: " + std::string(e.what());
-    }
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::restoreRemove(const std::string &key)
+{
+    hydrate(key);
+    removeInternal(key);
 }
 
-bool HashMap::remove(const std::string &key)
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::loadEntry(const std::string &key, const std::string &value, int ttl, bool compressed)
 {
-    auto task=std::make_shared<Task>(TaskType::REMOVE, key);
-    std::future<std::string> future = task->result.get_future();
-    {
-        std::lock_guard<std::mutex> lock(taskMutex);
-        taskQueue.push(task);
-    }
-    taskCV.notify_one();
-    try {
-        if (future.wait_for(std::chrono::seconds(5)) == std::future_status::timeout) {
-            return false;
-        }
-        return future.get() == "true";
-    } catch (const std::exception& e) {
-        return false;
-    }
+    setInternal(key, value, ttl, compressed);
+}
+
+// Same admission rule as runBlocking(): no new data once a map that cannot
+// evict is full.
+BASIC_HASH_MAP_TEMPLATE
+OpStatus BASIC_HASH_MAP::storeLoaded(const std::string &key, uint64_t expectedVersion, const std::string &value, int ttl, uint64_t &version)
+{
+    if (quotaFull()) return OpStatus::FULL;
+    OpResult result{OpStatus::OK, std::string()};
+    casInternal(key, expectedVersion, value, ttl, result);
+    version = result.version;
+    return result.status;
+}
+
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::afterWrite(const std::string &key, uint64_t version, bool inserted)
+{
+    eviction.recordWrite(key);
+    if (inserted) syncOrderedIndex(key);
+    if (quotaEvicts && overQuota()) evictionCV.notify_one();
+    // Entries loaded from the heap image were written by an earlier run.
+    if (loadingFromHeap) return;
+    publishEvent(ChangeEvent::Type::SET, key, version);
+    notifyMutation(key);
+}
+
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::afterRemove(const std::string &key, ChangeEvent::Type cause)
+{
+    syncOrderedIndex(key);
+    publishEvent(cause, key);
+    notifyMutation(key);
 }
 
-void HashMap::setInternal(const std::string &key, const std::string &val,int ttl)
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::updateInternal(const std::string &key, const NodeBuilder &build, OpResult &result)
 {
     size_t index=hashFunction(key,capacity);
-    time_t expiry = ttl ? time(nullptr) + ttl : 0;
+    if (!loadingFromHeap) hotWrites.record(key);
+    ReclaimGuard pin(reclaim);
+    Trace::Span span("cas_update");
+    int64_t retries = 0;
 
-    Node* new_node = new Node(key, val, expiry);
+    Node* new_node = nullptr;
+    Node* built_from = nullptr;
+    time_t seen_expiry = 0;
 
     Node* current_head;
     Node* old_node_to_retire = nullptr;
-    
+
     do {
-        current_head = table[index].load(std::memory_order_acquire);
-        Node* current = current_head;
-        Node* prev = nullptr;
-        old_node_to_retire = nullptr;
-
-        while (current != nullptr) {
-            if (current->key == key) {
-                old_node_to_retire = current; 
-                break;
+        bool inserted = false;
+        bool replaced = false;
+        {
+            WriteGuard guard(concurrency, index);
+            if (guard.contended()) contention[index].fetch_add(1, std::memory_order_relaxed);
+            current_head = table[index].load(std::memory_order_acquire);
+            Node* current = current_head;
+            Node* prev = nullptr;
+            old_node_to_retire = nullptr;
+
+            while (current != nullptr) {
+                if (current->hasKey(key)) {
+                    old_node_to_retire = current;
+                    break;
+                }
+                prev = current;
+                current = current->next.load(std::memory_order_acquire);
             }
-            prev = current;
-            current = current->next.load(std::memory_order_acquire);
-        }
 
-        if (old_node_to_retire) {
-            new_node->next.store(old_node_to_retire->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
-        } else {
-            new_node->next.store(current_head, std::memory_order_relaxed);
-        }
+            // (Re)build only when the node we would replace is not the one the
+            // pending node was derived from; the pending node is still private.
+            if (!new_node || built_from != old_node_to_retire) {
+                if (new_node) accountValue(new_node, -1);
+                delete new_node;
+                const Node* live = old_node_to_retire;
+                ReclaimPolicy::acquire(old_node_to_retire);
+                if (live && live->expiry != 0 && time(nullptr) > live->expiry) live = nullptr;
+                seen_expiry = old_node_to_retire ? old_node_to_retire->expiry.load() : 0;
+                new_node = build(live, result);
+                ReclaimPolicy::release(old_node_to_retire);
+                if (!new_node) return;
+                built_from = old_node_to_retire;
+                // Counted now: once published, another writer may retire it.
+                accountValue(new_node, 1);
+            }
+
+            if (old_node_to_retire) {
+                new_node->next.store(old_node_to_retire->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            } else {
+                new_node->next.store(current_head, std::memory_order_relaxed);
+            }
+
+            if (old_node_to_retire && old_node_to_retire == current_head) {
+                replaced = table[index].compare_exchange_weak(current_head, new_node,
+                                                             std::memory_order_release,
+                                                             std::memory_order_relaxed);
+            }
 
-        if (old_node_to_retire == current_head) {
-            if (table[index].compare_exchange_weak(current_head, new_node,
-                                                  std::memory_order_release,
-                                                  std::memory_order_relaxed)) {
-                if (old_node_to_retire) {
-                     scheduleDeferredDelete(old_node_to_retire);
+            else if (old_node_to_retire == nullptr) {
+                inserted = table[index].compare_exchange_weak(current_head, new_node,
+                                                             std::memory_order_release,
+                                                             std::memory_order_relaxed);
+            }
+
+            else {
+                Node* expected = old_node_to_retire;
+                replaced = prev && prev->next.compare_exchange_weak(expected, new_node,
+                                                                   std::memory_order_release, std::memory_order_relaxed);
+            }
+
+            if (replaced) {
+                // A touch() that landed on the old node after we copied its TTL
+                // must not be lost; carry it over unless build chose a new TTL.
+                time_t latest = old_node_to_retire->expiry.load();
+                if (latest != seen_expiry) {
+                    new_node->expiry.compare_exchange_strong(seen_expiry, latest);
                 }
-                updateLRU(key);
-                return;
+                accountValue(old_node_to_retire, -1);
+                reclaim.retire(old_node_to_retire);
             }
+            if (inserted || replaced) bumpStamp(index);
+        }
+
+        if (inserted) {
+            size.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (inserted || replaced) {
+            result.version = new_node->version;
+            afterWrite(key, result.version, inserted);
+            return;
         }
+        contention[index].fetch_add(1, std::memory_order_relaxed);
+        span.setArg("retries", ++retries);
+
+        } while (true);
+}
+
+BASIC_HASH_MAP_TEMPLATE
+uint64_t BASIC_HASH_MAP::setInternal(const std::string &key, const std::string &val,int ttl, bool encoded)
+{
+    time_t expiry = ttl ? time(nullptr) + ttl : 0;
+    OpResult result{OpStatus::OK, std::string()};
+    // Compressed once, outside the CAS loop.
+    std::string packed;
+    bool compressed = !encoded && encodeValue(val, packed);
+    const std::string& stored = compressed ? packed : val;
+    updateInternal(key, [&](const Node*, OpResult&) {
+        return new Node(key, stored, expiry, nextVersion(), compressed || encoded);
+    }, result);
+    return result.version;
+}
 
-        else if (old_node_to_retire == nullptr) {
-            if (table[index].compare_exchange_weak(current_head, new_node,
-                                                  std::memory_order_release,
-                                                  std::memory_order_relaxed)) {
-                size.fetch_add(1, std::memory_order_relaxed);
-                updateLRU(key);
-                return;
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::incrInternal(const std::string &key, int64_t delta, OpResult &result)
+{
+    updateInternal(key, [&](const Node* current, OpResult& r) -> Node* {
+        int64_t value = 0;
+        if (current) {
+            std::string text;
+            decodeValue(current, text);
+            char* end = nullptr;
+            errno = 0;
+            value = std::strtoll(text.c_str(), &end, 10);
+            if (text.empty() || errno == ERANGE || end != text.c_str() + text.size()) {
+                r.status = OpStatus::INVALID;
+                return nullptr;
             }
         }
+        if ((delta > 0 && value > INT64_MAX - delta) || (delta < 0 && value < INT64_MIN - delta)) {
+            r.status = OpStatus::INVALID;
+            return nullptr;
+        }
+        r.status = OpStatus::OK;
+        r.value = std::to_string(value + delta);
+        return new Node(key, r.value, current ? current->expiry.load() : 0, nextVersion());
+    }, result);
+}
+
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::casInternal(const std::string &key, uint64_t expectedVersion, const std::string &value, int ttl, OpResult &result)
+{
+    time_t expiry = ttl ? time(nullptr) + ttl : 0;
+    std::string packed;
+    bool compressed = encodeValue(value, packed);
+    updateInternal(key, [&](const Node* current, OpResult& r) -> Node* {
+        uint64_t currentVersion = current ? current->version : 0;
+        if (currentVersion != expectedVersion) {
+            r.status = OpStatus::CONFLICT;
+            r.version = currentVersion;
+            return nullptr;
+        }
+        r.status = OpStatus::OK;
+        return new Node(key, compressed ? packed : value, expiry, nextVersion(), compressed);
+    }, result);
+}
+
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::appendInternal(const std::string &key, const std::string &suffix, OpResult &result)
+{
+    updateInternal(key, [&](const Node* current, OpResult&) {
+        std::string value;
+        if (current) decodeValue(current, value);
+        value.append(suffix);
+        std::string packed;
+        if (encodeValue(value, packed)) return new Node(key, std::move(packed), current ? current->expiry.load() : 0, nextVersion(), true);
+        return new Node(key, std::move(value), current ? current->expiry.load() : 0, nextVersion());
+    }, result);
+}
 
-        else { 
+BASIC_HASH_MAP_TEMPLATE
+OpStatus BASIC_HASH_MAP::touchInternal(const std::string &key, int ttl)
+{
+    size_t index = hashFunction(key, capacity);
+    time_t now = time(nullptr);
+    time_t expiry = ttl ? now + ttl : 0;
+    ReclaimGuard pin(reclaim);
 
-            if (prev && prev->next.compare_exchange_weak(old_node_to_retire, new_node,
-                                                        std::memory_order_release, std::memory_order_relaxed)) {
-                scheduleDeferredDelete(old_node_to_retire);
-                updateLRU(key);
-                return;
+    // The node is updated in place. If it was replaced concurrently we retry on
+    // the successor; updateInternal carries the TTL forward for the other order.
+    while (true) {
+        bool still_linked = false;
+        {
+            WriteGuard guard(concurrency, index);
+            Node* found = nullptr;
+            Node* current = table[index].load(std::memory_order_acquire);
+            ReclaimPolicy::acquire(current);
+            while (current != nullptr) {
+                if (current->hasKey(key)) {
+                    found = current;
+                    break;
+                }
+                Node* nextNode = current->next.load(std::memory_order_acquire);
+                ReclaimPolicy::acquire(nextNode);
+                ReclaimPolicy::release(current);
+                current = nextNode;
             }
+            if (!found) return OpStatus::NOT_FOUND;
+
+            time_t old_expiry = found->expiry.load();
+            if (old_expiry != 0 && now > old_expiry) {
+                ReclaimPolicy::release(found);
+                return OpStatus::NOT_FOUND;
+            }
+            found->expiry.store(expiry);
+            found->lastAccessed.store(now, std::memory_order_relaxed);
+            bumpStamp(index);
+
+            Node* n = table[index].load(std::memory_order_acquire);
+            ReclaimPolicy::acquire(n);
+            while (n != nullptr) {
+                if (n->hasKey(key)) {
+                    still_linked = (n == found);
+                    break;
+                }
+                Node* nextNode = n->next.load(std::memory_order_acquire);
+                ReclaimPolicy::acquire(nextNode);
+                ReclaimPolicy::release(n);
+                n = nextNode;
+            }
+            ReclaimPolicy::release(n);
+            ReclaimPolicy::release(found);
         }
+        if (still_linked) {
+            notifyMutation(key);
+            return OpStatus::OK;
+        }
+    }
+}
 
-        } while (true);
+// A hit in this thread's near cache returns without touching the table. On a
+// miss the bucket's stamp is read before the table, so if a write lands in
+// between, the entry is already stale when it is stored. A live entry is only
+// displaced by a different key one time in eight, which keeps the keys that
+// are read most often in the cache.
+BASIC_HASH_MAP_TEMPLATE
+OpStatus BASIC_HASH_MAP::lookup(std::string_view key, std::string &value, uint64_t *version, time_t *expiry)
+{
+    size_t slotCount = nearCacheSlots.load(std::memory_order_relaxed);
+    if (slotCount == 0) return getAt(hashFunction(key, capacity), key, value, version, expiry);
+
+    uint64_t hash = HashPolicy::hash(key);
+    size_t index = hash % capacity;
+    std::vector<NearCacheEntry>& slots = nearCache.forMap(instanceId, slotCount);
+    NearCacheEntry& entry = slots[(hash / capacity) % slots.size()];
+    uint64_t stamp = bucketStamps[index].load(std::memory_order_acquire);
+
+    if (entry.valid && entry.stamp == stamp && entry.key == key &&
+        (entry.expiry == 0 || time(nullptr) <= entry.expiry)) {
+        ++entry.hits;
+        if (++nearCache.pendingHits >= NEAR_CACHE_FLUSH_HITS) flushNearCacheHits(hotReads, readHits);
+        value.assign(entry.value);
+        if (version) *version = entry.version;
+        if (expiry) *expiry = entry.expiry;
+        return OpStatus::OK;
+    }
+
+    uint64_t foundVersion = 0;
+    time_t foundExpiry = 0;
+    OpStatus status = getAt(index, key, value, &foundVersion, &foundExpiry);
+    if (status != OpStatus::OK) return status;
+    if (version) *version = foundVersion;
+    if (expiry) *expiry = foundExpiry;
+
+    bool occupantLive = entry.valid && entry.key != key &&
+                        bucketStamps[entry.bucket].load(std::memory_order_relaxed) == entry.stamp;
+    if (value.size() <= NEAR_CACHE_MAX_VALUE && (!occupantLive || (nearCache.nextRandom() & 7) == 0)) {
+        for (; entry.hits > 0; --entry.hits) hotReads.record(entry.key);
+        entry.key.assign(key.data(), key.size());
+        entry.value.assign(value);
+        entry.version = foundVersion;
+        entry.stamp = stamp;
+        entry.bucket = index;
+        entry.expiry = foundExpiry;
+        entry.valid = true;
+    }
+    return status;
 }
 
-std::string HashMap::getInternal(const std::string &key) const
+BASIC_HASH_MAP_TEMPLATE
+OpStatus BASIC_HASH_MAP::get(std::string_view key, std::string &value, uint64_t *version)
 {
-    size_t index=hashFunction(key, capacity);
-    std::string result_value = "Key not found";
+    hydrate(key);
+    if (loaders.empty()) return lookup(key, value, version, nullptr);
+
+    uint64_t foundVersion = 0;
+    time_t expiry = 0;
+    OpStatus status = lookup(key, value, &foundVersion, &expiry);
+    if (status == OpStatus::NOT_FOUND) return loadMissing(key, value, version);
+    if (status == OpStatus::OK) {
+        if (version) *version = foundVersion;
+        refreshIfExpiring(key, foundVersion, expiry);
+    }
+    return status;
+}
+
+// Large values are not worth a near cache slot, so ranges always read the table.
+BASIC_HASH_MAP_TEMPLATE
+OpStatus BASIC_HASH_MAP::getRange(std::string_view key, const ByteRange &range, std::string &value, uint64_t &totalSize, uint64_t *version)
+{
+    hydrate(key);
+    return getAt(hashFunction(key, capacity), key, value, version, nullptr, &range, &totalSize);
+}
+
+BASIC_HASH_MAP_TEMPLATE
+OpStatus BASIC_HASH_MAP::getInternal(std::string_view key, std::string &value, uint64_t *version) const
+{
+    return getAt(hashFunction(key, capacity), key, value, version, nullptr);
+}
+
+// Finds the live entry for `key` in bucket `index` and hands it, pinned, to
+// read(node, expiry), which returns false if the value could not be decoded.
+BASIC_HASH_MAP_TEMPLATE
+template <class Read>
+OpStatus BASIC_HASH_MAP::readLive(size_t index, std::string_view key, Read &&read) const
+{
+    hotReads.record(key);
+    OpStatus status = OpStatus::NOT_FOUND;
     time_t now = 0;
+    ReclaimGuard pin(reclaim);
+    ReadGuard guard(concurrency, index);
     Node* current = table[index].load(std::memory_order_acquire);
-    incrementRefCount(current);
+    ReclaimPolicy::acquire(current);
 
     while (current!=nullptr)
     {
-        if (current->key == key)
+        if (current->hasKey(key))
         {
             if (now == 0) now = time(nullptr);
-            if (current->expiry!=0 && now> current->expiry)
+            time_t nodeExpiry = current->expiry.load();
+            if (nodeExpiry==0 || now <= nodeExpiry)
             {
-                result_value = "Key expired";
-            }
-            else {
                 current->lastAccessed.store(now, std::memory_order_relaxed);
-                result_value = current->value;
+                status = read(current, nodeExpiry) ? OpStatus::OK : OpStatus::FAILED;
             }
-            decrementRefCount(current);
-            return result_value;
+            ReclaimPolicy::release(current);
+            (status == OpStatus::OK ? readHits : readMisses).add();
+            return status;
         }
 
         Node* nextNode = current->next.load();
-        incrementRefCount(nextNode); 
-        decrementRefCount(current); 
+        ReclaimPolicy::acquire(nextNode);
+        ReclaimPolicy::release(current);
+        current = nextNode;
+    }
+    readMisses.add();
+    return status;
+}
+
+BASIC_HASH_MAP_TEMPLATE
+OpStatus BASIC_HASH_MAP::getAt(size_t index, std::string_view key, std::string &value, uint64_t *version, time_t *expiry,
+                               const ByteRange *range, uint64_t *totalSize) const
+{
+    return readLive(index, key, [&](const Node* node, time_t nodeExpiry) {
+        if (version) *version = node->version;
+        if (expiry) *expiry = nodeExpiry;
+        return range ? decodeRange(node, *range, value, *totalSize) : decodeValue(node, value);
+    });
+}
+
+BASIC_HASH_MAP_TEMPLATE
+OpStatus BASIC_HASH_MAP::view(std::string_view key, const ValueReader &reader)
+{
+    hydrate(key);
+    uint64_t foundVersion = 0;
+    time_t expiry = 0;
+    OpStatus status = readLive(hashFunction(key, capacity), key, [&](const Node* node, time_t nodeExpiry) {
+        foundVersion = node->version;
+        expiry = nodeExpiry;
+        if (!node->compressed) {
+            reader(std::string_view(node->value.data(), node->value.size()), node->version);
+            return true;
+        }
+        std::string decoded;
+        if (!ValueCodec::decompress(node->value, decoded)) return false;
+        reader(decoded, node->version);
+        return true;
+    });
+    if (loaders.empty()) return status;
+
+    if (status == OpStatus::OK) refreshIfExpiring(key, foundVersion, expiry);
+    if (status != OpStatus::NOT_FOUND) return status;
+    std::string loaded;
+    status = loadMissing(key, loaded, &foundVersion);
+    if (status == OpStatus::OK) reader(loaded, foundVersion);
+    return status;
+}
+
+BASIC_HASH_MAP_TEMPLATE
+bool BASIC_HASH_MAP::containsInternal(std::string_view key) const
+{
+    size_t index = hashFunction(key, capacity);
+    ReclaimGuard pin(reclaim);
+    ReadGuard guard(concurrency, index);
+    Node* current = table[index].load(std::memory_order_acquire);
+    ReclaimPolicy::acquire(current);
+
+    while (current != nullptr)
+    {
+        if (current->hasKey(key))
+        {
+            ReclaimPolicy::release(current);
+            return true;
+        }
+        Node* nextNode = current->next.load(std::memory_order_acquire);
+        ReclaimPolicy::acquire(nextNode);
+        ReclaimPolicy::release(current);
         current = nextNode;
     }
-    return result_value;
+    return false;
 }
 
-bool HashMap::removeInternal(const std::string & key)
+BASIC_HASH_MAP_TEMPLATE
+bool BASIC_HASH_MAP::removeInternal(const std::string & key, ChangeEvent::Type cause)
 {
     size_t index = hashFunction(key,capacity);
+    ReclaimGuard pin(reclaim);
+    Trace::Span span("cas_remove");
+    int64_t retries = 0;
 
     Node* node_to_retire = nullptr;
     Node* current_head;
 
     do {
-        current_head = table[index].load(std::memory_order_acquire);
-        Node* current = current_head;
-        Node* prev = nullptr;
-        node_to_retire = nullptr;
-
-        while (current != nullptr) {
-            if (current->key == key) {
-                node_to_retire = current;
-                break;
-            }
-            prev = current;
-            current = current->next.load(std::memory_order_acquire);
+        bool removed = false;
+        {
+            WriteGuard guard(concurrency, index);
+            if (guard.contended()) contention[index].fetch_add(1, std::memory_order_relaxed);
+            current_head = table[index].load(std::memory_order_acquire);
+            Node* current = current_head;
+            Node* prev = nullptr;
+            node_to_retire = nullptr;
 
-        }
+            while (current != nullptr) {
+                if (current->hasKey(key)) {
+                    node_to_retire = current;
+                    break;
+                }
+                prev = current;
+                current = current->next.load(std::memory_order_acquire);
 
-        if (node_to_retire == nullptr) {
-            return false;
-        }
+            }
 
-        Node* next_after_removed = node_to_retire->next.load(std::memory_order_relaxed);
-        if (node_to_retire == current_head) { 
-            if (table[index].compare_exchange_weak(current_head, next_after_removed,
-                                                  std::memory_order_release,
-                                                  std::memory_order_relaxed)) {
+            if (node_to_retire == nullptr) {
+                return false;
+            }
 
-                scheduleDeferredDelete(node_to_retire);
-                size.fetch_sub(1, std::memory_order_relaxed);
-                return true;
+            Node* next_after_removed = node_to_retire->next.load(std::memory_order_relaxed);
+            if (node_to_retire == current_head) {
+                removed = table[index].compare_exchange_weak(current_head, next_after_removed,
+                                                            std::memory_order_release,
+                                                            std::memory_order_relaxed);
+            } else {
+                Node* expected = node_to_retire;
+                removed = prev && prev->next.compare_exchange_weak(expected, next_after_removed,
+                                                                  std::memory_order_release,
+                                                                  std::memory_order_relaxed);
             }
-        } else {
-            if (prev && prev->next.compare_exchange_weak(node_to_retire, next_after_removed,
-                                                       std::memory_order_release,
-                                                       std::memory_order_relaxed)) {                               
-                scheduleDeferredDelete(node_to_retire);
-                size.fetch_sub(1, std::memory_order_relaxed);
-                return true;
+            if (removed) {
+                accountValue(node_to_retire, -1);
+                reclaim.retire(node_to_retire);
+                bumpStamp(index);
             }
         }
-    } while (true); 
-    return false;                                     
+
+        if (removed) {
+            size.fetch_sub(1, std::memory_order_relaxed);
+            afterRemove(key, cause);
+            return true;
+        }
+        contention[index].fetch_add(1, std::memory_order_relaxed);
+        span.setArg("retries", ++retries);
+    } while (true);
+    return false;
 }
 
-void HashMap::cleanupExpired() {
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::cleanupExpired() {
     while (running.load(std::memory_order_relaxed)) {
         {
             std::unique_lock<std::mutex> lock(expiryGlobalMutex);
             if (expiryGlobalCV.wait_for(lock, std::chrono::seconds(10), [this] { return !running.load(std::memory_order_relaxed); })) {
                 if (!running.load(std::memory_order_relaxed)) break;
             }
-        } 
+        }
 
         if (!running.load(std::memory_order_relaxed)) break;
-        
+
         time_t now = time(nullptr);
         std::vector<std::string> expired_keys;
-        
+
         for (size_t i = 0; i < capacity; ++i) {
+            ReclaimGuard pin(reclaim);
+            ReadGuard guard(concurrency, i);
             Node* current = table[i].load(std::memory_order_acquire);
-            incrementRefCount(current);
-            
+            ReclaimPolicy::acquire(current);
+
             Node* node_iter = current;
-            
-            
+
+
             while (node_iter != nullptr) {
-                
+
                 if (node_iter->expiry != 0 && now > node_iter->expiry) {
-                    expired_keys.push_back(node_iter->key); // Copy key
+                    expired_keys.emplace_back(node_iter->key.data(), node_iter->key.size());
                 }
                 Node* next_node = node_iter->next.load(std::memory_order_acquire);
-                incrementRefCount(next_node);
-                decrementRefCount(node_iter); 
+                ReclaimPolicy::acquire(next_node);
+                ReclaimPolicy::release(node_iter);
                 node_iter = next_node;
             }
-            if (node_iter) decrementRefCount(node_iter); 
-            else if (current) decrementRefCount(current);
         }
-        
+
+        // Applied directly: expiry must keep making progress while client writes are being shed.
         for (const auto& key : expired_keys) {
-            this->remove(key);
+            removeInternal(key, ChangeEvent::Type::EXPIRE);
         }
-        processDeferredDeletes();
-    }
-}
-
-
-void HashMap::updateLRU(const std::string &key) {
-    std::lock_guard<std::mutex> lock(lruMutex);
-    auto it = lruMap.find(key);
-    if (it != lruMap.end()) {
-        lruList.erase(it->second);
+        reclaim.collect();
     }
-    lruList.push_front(key);
-    lruMap[key] = lruList.begin();
 }
 
 
-void HashMap::lruMonitor() {
-    while (lruRunning.load(std::memory_order_relaxed)) {
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::evictionMonitor() {
+    while (running.load(std::memory_order_relaxed)) {
         {
-            std::unique_lock<std::mutex> lock(lruMutex);
-            if(lruCV.wait_for(lock, std::chrono::seconds(5), [this] { return !lruRunning.load(std::memory_order_relaxed); })) {
-                 if (!lruRunning.load(std::memory_order_relaxed)) break;
+            std::unique_lock<std::mutex> lock(evictionMutex);
+            if(evictionCV.wait_for(lock, std::chrono::seconds(5), [this] { return !running.load(std::memory_order_relaxed) || (quotaEvicts && overQuota()); })) {
+                 if (!running.load(std::memory_order_relaxed)) break;
             }
         }
 
-        if (!lruRunning.load(std::memory_order_relaxed)) break;
-        
+        if (!running.load(std::memory_order_relaxed)) break;
+
         if (size.load(std::memory_order_acquire) > MAX_CAPACITY) {
             std::string key_to_evict;
-            {
-                std::lock_guard<std::mutex> lock(lruMutex);
-                if (!lruList.empty()) {
-                    key_to_evict = lruList.back();
-                    lruList.pop_back();
-                    lruMap.erase(key_to_evict);
-                }
-            }
-            if (!key_to_evict.empty()) {
-                this->remove(key_to_evict);
+            if (eviction.pickVictim(key_to_evict)) {
+                removeInternal(key_to_evict, ChangeEvent::Type::EVICT);
             }
         }
-        processDeferredDeletes();
+        std::string victim;
+        while (quotaEvicts && overQuota() && eviction.pickVictim(victim)) {
+            removeInternal(victim, ChangeEvent::Type::EVICT);
+        }
+        reclaim.collect();
+        // Freed nodes may have emptied whole slab pages; let other size classes have them.
+        Slab::rebalance();
     }
 }
 
-void HashMap::print_map() const{
-    std::cout << "--- HashMap RCU (Size: " << size.load() << ", Capacity: " << capacity << ") ---" << std::endl;
+// Called after an insert or remove has been published. The index is made to
+// mirror the table as seen under the key's stripe lock, so whichever racing writer
+// syncs last leaves the index matching the final state of the key.
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::syncOrderedIndex(const std::string &key)
+{
+    if (!orderedIndexEnabled.load(std::memory_order_acquire)) return;
+    OrderedIndexStripe& stripe = orderedIndexStripe(key);
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    if (containsInternal(key)) {
+        stripe.keys.insert(key);
+    } else {
+        stripe.keys.erase(key);
+    }
+}
+
+BASIC_HASH_MAP_TEMPLATE
+void BASIC_HASH_MAP::print_map() const{
+    hydrateAll();
+    std::cout << "--- HashMap RCU " << engine_name() << " (Size: " << size.load() << ", Capacity: " << capacity << ") ---" << std::endl;
     for (size_t i = 0; i < capacity; ++i) {
+        ReclaimGuard pin(reclaim);
+        ReadGuard guard(concurrency, i);
         Node* current = table[i].load(std::memory_order_acquire);
         if (current) {
             std::cout << "Bucket[" << i << "]: ";
-            incrementRefCount(current);
+            ReclaimPolicy::acquire(current);
             Node* p_iter = current;
             while (p_iter) {
-                std::cout << "{" << p_iter->key << ":" << p_iter->value 
-                          << " (Refs: " << p_iter->refCount.load() 
+                std::cout << "{" << p_iter->key << ":" << (p_iter->compressed ? std::string_view("<compressed>") : std::string_view(p_iter->value))
+                          << " (Refs: " << p_iter->refCount.load()
                           << ", Exp: " << p_iter->expiry << ")} -> ";
                 Node* next_p = p_iter->next.load(std::memory_order_acquire);
-                incrementRefCount(next_p);
-                decrementRefCount(p_iter);
+                ReclaimPolicy::acquire(next_p);
+                ReclaimPolicy::release(p_iter);
                 p_iter = next_p;
             }
-            if(p_iter) decrementRefCount(p_iter); 
-            else if(current) decrementRefCount(current); 
             std::cout << "NULL" << std::endl;
         }
     }
     std::cout << "--- End HashMap RCU ---" << std::endl;
 }
 
-std::vector<HashMap::NodeData> HashMap::getAllForPersistence() const{
+BASIC_HASH_MAP_TEMPLATE
+std::vector<HashMap::NodeData> BASIC_HASH_MAP::getAllForPersistence() const{
+    hydrateAll();
     std::vector<HashMap::NodeData> data;
     data.reserve(size.load(std::memory_order_relaxed));
 
     for (size_t i = 0; i < capacity; ++i) {
+        ReclaimGuard pin(reclaim);
+        ReadGuard guard(concurrency, i);
         Node* current = table[i].load(std::memory_order_acquire);
-        incrementRefCount(current); 
+        ReclaimPolicy::acquire(current);
 
         Node* node_iter = current;
         while (node_iter) {
             NodeData nd = {
-                node_iter->key,
-                node_iter->value,
+                std::string(node_iter->key.data(), node_iter->key.size()),
+                std::string(node_iter->value.data(), node_iter->value.size()),
                 node_iter->expiry,
-                node_iter->lastAccessed.load(std::memory_order_relaxed)
+                node_iter->lastAccessed.load(std::memory_order_relaxed),
+                node_iter->compressed
             };
             data.push_back(nd);
 
             Node* next_node = node_iter->next.load(std::memory_order_acquire);
-            incrementRefCount(next_node);
-            decrementRefCount(node_iter); 
-            node_iter = next_node;     
+            ReclaimPolicy::acquire(next_node);
+            ReclaimPolicy::release(node_iter);
+            node_iter = next_node;
         }
-        if (node_iter) decrementRefCount(node_iter); 
-        else if(current) decrementRefCount(current); 
-
     }
     return data;
-}
\ No newline at end of file
+}
+
+static uint64_t reverseBits(uint64_t v)
+{
+    uint64_t r = 0;
+    for (int i = 0; i < 64; ++i) {
+        r = (r << 1) | (v & 1);
+        v >>= 1;
+    }
+    return r;
+}
+
+BASIC_HASH_MAP_TEMPLATE
+HashMap::ScanPage BASIC_HASH_MAP::scan(uint64_t cursor, size_t count) const
+{
+    hydrateAll();
+    ScanPage page;
+    page.cursor = cursor;
+    if (count == 0) count = 1;
+
+    const uint64_t mask = capacity - 1;
+    size_t emptyVisits = count * SCAN_EMPTY_VISITS_FACTOR;
+    time_t now = time(nullptr);
+
+    do {
+        {
+            ReclaimGuard pin(reclaim);
+            ReadGuard guard(concurrency, page.cursor & mask);
+            Node* current = table[page.cursor & mask].load(std::memory_order_acquire);
+            if (!current && emptyVisits > 0) --emptyVisits;
+            ReclaimPolicy::acquire(current);
+
+            while (current) {
+                time_t expiry = current->expiry.load(std::memory_order_relaxed);
+                if (expiry == 0 || now <= expiry) {
+                    page.keys.emplace_back(current->key.data(), current->key.size());
+                }
+                Node* next_node = current->next.load(std::memory_order_acquire);
+                ReclaimPolicy::acquire(next_node);
+                ReclaimPolicy::release(current);
+                current = next_node;
+            }
+        }
+
+        // Increment the reversed cursor: the high bits are set so the carry
+        // skips over them, which keeps the walk valid if the table grows or shrinks.
+        page.cursor |= ~mask;
+        page.cursor = reverseBits(page.cursor);
+        page.cursor++;
+        page.cursor = reverseBits(page.cursor);
+    } while (page.cursor != 0 && page.keys.size() < count && emptyVisits > 0);
+
+    return page;
+}
+
+BASIC_HASH_MAP_TEMPLATE
+bool BASIC_HASH_MAP::lookupEntry(std::string_view key, NodeData &out) const
+{
+    hydrate(key);
+    size_t index = hashFunction(key, capacity);
+    time_t now = time(nullptr);
+    ReclaimGuard pin(reclaim);
+    ReadGuard guard(concurrency, index);
+    Node* current = table[index].load(std::memory_order_acquire);
+    ReclaimPolicy::acquire(current);
+
+    while (current != nullptr)
+    {
+        if (current->hasKey(key))
+        {
+            time_t expiry = current->expiry.load();
+            bool live = expiry == 0 || now <= expiry;
+            if (live) {
+                out = NodeData{std::string(current->key.data(), current->key.size()), std::string(), expiry, current->lastAccessed.load(std::memory_order_relaxed)};
+                live = decodeValue(current, out.value);
+            }
+            ReclaimPolicy::release(current);
+            return live;
+        }
+        Node* nextNode = current->next.load(std::memory_order_acquire);
+        ReclaimPolicy::acquire(nextNode);
+        ReclaimPolicy::release(current);
+        current = nextNode;
+    }
+    return false;
+}
+
+BASIC_HASH_MAP_TEMPLATE
+HashMap::BucketStats BASIC_HASH_MAP::bucketStats(size_t limit) const
+{
+    hydrateAll();
+    BucketStats stats;
+    stats.buckets = capacity;
+    stats.histogram.assign(BUCKET_HISTOGRAM_SLOTS, 0);
+    std::vector<BucketInfo> all;
+    all.reserve(capacity);
+    size_t entries = 0;
+
+    for (size_t i = 0; i < capacity; ++i) {
+        size_t length = 0;
+        {
+            ReclaimGuard pin(reclaim);
+            ReadGuard guard(concurrency, i);
+            Node* n = table[i].load(std::memory_order_acquire);
+            ReclaimPolicy::acquire(n);
+            while (n != nullptr) {
+                ++length;
+                Node* nextNode = n->next.load(std::memory_order_acquire);
+                ReclaimPolicy::acquire(nextNode);
+                ReclaimPolicy::release(n);
+                n = nextNode;
+            }
+        }
+        uint64_t waits = contention[i].load(std::memory_order_relaxed);
+        stats.contention += waits;
+        stats.histogram[std::min(length, BUCKET_HISTOGRAM_SLOTS - 1)]++;
+        stats.maxChain = std::max(stats.maxChain, length);
+        if (length > 0) {
+            stats.nonEmpty++;
+            entries += length;
+        }
+        if (length > 0 || waits > 0) all.push_back(BucketInfo{i, length, waits});
+    }
+    if (stats.nonEmpty > 0) stats.meanChain = static_cast<double>(entries) / stats.nonEmpty;
+
+    size_t n = std::min(limit, all.size());
+    std::partial_sort(all.begin(), all.begin() + n, all.end(),
+                      [](const BucketInfo& a, const BucketInfo& b) { return a.length > b.length; });
+    stats.longest.assign(all.begin(), all.begin() + n);
+    std::partial_sort(all.begin(), all.begin() + n, all.end(),
+                      [](const BucketInfo& a, const BucketInfo& b) { return a.contention > b.contention; });
+    for (size_t i = 0; i < n && all[i].contention > 0; ++i) stats.mostContended.push_back(all[i]);
+    return stats;
+}
+
+bool EngineConfig::set(const std::string &option, const std::string &value)
+{
+    if (option == "--hash") {
+        if (value == FnvHash::name()) hash = Hash::FNV;
+        else if (value == MixedFnvHash::name()) hash = Hash::FNV_MIXED;
+        else return false;
+    } else if (option == "--eviction") {
+        if (value == LruEviction::name()) eviction = Eviction::LRU;
+        else if (value == NoEviction::name()) eviction = Eviction::NONE;
+        else return false;
+    } else if (option == "--reclaim") {
+        if (value == RefCountReclaim::name()) reclaim = Reclaim::REFCOUNT;
+        else if (value == EpochReclaim::name()) reclaim = Reclaim::EPOCH;
+        else return false;
+    } else if (option == "--concurrency") {
+        if (value == LockFree::name()) concurrency = Concurrency::LOCK_FREE;
+        else if (value == StripedLocks::name()) concurrency = Concurrency::STRIPED;
+        else return false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Resolves one policy at a time; the innermost call names a concrete
+// BasicHashMap, so every supported combination is instantiated here.
+template <class H, class E, class R>
+static std::unique_ptr<HashMap> makeWithConcurrency(const EngineConfig &config, const std::string &file, size_t depth)
+{
+    if (config.concurrency == EngineConfig::Concurrency::STRIPED) return std::make_unique<BasicHashMap<H, E, R, StripedLocks>>(file, depth);
+    return std::make_unique<BasicHashMap<H, E, R, LockFree>>(file, depth);
+}
+
+template <class H, class E>
+static std::unique_ptr<HashMap> makeWithReclaim(const EngineConfig &config, const std::string &file, size_t depth)
+{
+    if (config.reclaim == EngineConfig::Reclaim::EPOCH) return makeWithConcurrency<H, E, EpochReclaim>(config, file, depth);
+    return makeWithConcurrency<H, E, RefCountReclaim>(config, file, depth);
+}
+
+template <class H>
+static std::unique_ptr<HashMap> makeWithEviction(const EngineConfig &config, const std::string &file, size_t depth)
+{
+    if (config.eviction == EngineConfig::Eviction::NONE) return makeWithReclaim<H, NoEviction>(config, file, depth);
+    return makeWithReclaim<H, LruEviction>(config, file, depth);
+}
+
+std::unique_ptr<HashMap> makeHashMap(const EngineConfig &config, const std::string &persistenceFile, size_t maxQueueDepth)
+{
+    if (config.hash == EngineConfig::Hash::FNV_MIXED) return makeWithEviction<MixedFnvHash>(config, persistenceFile, maxQueueDepth);
+    return makeWithEviction<FnvHash>(config, persistenceFile, maxQueueDepth);
+}
@@ -1,144 +1,626 @@
-#ifndef HASH_MAP_H
-#define HASH_MAP_H
+#ifndef HASH_MAP_RCU_H
+#define HASH_MAP_RCU_H
 
-#include "fnv_hash.h"
+#include "hash_policies.h"
+#include "event_ring.h"
+#include "hot_keys.h"
+#include "mapped_heap.h"
+#include "trace.h"
 #include <vector>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <atomic>
 #include <ctime>
 #include <queue>
 #include <condition_variable>
-#include <nlohmann/json.hpp>
 #include <functional>
 #include <future>
 #include <list>
 #include <unordered_map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <set>
+#include <chrono>
+#include <cstdint>
 
 const size_t INITIAL_CAPACITY = 2048;
 const size_t MIN_CAPACITY = 2048;
 const size_t MAX_CAPACITY = 2048;
+// scan() cursors rely on the bucket count being a power of two.
+static_assert((INITIAL_CAPACITY & (INITIAL_CAPACITY - 1)) == 0, "capacity must be a power of two");
+// Bound on empty buckets visited per scan() call, as a multiple of `count`.
+const size_t SCAN_EMPTY_VISITS_FACTOR = 10;
+// Chain-length histogram size for bucketStats(); the last slot collects the rest.
+const size_t BUCKET_HISTOGRAM_SLOTS = 9;
+// Values larger than this are never copied into the near cache.
+const size_t NEAR_CACHE_MAX_VALUE = 4096;
+// Near-cache hits are counted per thread and folded into the shared read
+// counters and hot-key sampler once this many have built up.
+const uint32_t NEAR_CACHE_FLUSH_HITS = 256;
+// A value is only kept compressed if that saves at least 1/8 of its size.
+const size_t COMPRESSION_MIN_SAVING_DIVISOR = 8;
 
-class HashMap
-{
-    private:
-    struct Node{
-        std::string key;
-        std::string value;
-        time_t expiry;
-        std::atomic<time_t> lastAccessed;
-        std::atomic<Node*> next;
-        std::atomic<int> refCount;
+// Most tasks a worker takes per wakeup, and how many tasks ahead of the one
+// running it prefetches bucket heads for.
+const size_t WORKER_BATCH_SIZE = 64;
+const size_t PREFETCH_DISTANCE = 4;
+// Batch size histogram: slot n counts batches of 2^n to 2^(n+1)-1 tasks.
+const size_t BATCH_HISTOGRAM_SLOTS = 7;
+static_assert(size_t(1) << (BATCH_HISTOGRAM_SLOTS - 1) == WORKER_BATCH_SIZE, "one histogram slot per power of two");
+
+// High-water mark for queued tasks; writes beyond it are shed.
+const size_t DEFAULT_MAX_QUEUE_DEPTH = 65536;
+const std::chrono::seconds TASK_TIMEOUT(5);
+
+// INVALID: INCRBY on a non-integer value or overflow. CONFLICT: CAS version mismatch.
+// FULL: over the memory quota with an eviction policy that cannot make room.
+enum class OpStatus { OK, NOT_FOUND, OVERLOADED, TIMEOUT, FAILED, INVALID, CONFLICT, FULL };
+
+struct OpResult {
+    OpStatus status;
+    std::string value;
+    uint64_t version = 0;
+};
+
+// Invoked on the worker thread that executed the operation.
+using Completion = std::function<void(const OpResult &)>;
+
+// Read-through source for keys the map does not hold (HashMap::setLoader).
+// Fills `value` and sets `ttl` (seconds, 0 = none) to cache it with, and
+// returns OK. NOT_FOUND is passed on as a miss and nothing is cached; any
+// other status is returned to the reader.
+using Loader = std::function<OpStatus(const std::string &key, std::string &value, int &ttl)>;
+
+// Key change notification, published after the change is visible in the table.
+struct ChangeEvent {
+    enum class Type { SET, REMOVE, EXPIRE, EVICT };
+    Type type;
+    std::string key;
+    uint64_t version;
+};
 
-        Node(std::string k, std::string v, time_t exp=0) : key(std::move(k)), value(std::move(v)), expiry(exp), lastAccessed(time(nullptr)), next(nullptr), refCount(0) {}
+const size_t EVENT_RING_CAPACITY = 65536;
+// Writers wake a consumer in waitEvent() without taking its mutex, so a wakeup
+// sent just before it blocks can be missed; it re-checks the ring this often.
+const std::chrono::milliseconds EVENT_WAIT_SLICE(10);
+// Lock stripes of the ordered key index (enableOrderedIndex()).
+const size_t ORDERED_INDEX_STRIPES = 16;
 
-        Node(const Node&) =delete;
-        Node& operator = (const Node&)=delete;
-        Node(Node&&) = delete;
-        Node& operator=(Node&&)=delete;
+// Counter whose increments are spread over padded cells, so threads that
+// count the same event rarely write the same cache line.
+class StripedCounter
+{
+    private:
+    static const size_t CELLS = 16;
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> value{0};
     };
+    Cell cells[CELLS];
+    static size_t cellIndex();
 
-    inline void incrementRefCount(Node* node) const;
-    inline void decrementRefCount(Node* node) const;
+    public:
+    void add(uint64_t n = 1) { cells[cellIndex()].value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t total() const;
+};
 
+// Called synchronously after every applied mutation (set, remove, touch,
+// expiry, eviction) with the affected key. Used by replication.
+using MutationListener = std::function<void(const std::string &key)>;
 
-    enum class TaskType{SET,GET,REMOVE};
+// Engine front end: the public API, the task queues that feed the worker
+// threads, change events, the ordered index and the mutation listener. The
+// table itself lives in a BasicHashMap, chosen with makeHashMap(). Queued
+// operations are executed by BasicHashMap's own workers, so the per-key path
+// has no virtual calls; only whole-table and direct-access helpers do.
+class HashMap
+{
+    protected:
+    enum class TaskType{SET,GET,REMOVE,INCR,CAS,APPEND,TOUCH};
 
     struct Task{
         TaskType type;
         std::string key;
         std::string value;
         int ttl;
-        std::promise<std::string> result;
+        int64_t delta = 0;      // INCR
+        uint64_t version = 0;   // CAS: expected version, 0 = key must not exist
+        uint64_t traceId = 0;   // sampled request that queued this task, 0 if none
+        uint64_t enqueuedNs = 0;
+        Completion done;
 
-        Task(TaskType t, std::string k)
-            : type(t), key(std::move(k)), ttl(0) {}
+        Task(TaskType t, std::string k, Completion cb)
+            : type(t), key(std::move(k)), ttl(0), done(std::move(cb)) {}
         
-        Task(TaskType t, std::string k, std::string v, int timeToLive)
-            : type(t), key(std::move(k)), value(std::move(v)), ttl(timeToLive) {}
+        Task(TaskType t, std::string k, std::string v, int timeToLive, Completion cb)
+            : type(t), key(std::move(k)), value(std::move(v)), ttl(timeToLive), done(std::move(cb)) {}
     };
 
+    std::atomic<uint64_t> versionCounter;
+    uint64_t nextVersion() { return versionCounter.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+    //Worker pool
+    //Reads and writes are queued separately so workers can serve reads first
+    //and writes can be shed on their own once the high-water mark is reached.
+    std::atomic<bool> workersRunning;
+    std::queue<Task> readQueue;
+    std::queue<Task> writeQueue;
+    std::mutex taskMutex;
+    std::condition_variable taskCV;
+    size_t maxQueueDepth;
+    std::atomic<size_t> rejectedTasks;
+
+    //Optional ordered key index for prefix/range scans. Keys are spread over
+    //stripes by hash, so writers to different stripes do not share a lock;
+    //a scan holds every stripe's lock shared and merges them in key order.
+    struct alignas(64) OrderedIndexStripe {
+        std::set<std::string> keys;
+        mutable std::shared_mutex mutex;
+    };
+    std::atomic<bool> orderedIndexEnabled;
+    OrderedIndexStripe orderedIndex[ORDERED_INDEX_STRIPES];
+    OrderedIndexStripe& orderedIndexStripe(const std::string &key) { return orderedIndex[std::hash<std::string>()(key) % ORDERED_INDEX_STRIPES]; }
+    std::vector<std::string> scanOrdered(const std::string &from, const std::string &after, size_t limit,
+                                         const std::function<bool(const std::string&)> &inRange) const;
+
+    //Change notifications; only produced while a consumer has enabled them.
+    //Events are dropped rather than blocking the writer when the ring is full.
+    //The ring is allocated by the first enableEvents(true), so maps nobody
+    //watches do not carry it; `events` is null until then and never changes
+    //after. Writers never take eventsMutex: they notify a consumer blocked in
+    //waitEvent() without it, and the consumer's EVENT_WAIT_SLICE bounds how
+    //late a missed notification makes it.
+    std::unique_ptr<EventRing<ChangeEvent>> eventRing;
+    std::atomic<EventRing<ChangeEvent>*> events;
+    std::atomic<bool> eventsEnabled;
+    std::atomic<size_t> droppedEvents;
+    std::mutex eventsMutex;
+    std::condition_variable eventsCV;
+    std::atomic<int> eventWaiters;
+    uint64_t eventWakeups;             // guarded by eventsMutex
+    void publishEvent(ChangeEvent::Type type, const std::string &key, uint64_t version = 0);
+
+    MutationListener mutationListener;
+    std::atomic<bool> hasMutationListener;
+    void notifyMutation(const std::string &key);
+
+    //Sampled hot-key summaries, fed from the get and write paths.
+    mutable HotKeyTracker hotReads;
+    HotKeyTracker hotWrites;
+
+    //Values longer than this are stored compressed (0 = never). Atomic: it is
+    //set after the workers that read it have started.
+    std::atomic<size_t> compressionThreshold;
+    //Stored form of `raw`; returns true and fills `packed` if it compresses.
+    bool encodeValue(const std::string &raw, std::string &packed) const;
+    //Value bytes as written vs. as held in the table.
+    std::atomic<int64_t> logicalValueBytes;
+    std::atomic<int64_t> storedValueBytes;
+    std::atomic<int64_t> compressedEntries;
+    void accountValue(const HashNode *node, int64_t sign);
+    //Approximate bytes held by entries (node, key and stored value) and the
+    //limit the eviction thread keeps them under (0 = none); atomic because it
+    //is set after that thread has started. `quotaEvicts` is set by
+    //BasicHashMap, before its threads start, when its eviction policy can
+    //make room.
+    std::atomic<int64_t> entryBytes;
+    std::atomic<size_t> memoryQuota;
+    bool quotaEvicts;
+    bool overQuota() const
+    {
+        size_t quota = memoryQuota.load(std::memory_order_relaxed);
+        return quota != 0 && entryBytes.load(std::memory_order_relaxed) > static_cast<int64_t>(quota);
+    }
+    bool quotaFull() const { return !quotaEvicts && overQuota(); }
+    //Read outcomes for the hit ratio.
+    mutable StripedCounter readHits;
+    mutable StripedCounter readMisses;
+
+    //Read-through loaders, longest prefix first; fixed once the map is shared.
+    //`flights` holds the load in progress for each missing key, which every
+    //other reader of that key waits on instead of loading it again.
+    struct LoaderEntry {
+        std::string prefix;
+        Loader loader;
+        int refreshAhead;
+    };
+    std::vector<LoaderEntry> loaders;
+    struct LoadResult {
+        OpStatus status;
+        std::string value;
+        uint64_t version;
+    };
+    std::mutex flightsMutex;
+    std::unordered_map<std::string, std::shared_future<LoadResult>> flights;
+    const LoaderEntry* loaderFor(std::string_view key) const;
+    // Called by get() and view() on a miss; the caller's thread runs the loader.
+    OpStatus loadMissing(std::string_view key, std::string &value, uint64_t *version);
+    // compareAndSet() applied on the calling thread, so a loaded value is
+    // cached even when the write queue is shedding load.
+    virtual OpStatus storeLoaded(const std::string &key, uint64_t expectedVersion, const std::string &value, int ttl, uint64_t &version) = 0;
+    //Early refresh: keys read within their loader's refreshAhead seconds of
+    //expiring are queued with the version read, and reloaded in the
+    //background one at a time while readers keep getting the current value.
+    std::queue<std::pair<std::string, uint64_t>> refreshQueue;
+    std::set<std::string> refreshPending;
+    std::mutex refreshMutex;
+    std::condition_variable refreshCV;
+    bool refresherRunning;
+    std::thread refresher;
+    void refreshIfExpiring(std::string_view key, uint64_t version, time_t expiry);
+    void refreshLoop();
+    void stopRefresher();
+
+    //Per-thread near cache in front of get(); 0 slots = disabled. Atomic
+    //because it is set while the map's own threads may already be reading.
+    //`instanceId` tells a thread's cache which map its entries came from.
+    std::atomic<size_t> nearCacheSlots;
+    const uint64_t instanceId;
+
+    //Heap image from the previous run (attachHeap()). Its entries are copied
+    //into the table by a background loader, or earlier by the first operation
+    //on their key; `heapClaims` holds each entry's HEAP_* load state.
+    std::string heapFileName;
+    std::unique_ptr<MappedHeap> heap;
+    std::unique_ptr<std::atomic<uint8_t>[]> heapClaims;
+    mutable std::atomic<size_t> heapPending;   // 0 once every entry is in the table
+    std::atomic<bool> heapLoaderRunning;
+    std::thread heapLoader;
+    // Make sure the image's entry for `key`, or all of them, is in the table
+    // before the caller looks. Loading does not change what the map holds,
+    // only where it is held, so const readers do it too.
+    void hydrate(std::string_view key) const;
+    // Stops early if `keepGoing` turns false; returns the damaged entries skipped.
+    size_t hydrateAll(const std::atomic<bool> *keepGoing = nullptr) const;
+    void hydrateEntry(const MappedHeap::Entry &entry) const;
+    void loadHeap();
+    void stopHeapLoader();
+    // Writes the table as a new image; only once no other thread uses the map.
+    void saveHeap();
+    // Inserts an entry read from the image, without events or listeners.
+    virtual void loadEntry(const std::string &key, const std::string &value, int ttl, bool compressed) = 0;
+
+    //
+    std::string PersistenceFileName;
+
+    //worker
+    // Blocks for work and moves up to WORKER_BATCH_SIZE tasks into `batch`,
+    // reads first; false once the workers are shutting down.
+    bool nextTasks(std::vector<Task> &batch, size_t workers);
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> batchedTasks;
+    std::atomic<uint64_t> collapsedSets;
+    std::atomic<uint64_t> batchSizes[BATCH_HISTOGRAM_SLOTS];
+    void stopWorkers();
+    bool enqueueRead(Task &&task);
+    bool enqueueWrite(Task &&task);
+    OpResult runBlocking(Task &&task, bool isRead);
+
+    HashMap(const std::string &persistenceFile, size_t maxQueueDepth);
+
+    public:
+    virtual ~HashMap();
+    HashMap(const HashMap&) = delete;
+    HashMap& operator=(const HashMap&) = delete;
+
+    // Public thread-safe API. OVERLOADED means the task queue is past its
+    // high-water mark and the request was not queued.
+    OpStatus set(const std::string &key, const std::string &value, int ttl = 0);
+    OpStatus remove(std::string_view key);
+    // Reads the table on the calling thread instead of queuing: a miss is
+    // NOT_FOUND (or goes to the key's loader, see setLoader()), and a hit only
+    // copies into `value`, reusing its capacity, so a caller that keeps its
+    // buffer does no allocation at all.
+    virtual OpStatus get(std::string_view key, std::string &value, uint64_t *version = nullptr) = 0;
+    // Part of a value, for reading large values piecewise.
+    struct ByteRange {
+        uint64_t first = 0;
+        uint64_t length = UINT64_MAX;
+        bool suffix = false;    // the last `length` bytes instead
+        // Whether the range covers any byte of a value `total` bytes long;
+        // an empty value has no satisfiable range (RFC 9110 answers 416).
+        bool satisfiable(uint64_t total) const { return total != 0 && (suffix ? length != 0 : first < total); }
+    };
+    // Like get(), but copies only the bytes in `range` (clipped to the value)
+    // and sets `totalSize` to the length of the whole value. A compressed
+    // value is decoded first; an uncompressed one is never copied whole.
+    virtual OpStatus getRange(std::string_view key, const ByteRange &range, std::string &value, uint64_t &totalSize, uint64_t *version = nullptr) = 0;
+    // Calls `reader` with the value in place, without copying it out; a
+    // compressed value is decoded into a temporary first. The entry is pinned
+    // and its bucket read-locked while `reader` runs, so it must be quick and
+    // must not call back into the map. A loaded value is passed from a copy.
+    using ValueReader = std::function<void(std::string_view value, uint64_t version)>;
+    virtual OpStatus view(std::string_view key, const ValueReader &reader) = 0;
+
+    // Atomic read-modify-write operations, applied with the same CAS loop as set.
+    // A missing key counts as 0 for incrBy and "" for append; both keep the TTL.
+    OpStatus incrBy(const std::string &key, int64_t delta, int64_t &value);
+    OpStatus compareAndSet(const std::string &key, uint64_t expectedVersion, const std::string &value, int ttl, uint64_t &version);
+    OpStatus append(const std::string &key, const std::string &suffix, uint64_t &version);
+    // set() that waits until the write is applied, for callers that read their
+    // own writes (the embedded C API).
+    OpStatus setBlocking(const std::string &key, const std::string &value, int ttl, uint64_t &version);
+    // Replaces only the TTL (0 clears it) without copying the entry.
+    OpStatus touch(const std::string &key, int ttl);
+
+    // Non-blocking variants. On OK the completion runs later on a worker
+    // thread; on OVERLOADED nothing was queued and it is never called.
+    OpStatus getAsync(const std::string &key, Completion done);
+    OpStatus setAsync(const std::string &key, const std::string &value, int ttl, Completion done);
+    OpStatus removeAsync(const std::string &key, Completion done);
+
+    // Apply a write or remove on the calling thread without going through the
+    // queue (snapshot loading, replication). `compressed` marks a value that is
+    // already in ValueCodec form, as written to snapshots.
+    virtual void restore(const std::string &key, const std::string &value, int ttl = 0, bool compressed = false) = 0;
+    virtual void restoreRemove(const std::string &key) = 0;
+    void clear();
+
+    // Must be installed before the map is shared with other threads.
+    void setMutationListener(MutationListener listener);
+
+    // Gives every thread that calls get() its own direct-mapped cache of
+    // `slotsPerThread` recently read entries (0 disables it). A cached entry is
+    // served while its bucket's write stamp is unchanged, so a hit does not
+    // write to shared memory: it does not refresh lastAccessed, and hits reach
+    // the read counters and hot-key sampler in batches of NEAR_CACHE_FLUSH_HITS
+    // (a thread that stops reading leaves its last batch uncounted). May be
+    // called while the map is in use; each thread's cache starts over at the
+    // new size.
+    void enableNearCache(size_t slotsPerThread) { nearCacheSlots.store(slotsPerThread, std::memory_order_relaxed); }
+    size_t near_cache_slots() const { return nearCacheSlots.load(std::memory_order_relaxed); }
+
+    // Sends misses on keys starting with `prefix` ("" for every key) to
+    // `loader`, and caches what it returns. Concurrent misses on one key share
+    // a single load; the others wait for it (up to TASK_TIMEOUT). The load
+    // runs on the thread of the first reader, in get() and view(); reads on
+    // the worker queue (getAsync) never load. A loaded value is inserted only
+    // if the key is still absent, so a write that lands during the load wins.
+    // With `refreshAheadSeconds` > 0, a key read that close to expiring is
+    // reloaded in the background, and replaces the entry only if it has not
+    // been written since. The longest matching prefix wins; setting a prefix
+    // again replaces its loader. Call before the map is shared, and do not
+    // read the key being loaded from inside the loader.
+    void setLoader(const std::string &prefix, Loader loader, int refreshAheadSeconds = 0);
+
+    // Values longer than `bytes` are compressed on write with ValueCodec and
+    // decompressed on read (0 disables it). May be called while the map is in
+    // use; values already stored keep their form.
+    void setCompressionThreshold(size_t bytes) { compressionThreshold.store(bytes, std::memory_order_relaxed); }
+    size_t compression_threshold() const { return compressionThreshold.load(std::memory_order_relaxed); }
+
+    // Keeps entries under about `bytes` (node, key and stored value; 0, the
+    // default, is no limit). Past it the eviction policy drops keys until the
+    // map is back under; with no eviction, writes that add data fail with FULL
+    // until removes or expiry make room. May be called while the map is in use.
+    void setMemoryQuota(size_t bytes) { memoryQuota.store(bytes, std::memory_order_relaxed); }
+    size_t memory_quota() const { return memoryQuota.load(std::memory_order_relaxed); }
+
+    struct Stats {
+        size_t entries;
+        uint64_t memoryBytes;         // as counted against the memory quota
+        uint64_t readHits;
+        uint64_t readMisses;
+        size_t compressedEntries;
+        uint64_t logicalValueBytes;   // value bytes as written by clients
+        uint64_t storedValueBytes;    // value bytes actually held
+    };
+    Stats stats() const;
+
+    // Starts from the heap image in `file` (see mapped_heap.h) and writes a new
+    // one there on shutdown. Only the file's header is read here; entries are
+    // loaded in the background, and one whose key is used before then is
+    // loaded first, so the map answers from the start as if fully loaded.
+    // Whole-table operations (scans, snapshots) wait for the load to finish.
+    // Returns false, with `error` set, if there is no usable image; the map
+    // still saves to `file`. Call before the map is shared with other threads.
+    bool attachHeap(const std::string &file, std::string &error);
+    size_t heap_pending() const { return heapPending.load(std::memory_order_relaxed); }
+
+    virtual void print_map() const = 0;
+
+    // Ordered index. Builds the index from the current table; scans return
+    // keys in lexicographic order strictly after `after` (for pagination).
+    void enableOrderedIndex();
+    bool ordered_index_enabled() const { return orderedIndexEnabled.load(std::memory_order_acquire); }
+    std::vector<std::string> scanPrefix(const std::string &prefix, size_t limit, const std::string &after = "") const;
+    std::vector<std::string> scanRange(const std::string &from, const std::string &to, size_t limit, const std::string &after = "") const;
+
+    void enableEvents(bool enabled);
+    bool pollEvent(ChangeEvent &event);
+    // Like pollEvent(), but waits up to `timeout` for an event. False on
+    // timeout or when wakeEventWaiters() is called.
+    bool waitEvent(ChangeEvent &event, std::chrono::milliseconds timeout);
+    void wakeEventWaiters();
+    size_t dropped_events() const { return droppedEvents.load(std::memory_order_relaxed); }
+
+    virtual size_t current_size() const = 0;
+    virtual size_t current_capacity() const = 0;
+    // Policy names, e.g. "fnv/lru/refcount/lockfree".
+    virtual std::string engine_name() const = 0;
+    size_t queue_depth();
+    size_t max_queue_depth() const { return maxQueueDepth; }
+    size_t rejected_tasks() const { return rejectedTasks.load(std::memory_order_relaxed); }
+
+    struct NodeData { 
+        std::string key;
+        std::string value;
+        time_t expiry;
+        time_t lastAccessed;
+        bool compressed = false;
+    };
+    // Values are returned as stored: ValueCodec bytes where `compressed`.
+    virtual std::vector<NodeData> getAllForPersistence() const = 0;
+    // Reads the live (unexpired) entry for `key` directly, bypassing the queue.
+    virtual bool lookupEntry(std::string_view key, NodeData &out) const = 0;
+
+    // Incremental iteration in the style of Redis SCAN. Start with cursor 0 and
+    // call again with the returned cursor until it is 0. Every key present for
+    // the whole scan is returned at least once (possibly more), including across
+    // power-of-two resizes, because buckets are visited in reverse-binary order.
+    struct ScanPage {
+        std::vector<std::string> keys;
+        uint64_t cursor;
+    };
+    virtual ScanPage scan(uint64_t cursor, size_t count) const = 0;
+
+    // Hot keys by sampled read and write frequency; 0 turns sampling off.
+    void setHotKeySampleRate(uint32_t sampleEvery);
+    uint32_t hot_key_sample_rate() const { return hotReads.sample_rate(); }
+    std::vector<HotKeyTracker::Entry> hotReadKeys(size_t limit) const { return hotReads.top(limit); }
+    std::vector<HotKeyTracker::Entry> hotWriteKeys(size_t limit) const { return hotWrites.top(limit); }
+
+    // Bucket occupancy from one walk over the table. Contention counts write
+    // attempts on a bucket that lost a CAS race or waited for its lock.
+    struct BucketInfo {
+        size_t bucket;
+        size_t length;
+        uint64_t contention;
+    };
+    struct BucketStats {
+        size_t buckets = 0;
+        size_t nonEmpty = 0;
+        size_t maxChain = 0;
+        double meanChain = 0;               // over non-empty buckets
+        std::vector<size_t> histogram;      // [n]: buckets of length n; the last slot is "or longer"
+        uint64_t contention = 0;
+        std::vector<BucketInfo> longest;    // up to `limit` each
+        std::vector<BucketInfo> mostContended;
+    };
+    virtual BucketStats bucketStats(size_t limit) const = 0;
+
+    // How the workers have been draining the queues.
+    struct BatchStats {
+        uint64_t batches;
+        uint64_t tasks;
+        uint64_t collapsed;             // sets skipped for a later set to the same key
+        std::vector<uint64_t> histogram;  // [n]: batches of 2^n to 2^(n+1)-1 tasks
+    };
+    BatchStats batchStats() const;
+};
+
+// The lock-free chained table behind HashMap. Policies (hash_policies.h):
+//   HashPolicy         bucket hash
+//   EvictionPolicy     which key to drop when over MAX_CAPACITY
+//   ReclaimPolicy      when unlinked nodes may be freed
+//   ConcurrencyPolicy  per-bucket guards around reads and writes
+// Every combination makeHashMap() can return is instantiated in hash_map_rcu.cpp.
+template <class HashPolicy, class EvictionPolicy, class ReclaimPolicy, class ConcurrencyPolicy>
+class BasicHashMap final : public HashMap
+{
+    private:
+    using Node = HashNode;
+
     std::vector<std::atomic<Node*>> table;
     size_t capacity;
     std::atomic<size_t> size;
     std::atomic<bool> running;
 
+    EvictionPolicy eviction;
+    mutable ReclaimPolicy reclaim;
+    mutable ConcurrencyPolicy concurrency;
+    using ReclaimGuard = typename ReclaimPolicy::Guard;
+    using ReadGuard = typename ConcurrencyPolicy::ReadGuard;
+    using WriteGuard = typename ConcurrencyPolicy::WriteGuard;
 
-    std::vector<Node*> deferredDeleteQueue;
-    std::mutex deferredDeleteMutex;
-    void scheduleDeferredDelete(Node* node);
-    void processDeferredDeletes(bool forceAll = false);
-
-
-    std::list<std::string> lruList;
-    std::unordered_map<std::string, std::list<std::string> ::iterator> lruMap;
-    std::mutex lruMutex;
-    std::thread lruThread;
-    std::atomic<bool> lruRunning;
-    std::condition_variable lruCV;
+    std::thread evictionThread;
+    std::mutex evictionMutex;
+    std::condition_variable evictionCV;
 
     //Expiry Management
     std::mutex expiryGlobalMutex;
     std::condition_variable expiryGlobalCV;
 
-    //Worker pool
-    std::atomic<bool> workersRunning;
+    // Fixed before the first worker starts; workers read it unsynchronized.
+    const size_t workerCount;
     std::vector<std::thread> workerThread;
-    std::queue<std::shared_ptr<Task>> taskQueue;
-    std::mutex taskMutex;
-    std::condition_variable taskCV;
 
-    //
-    std::string PersistenceFileName;
+    // Per-bucket write contention for bucketStats().
+    std::unique_ptr<std::atomic<uint64_t>[]> contention;
+    // Bumped after every change to a bucket; near-cache entries carry the
+    // stamp they were read under.
+    std::unique_ptr<std::atomic<uint64_t>[]> bucketStamps;
+    void bumpStamp(size_t index) { bucketStamps[index].fetch_add(1, std::memory_order_release); }
 
-    
-    size_t hashFunction(const std::string &key,size_t cap) const{
-        return fnv1a_hash(key)%cap;
+    size_t hashFunction(std::string_view key,size_t cap) const{
+        return HashPolicy::hash(key)%cap;
     }
 
     std::thread cleanupThread;
     void cleanupExpired();
-    
-
-    //LRU Management
-    void updateLRU(const std::string& key);
-    //void removeLRUItem();
-    void lruMonitor();
-
-    //worker
+    void evictionMonitor();
     void workerFunction();
+    void runTask(Task &task, OpResult &result);
+    void prefetchBucket(size_t index) const;
+    void syncOrderedIndex(const std::string &key);
+    // Bookkeeping after a write is visible; called with no bucket guard held.
+    void afterWrite(const std::string &key, uint64_t version, bool inserted);
+    void afterRemove(const std::string &key, ChangeEvent::Type cause);
 
     //Internal (RCU-based) operations
-    void setInternal(const std::string &key, const std::string & value, int ttl=0);
-    std::string getInternal(const std::string &key) const;
-    bool removeInternal(const std::string &key);
+    //Shared CAS loop for all writes: `build` receives the live node for the key
+    //(nullptr if absent or expired) and returns its replacement, or nullptr to
+    //abort with result.status set. It is called again if the node changes under it.
+    using NodeBuilder = std::function<Node*(const Node *current, OpResult &result)>;
+    void updateInternal(const std::string &key, const NodeBuilder &build, OpResult &result);
+
+    uint64_t setInternal(const std::string &key, const std::string & value, int ttl=0, bool encoded=false);
+    void incrInternal(const std::string &key, int64_t delta, OpResult &result);
+    void casInternal(const std::string &key, uint64_t expectedVersion, const std::string &value, int ttl, OpResult &result);
+    void appendInternal(const std::string &key, const std::string &suffix, OpResult &result);
+    OpStatus touchInternal(const std::string &key, int ttl);
+    OpStatus getInternal(std::string_view key, std::string &value, uint64_t *version = nullptr) const;
+    // get() without loading: the near cache, then the table.
+    OpStatus lookup(std::string_view key, std::string &value, uint64_t *version, time_t *expiry);
+    template <class Read>
+    OpStatus readLive(size_t index, std::string_view key, Read &&read) const;
+    OpStatus getAt(size_t index, std::string_view key, std::string &value, uint64_t *version, time_t *expiry,
+                   const ByteRange *range = nullptr, uint64_t *totalSize = nullptr) const;
+    bool containsInternal(std::string_view key) const;
+    bool removeInternal(const std::string &key, ChangeEvent::Type cause = ChangeEvent::Type::REMOVE);
 
     void deleteList(Node* head);
+    void loadEntry(const std::string &key, const std::string &value, int ttl, bool compressed) override;
+    OpStatus storeLoaded(const std::string &key, uint64_t expectedVersion, const std::string &value, int ttl, uint64_t &version) override;
 
     public:
-    explicit HashMap(const std::string &persistenceFile = "hashmap.json");
-    ~HashMap();
-
-    // Public thread-safe API
-    void set(const std::string &key, const std::string &value, int ttl = 0);
-    std::string get(const std::string &key);
-    bool remove(const std::string &key);
+    explicit BasicHashMap(const std::string &persistenceFile = "hashmap.json", size_t maxQueueDepth = DEFAULT_MAX_QUEUE_DEPTH);
+    ~BasicHashMap() override;
 
-    void print_map() const;
+    OpStatus get(std::string_view key, std::string &value, uint64_t *version = nullptr) override;
+    OpStatus getRange(std::string_view key, const ByteRange &range, std::string &value, uint64_t &totalSize, uint64_t *version = nullptr) override;
+    OpStatus view(std::string_view key, const ValueReader &reader) override;
+    void restore(const std::string &key, const std::string &value, int ttl = 0, bool compressed = false) override;
+    void restoreRemove(const std::string &key) override;
+    void print_map() const override;
+    size_t current_size() const override { return size.load(std::memory_order_relaxed); }
+    size_t current_capacity() const override { return capacity; }
+    std::string engine_name() const override;
+    std::vector<NodeData> getAllForPersistence() const override;
+    bool lookupEntry(std::string_view key, NodeData &out) const override;
+    ScanPage scan(uint64_t cursor, size_t count) const override;
+    BucketStats bucketStats(size_t limit) const override;
+};
 
-    size_t current_size() const { return size.load(std::memory_order_relaxed); }
-    size_t current_capacity() const { return capacity; }
-
-    struct NodeData { 
-        std::string key;
-        std::string value;
-        time_t expiry;
-        time_t lastAccessed;
-    };
-    std::vector<NodeData> getAllForPersistence() const;
+// Runtime choice of policies for makeHashMap(). The defaults are the original
+// engine: FNV, LRU eviction, reference counts, lock-free writes.
+struct EngineConfig {
+    enum class Hash { FNV, FNV_MIXED };
+    enum class Eviction { LRU, NONE };
+    enum class Reclaim { REFCOUNT, EPOCH };
+    enum class Concurrency { LOCK_FREE, STRIPED };
+    Hash hash = Hash::FNV;
+    Eviction eviction = Eviction::LRU;
+    Reclaim reclaim = Reclaim::REFCOUNT;
+    Concurrency concurrency = Concurrency::LOCK_FREE;
 
+    // Applies one command-line option: --hash fnv|fnv-mixed, --eviction lru|none,
+    // --reclaim refcount|epoch, --concurrency lockfree|striped. Returns false
+    // if `option` is not one of these or `value` is not recognized.
+    bool set(const std::string &option, const std::string &value);
 };
 
-#endif
+std::unique_ptr<HashMap> makeHashMap(const EngineConfig &config, const std::string &persistenceFile = "hashmap.json", size_t maxQueueDepth = DEFAULT_MAX_QUEUE_DEPTH);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "hash_policies.h"
+#include <algorithm>
+#include <iostream>
+
+void LruEviction::recordWrite(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(lruMutex);
+    auto it = lruMap.find(key);
+    if (it != lruMap.end()) {
+        lruList.erase(it->second);
+    }
+    lruList.push_front(key);
+    lruMap[key] = lruList.begin();
+}
+
+bool LruEviction::pickVictim(std::string& key)
+{
+    std::lock_guard<std::mutex> lock(lruMutex);
+    if (lruList.empty()) return false;
+    key = lruList.back();
+    lruList.pop_back();
+    lruMap.erase(key);
+    return true;
+}
+
+void RefCountReclaim::retire(HashNode* node)
+{
+    if (!node) return;
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    retired.push_back(node);
+}
+
+void RefCountReclaim::collect(bool force)
+{
+    std::vector<HashNode*> toDeleteNow;
+    {
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        if (retired.empty()) return;
+
+        retired.erase(
+            std::remove_if(retired.begin(), retired.end(),
+                           [&](HashNode* node) {
+                               if (node->refCount.load(std::memory_order_acquire) == 0) {
+                                   toDeleteNow.push_back(node);
+                                   return true;
+                               }
+                               if (force) {
+                                   std::cerr << "Warning: Node " << node->key << " has refCount "
+                                             << node->refCount.load() << " during forced delete processing." << std::endl;
+                               }
+                               return false;
+                           }),
+            retired.end());
+    }
+
+    for (HashNode* node : toDeleteNow) {
+        delete node;
+    }
+}
+
+// Epochs are process-wide so one thread-local slot serves every map.
+namespace {
+
+const size_t EPOCH_SLOTS = 256;
+const uint64_t EPOCH_IDLE = UINT64_MAX;
+
+struct alignas(64) EpochSlot {
+    std::atomic<uint64_t> epoch{EPOCH_IDLE};
+    std::atomic<bool> claimed{false};
+};
+
+EpochSlot epochSlots[EPOCH_SLOTS];
+std::atomic<uint64_t> globalEpoch{1};
+// Readers on threads that found no free slot; nothing is freed while any exist.
+std::atomic<size_t> unslottedReaders{0};
+
+struct ThreadEpoch {
+    EpochSlot* slot = nullptr;
+    size_t depth = 0;
+    ~ThreadEpoch()
+    {
+        if (slot) slot->claimed.store(false);
+    }
+};
+
+thread_local ThreadEpoch threadEpoch;
+
+}
+
+void EpochReclaim::enter()
+{
+    ThreadEpoch& t = threadEpoch;
+    if (t.depth++ > 0) return;
+    if (!t.slot) {
+        for (auto& slot : epochSlots) {
+            bool expected = false;
+            if (slot.claimed.compare_exchange_strong(expected, true)) {
+                t.slot = &slot;
+                break;
+            }
+        }
+    }
+    if (!t.slot) {
+        unslottedReaders.fetch_add(1);
+        return;
+    }
+    t.slot->epoch.store(globalEpoch.load());
+    // The announcement must be visible before this thread reads any bucket.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void EpochReclaim::exit()
+{
+    ThreadEpoch& t = threadEpoch;
+    if (--t.depth > 0) return;
+    if (t.slot) {
+        t.slot->epoch.store(EPOCH_IDLE, std::memory_order_release);
+    } else {
+        unslottedReaders.fetch_sub(1);
+    }
+}
+
+// Advances the epoch and returns the oldest one still announced by a reader.
+uint64_t EpochReclaim::oldestActiveEpoch()
+{
+    uint64_t oldest = globalEpoch.fetch_add(1) + 1;
+    if (unslottedReaders.load() > 0) return 0;
+    for (auto& slot : epochSlots) {
+        oldest = std::min(oldest, slot.epoch.load());
+    }
+    return oldest;
+}
+
+void EpochReclaim::retire(HashNode* node)
+{
+    if (!node) return;
+    // Pairs with the fence in enter(): a reader that could still reach the
+    // node announced an epoch no later than the one recorded here.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = globalEpoch.load();
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    retired.emplace_back(epoch, node);
+}
+
+void EpochReclaim::collect(bool force)
+{
+    std::vector<HashNode*> toDeleteNow;
+    {
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        if (retired.empty()) return;
+        uint64_t safe = force ? EPOCH_IDLE : oldestActiveEpoch();
+        auto keep = std::partition(retired.begin(), retired.end(),
+                                   [&](const std::pair<uint64_t, HashNode*>& r) { return r.first >= safe; });
+        for (auto it = keep; it != retired.end(); ++it) toDeleteNow.push_back(it->second);
+        retired.erase(keep, retired.end());
+    }
+
+    for (HashNode* node : toDeleteNow) {
+        delete node;
+    }
+}
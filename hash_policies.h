@@ -0,0 +1,195 @@
+#ifndef HASH_POLICIES_H
+#define HASH_POLICIES_H
+
+#include "fnv_hash.h"
+#include "slab_allocator.h"
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Policies for BasicHashMap (hash_map_rcu.h). Each one is a plain class the
+// map owns by value and calls directly, so every combination compiles to
+// straight-line code with no virtual dispatch in the table operations.
+
+// One table entry. Readers follow `next` without locks; a replaced or removed
+// node is handed to the ReclaimPolicy, which frees it once no reader can
+// still be looking at it. The node and its strings live in the slabs.
+struct HashNode {
+    SlabString key;
+    SlabString value;           // ValueCodec output when `compressed`
+    std::atomic<time_t> expiry; // updated in place by touch()
+    std::atomic<time_t> lastAccessed;
+    std::atomic<HashNode*> next;
+    std::atomic<int> refCount;  // only used by RefCountReclaim
+    bool compressed;
+    uint64_t version;
+
+    HashNode(std::string_view k, std::string_view v, time_t exp, uint64_t ver, bool packed = false) : key(k.data(), k.size()), value(v.data(), v.size()), expiry(exp), lastAccessed(time(nullptr)), next(nullptr), refCount(0), compressed(packed), version(ver) {}
+
+    HashNode(const HashNode&) = delete;
+    HashNode& operator=(const HashNode&) = delete;
+
+    bool hasKey(std::string_view k) const { return std::string_view(key) == k; }
+
+    static void* operator new(size_t size) { return Slab::allocate(size); }
+    static void operator delete(void* p, size_t size) { Slab::deallocate(p, size); }
+};
+
+// ---- HashPolicy: static uint64_t hash(std::string_view) ----
+
+// The original table hash.
+struct FnvHash {
+    static const char* name() { return "fnv"; }
+    static uint64_t hash(std::string_view key) { return fnv1a_hash(key); }
+};
+
+// FNV plus a finalizer; better spread when keys differ only in a suffix.
+struct MixedFnvHash {
+    static const char* name() { return "fnv-mixed"; }
+    static uint64_t hash(std::string_view key) { return fnv1a_hash_mixed(key); }
+};
+
+// ---- EvictionPolicy: recordWrite(key) on every write, pickVictim(key) when over capacity ----
+
+// Evicts the least recently written key. Removed keys stay in the list and
+// are skipped by the map when picked (the remove finds nothing).
+class LruEviction
+{
+    private:
+    std::list<std::string> lruList;
+    std::unordered_map<std::string, std::list<std::string>::iterator> lruMap;
+    std::mutex lruMutex;
+
+    public:
+    static const char* name() { return "lru"; }
+    void recordWrite(const std::string& key);
+    bool pickVictim(std::string& key);
+};
+
+// Never evicts; the table grows without bound.
+struct NoEviction {
+    static const char* name() { return "none"; }
+    void recordWrite(const std::string&) {}
+    bool pickVictim(std::string&) { return false; }
+};
+
+// ---- ReclaimPolicy ----
+// Guard: held for the whole of any walk over the table.
+// acquire/release: around each node while it is being read.
+// retire: a node that was just unlinked. collect: free what is safe (all of
+// it when `force`, which is only used once no other thread can read).
+
+// Per-node reference counts; retired nodes are freed once their count is 0.
+class RefCountReclaim
+{
+    private:
+    std::vector<HashNode*> retired;
+    std::mutex retiredMutex;
+
+    public:
+    static const char* name() { return "refcount"; }
+    struct Guard {
+        explicit Guard(RefCountReclaim&) {}
+    };
+    static void acquire(HashNode* node)
+    {
+        if (node) node->refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    static void release(HashNode* node)
+    {
+        if (node) node->refCount.fetch_sub(1, std::memory_order_release);
+    }
+    void retire(HashNode* node);
+    void collect(bool force = false);
+};
+
+// Epoch-based reclamation: a reader announces the global epoch while it holds
+// a Guard, and a node retired at epoch e is freed once every active reader
+// announced a later epoch. Readers touch one thread-local slot instead of a
+// shared counter on every node they pass.
+class EpochReclaim
+{
+    private:
+    std::vector<std::pair<uint64_t, HashNode*>> retired;
+    std::mutex retiredMutex;
+    static void enter();
+    static void exit();
+    static uint64_t oldestActiveEpoch();
+
+    public:
+    static const char* name() { return "epoch"; }
+    class Guard
+    {
+        public:
+        explicit Guard(EpochReclaim&) { EpochReclaim::enter(); }
+        ~Guard() { EpochReclaim::exit(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+    static void acquire(HashNode*) {}
+    static void release(HashNode*) {}
+    void retire(HashNode* node);
+    void collect(bool force = false);
+};
+
+// ---- ConcurrencyPolicy: ReadGuard / WriteGuard taken per bucket ----
+// WriteGuard::contended(): whether taking it had to wait for another writer.
+
+// Readers and writers never block; writers race with CAS and retry.
+struct LockFree {
+    static const char* name() { return "lockfree"; }
+    struct ReadGuard {
+        ReadGuard(LockFree&, size_t) {}
+    };
+    struct WriteGuard {
+        WriteGuard(LockFree&, size_t) {}
+        bool contended() const { return false; }
+    };
+};
+
+const size_t LOCK_STRIPES = 256;
+
+// Reader/writer lock per stripe of buckets, like the original lock-based
+// engine. Writers on one stripe are serialized, so their CAS never retries.
+class StripedLocks
+{
+    private:
+    std::vector<std::shared_mutex> stripes;
+
+    public:
+    StripedLocks() : stripes(LOCK_STRIPES) {}
+    static const char* name() { return "striped"; }
+    class ReadGuard
+    {
+        private:
+        std::shared_lock<std::shared_mutex> lock;
+
+        public:
+        ReadGuard(StripedLocks& locks, size_t bucket) : lock(locks.stripes[bucket % LOCK_STRIPES]) {}
+    };
+    class WriteGuard
+    {
+        private:
+        std::unique_lock<std::shared_mutex> lock;
+        bool waited;
+
+        public:
+        WriteGuard(StripedLocks& locks, size_t bucket) : lock(locks.stripes[bucket % LOCK_STRIPES], std::try_to_lock), waited(false)
+        {
+            if (!lock.owns_lock()) {
+                waited = true;
+                lock.lock();
+            }
+        }
+        bool contended() const { return waited; }
+    };
+};
+
+#endif
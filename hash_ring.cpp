@@ -0,0 +1,42 @@
+#include "hash_ring.h"
+#include "fnv_hash.h"
+#include <iterator>
+
+static const std::string NO_OWNER;
+
+// Plain fnv1a_hash skews a ring badly (node#1, node#2 land close together).
+static uint64_t ringHash(std::string_view s)
+{
+    return fnv1a_hash_mixed(s);
+}
+
+void HashRing::addNode(const std::string& node)
+{
+    if (!members.insert(node).second) return;
+    for (size_t i = 0; i < VNODES_PER_NODE; ++i) {
+        points[ringHash(node + "#" + std::to_string(i))] = node;
+    }
+}
+
+void HashRing::removeNode(const std::string& node)
+{
+    if (members.erase(node) == 0) return;
+    for (auto it = points.begin(); it != points.end();) {
+        it = it->second == node ? points.erase(it) : std::next(it);
+    }
+}
+
+const std::string& HashRing::owner(std::string_view key) const
+{
+    if (points.empty()) return NO_OWNER;
+    auto it = points.lower_bound(ringHash(key));
+    if (it == points.end()) it = points.begin();
+    return it->second;
+}
+
+uint64_t HashRing::fingerprint() const
+{
+    std::string joined;
+    for (const auto& node : members) joined.append(node).push_back(',');
+    return fnv1a_hash(joined);
+}
@@ -0,0 +1,34 @@
+#ifndef HASH_RING_H
+#define HASH_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+
+const size_t VNODES_PER_NODE = 128;
+
+// Consistent-hash ring of "host:port" nodes. Keys and virtual nodes are placed
+// with fnv1a_hash (plus a bit mixer), the same function the table uses, so
+// every node computes the same owner for a key.
+class HashRing
+{
+    private:
+    std::map<uint64_t, std::string> points;
+    std::set<std::string> members;
+
+    public:
+    void addNode(const std::string& node);
+    void removeNode(const std::string& node);
+    bool contains(const std::string& node) const { return members.count(node) != 0; }
+    bool empty() const { return members.empty(); }
+    const std::set<std::string>& nodes() const { return members; }
+    // Empty string when the ring has no nodes.
+    const std::string& owner(std::string_view key) const;
+    // Identifies the membership; equal on every node that has the same members.
+    uint64_t fingerprint() const;
+};
+
+#endif
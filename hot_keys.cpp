@@ -0,0 +1,71 @@
+#include "hot_keys.h"
+#include <algorithm>
+
+HotKeyTracker::HotKeyTracker(uint32_t sampleEvery) : recorded(0), samples(0), sampleMask(UINT32_MAX)
+{
+    entries.reserve(HOT_KEYS_CAPACITY);
+    setSampleRate(sampleEvery);
+}
+
+void HotKeyTracker::setSampleRate(uint32_t sampleEvery)
+{
+    if (sampleEvery == 0) {
+        sampleMask.store(UINT32_MAX, std::memory_order_relaxed);
+        return;
+    }
+    uint32_t rate = 1;
+    while (rate < sampleEvery && rate < (1u << 30)) rate <<= 1;
+    sampleMask.store(rate - 1, std::memory_order_relaxed);
+}
+
+uint32_t HotKeyTracker::sample_rate() const
+{
+    uint32_t mask = sampleMask.load(std::memory_order_relaxed);
+    return mask == UINT32_MAX ? 0 : mask + 1;
+}
+
+// Space-Saving: a tracked key is incremented; an untracked one takes over the
+// smallest counter and inherits its count as the error bound. The summary is
+// small enough that one linear pass finds both the key and the minimum.
+void HotKeyTracker::recordSampled(std::string_view key)
+{
+    samples.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(entriesMutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+    ++recorded;
+
+    Entry* smallest = nullptr;
+    for (Entry& e : entries) {
+        if (e.key == key) {
+            ++e.count;
+            return;
+        }
+        if (!smallest || e.count < smallest->count) smallest = &e;
+    }
+    if (entries.size() < HOT_KEYS_CAPACITY) {
+        entries.push_back(Entry{std::string(key), 1, 0});
+        return;
+    }
+    // assign() reuses the evicted key's buffer.
+    smallest->key.assign(key.data(), key.size());
+    smallest->error = smallest->count;
+    ++smallest->count;
+}
+
+std::vector<HotKeyTracker::Entry> HotKeyTracker::top(size_t limit) const
+{
+    std::vector<Entry> result;
+    double scale = std::max<uint32_t>(sample_rate(), 1);
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        result = entries;
+        if (recorded > 0) scale *= static_cast<double>(samples.load(std::memory_order_relaxed)) / recorded;
+    }
+    std::sort(result.begin(), result.end(), [](const Entry& a, const Entry& b) { return a.count > b.count; });
+    if (result.size() > limit) result.resize(limit);
+    for (Entry& e : result) {
+        e.count = static_cast<uint64_t>(e.count * scale);
+        e.error = static_cast<uint64_t>(e.error * scale);
+    }
+    return result;
+}
@@ -0,0 +1,66 @@
+#ifndef HOT_KEYS_H
+#define HOT_KEYS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const size_t HOT_KEYS_CAPACITY = 64;
+const uint32_t DEFAULT_HOT_KEYS_SAMPLE = 64;
+
+// Approximate top-K keys by frequency, using the Space-Saving algorithm over a
+// random sample of the calls to record(). Only one call in `sampleEvery` does
+// any work; the rest cost a thread-local random step. A sampled call that finds
+// the summary busy is dropped rather than waiting, so the hot path never blocks;
+// top() scales the counts back up by the share of samples that were dropped.
+class HotKeyTracker
+{
+    public:
+    struct Entry {
+        std::string key;
+        uint64_t count;   // sampled hits, an overestimate by at most `error`
+        uint64_t error;
+    };
+
+    private:
+    std::vector<Entry> entries;
+    mutable std::mutex entriesMutex;
+    uint64_t recorded;              // samples applied, under entriesMutex
+    std::atomic<uint64_t> samples;  // samples taken, including dropped ones
+    std::atomic<uint32_t> sampleMask;
+
+    public:
+    // `sampleEvery` is rounded up to a power of two; 0 disables tracking.
+    explicit HotKeyTracker(uint32_t sampleEvery = DEFAULT_HOT_KEYS_SAMPLE);
+
+    void setSampleRate(uint32_t sampleEvery);
+    // 0 when disabled.
+    uint32_t sample_rate() const;
+
+    void record(std::string_view key)
+    {
+        uint32_t mask = sampleMask.load(std::memory_order_relaxed);
+        if (mask == UINT32_MAX || (nextRandom() & mask) != 0) return;
+        recordSampled(key);
+    }
+
+    // Up to `limit` entries, most frequent first, with counts scaled to
+    // estimates of the real number of calls.
+    std::vector<Entry> top(size_t limit) const;
+
+    private:
+    void recordSampled(std::string_view key);
+    static uint32_t nextRandom()
+    {
+        static thread_local uint32_t state = 0x9e3779b9u ^ static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&state));
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "keyspaces.h"
+#include <algorithm>
+
+static bool validName(const std::string &name)
+{
+    if (name.empty() || name.size() > MAX_KEYSPACE_NAME) return false;
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+    });
+}
+
+Keyspaces::Keyspaces(size_t maxQueueDepth) : maxQueueDepth(maxQueueDepth), running(true)
+{
+    reaperThread = std::thread(&Keyspaces::reap, this);
+}
+
+Keyspaces::~Keyspaces()
+{
+    {
+        std::lock_guard<std::mutex> lock(droppedMutex);
+        running = false;
+    }
+    droppedCV.notify_all();
+    if (reaperThread.joinable()) reaperThread.join();
+}
+
+// The map is built before taking the lock: starting its threads is the slow
+// part, and lookups on other keyspaces should not wait for it.
+Keyspaces::CreateResult Keyspaces::create(const std::string &name, const EngineConfig &config, size_t memoryQuota, int defaultTtl)
+{
+    if (!validName(name)) return CreateResult::INVALID_NAME;
+    {
+        std::shared_lock<std::shared_mutex> lock(spacesMutex);
+        if (spaces.count(name)) return CreateResult::EXISTS;
+        if (spaces.size() >= MAX_KEYSPACES) return CreateResult::TOO_MANY;
+    }
+
+    auto space = std::make_shared<Keyspace>();
+    space->name = name;
+    space->map = makeHashMap(config, std::string(), maxQueueDepth);
+    space->map->setMemoryQuota(memoryQuota);
+    space->defaultTtl = defaultTtl;
+
+    std::unique_lock<std::shared_mutex> lock(spacesMutex);
+    if (spaces.count(name)) return CreateResult::EXISTS;
+    if (spaces.size() >= MAX_KEYSPACES) return CreateResult::TOO_MANY;
+    spaces.emplace(name, std::move(space));
+    return CreateResult::CREATED;
+}
+
+std::shared_ptr<Keyspace> Keyspaces::find(const std::string &name) const
+{
+    std::shared_lock<std::shared_mutex> lock(spacesMutex);
+    auto it = spaces.find(name);
+    return it == spaces.end() ? nullptr : it->second;
+}
+
+bool Keyspaces::drop(const std::string &name)
+{
+    std::shared_ptr<Keyspace> space;
+    {
+        std::unique_lock<std::shared_mutex> lock(spacesMutex);
+        auto it = spaces.find(name);
+        if (it == spaces.end()) return false;
+        space = std::move(it->second);
+        spaces.erase(it);
+    }
+    {
+        std::lock_guard<std::mutex> lock(droppedMutex);
+        dropped.push_back(std::move(space));
+    }
+    droppedCV.notify_one();
+    return true;
+}
+
+std::vector<std::shared_ptr<Keyspace>> Keyspaces::list() const
+{
+    std::vector<std::shared_ptr<Keyspace>> all;
+    std::shared_lock<std::shared_mutex> lock(spacesMutex);
+    for (const auto& entry : spaces) all.push_back(entry.second);
+    return all;
+}
+
+size_t Keyspaces::pending_drops() const
+{
+    std::lock_guard<std::mutex> lock(droppedMutex);
+    return dropped.size();
+}
+
+// A dropped keyspace can no longer be found, so its use count only falls;
+// once the reaper holds the last reference no request can be inside it.
+void Keyspaces::reap()
+{
+    std::unique_lock<std::mutex> lock(droppedMutex);
+    while (running) {
+        // Woken by drop(); the timeout rechecks keyspaces still in use.
+        droppedCV.wait_for(lock, KEYSPACE_REAP_INTERVAL);
+        auto idle = std::partition(dropped.begin(), dropped.end(),
+                                   [](const std::shared_ptr<Keyspace>& space) { return space.use_count() > 1; });
+        std::vector<std::shared_ptr<Keyspace>> done(std::make_move_iterator(idle), std::make_move_iterator(dropped.end()));
+        dropped.erase(idle, dropped.end());
+        lock.unlock();
+        done.clear();
+        lock.lock();
+    }
+}
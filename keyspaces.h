@@ -0,0 +1,63 @@
+#ifndef KEYSPACES_H
+#define KEYSPACES_H
+
+#include "hash_map_rcu.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const size_t MAX_KEYSPACES = 64;
+const size_t MAX_KEYSPACE_NAME = 64;
+const std::chrono::milliseconds KEYSPACE_REAP_INTERVAL(100);
+
+// One tenant's data: its own table with its own policies, quota and workers.
+struct Keyspace {
+    std::string name;
+    std::unique_ptr<HashMap> map;
+    int defaultTtl;     // used by writes that do not give a TTL (0 = none)
+};
+
+// Named keyspaces served under /ks/<name>/... next to the default map.
+// Keyspaces are in memory only; they are not persisted, replicated or
+// sharded across the cluster.
+//
+// Requests hold a keyspace through the shared_ptr from find(). drop() only
+// unlinks it, so it is cheap however large the keyspace is; a reaper thread
+// destroys it (joining its workers and freeing every entry) once the last
+// request using it has let go.
+class Keyspaces
+{
+    private:
+    size_t maxQueueDepth;
+    std::map<std::string, std::shared_ptr<Keyspace>> spaces;
+    mutable std::shared_mutex spacesMutex;
+
+    std::vector<std::shared_ptr<Keyspace>> dropped;
+    mutable std::mutex droppedMutex;
+    std::condition_variable droppedCV;
+    std::atomic<bool> running;
+    std::thread reaperThread;
+    void reap();
+
+    public:
+    explicit Keyspaces(size_t maxQueueDepth);
+    ~Keyspaces();
+
+    enum class CreateResult { CREATED, EXISTS, INVALID_NAME, TOO_MANY };
+    // Names are 1-64 characters from [A-Za-z0-9_-].
+    CreateResult create(const std::string &name, const EngineConfig &config, size_t memoryQuota, int defaultTtl);
+    // nullptr if there is no such keyspace.
+    std::shared_ptr<Keyspace> find(const std::string &name) const;
+    bool drop(const std::string &name);
+    std::vector<std::shared_ptr<Keyspace>> list() const;
+    // Dropped keyspaces whose memory has not been reclaimed yet.
+    size_t pending_drops() const;
+};
+
+#endif
@@ -0,0 +1,540 @@
+// End-to-end HTTP load generator for a running server. Drives /get, /set and
+// /remove (and /keys/range for workload E) over keep-alive connections, one
+// connection per thread; --raw uses GET/PUT/DELETE /kv/<key> instead.
+//
+// Usage: loadgen [--host H] [--port N] [--workload a|b|c|d|e|f] [--records N]
+//                [--load] [--connections N] [--duration S] [--rate OPS]
+//                [--value-size B] [--read P] [--update P] [--insert P]
+//                [--scan P] [--rmw P] [--remove P] [--seed N]
+//                [--raw] [--csv FILE] [--json FILE]
+//
+// Workloads follow the YCSB core presets:
+//   a  50% read, 50% update, Zipfian       d  95% read, 5% insert, latest
+//   b  95% read, 5% update, Zipfian        e  95% scan, 5% insert, Zipfian
+//   c  100% read, Zipfian                  f  50% read, 50% read-modify-write
+// --read/--update/... override the preset's mix (proportions are normalized).
+// Workload E scans with /keys/range, so the server needs --ordered-index.
+// --load inserts keys user0..user<records-1> before the run.
+//
+// --rate 0 (the default) is closed loop: each connection sends its next
+// request as soon as the previous one completes. With --rate the run is open
+// loop: requests are scheduled at a fixed total rate and latency is measured
+// from the scheduled send time, so requests that queued behind a stall are
+// charged for it (coordinated omission correction). Service time, measured
+// from the actual send, is reported alongside.
+
+#include "zipf.h"
+#include <asio.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+const size_t SCAN_MAX_LENGTH = 100;
+const size_t KEY_DIGITS = 10;
+
+enum class KeyDistribution { UNIFORM, ZIPF, LATEST };
+enum class OpType { READ, UPDATE, INSERT, SCAN, RMW, REMOVE };
+const size_t OP_TYPES = 6;
+const char* const OP_NAMES[OP_TYPES] = {"read", "update", "insert", "scan", "rmw", "remove"};
+
+struct Workload {
+    std::string name;
+    double mix[OP_TYPES];
+    KeyDistribution dist;
+};
+
+static bool presetWorkload(const std::string& name, Workload& w)
+{
+    //                          read  update insert scan  rmw   remove
+    if (name == "a") w = {"a", {0.50, 0.50, 0.00, 0.00, 0.00, 0.00}, KeyDistribution::ZIPF};
+    else if (name == "b") w = {"b", {0.95, 0.05, 0.00, 0.00, 0.00, 0.00}, KeyDistribution::ZIPF};
+    else if (name == "c") w = {"c", {1.00, 0.00, 0.00, 0.00, 0.00, 0.00}, KeyDistribution::ZIPF};
+    else if (name == "d") w = {"d", {0.95, 0.00, 0.05, 0.00, 0.00, 0.00}, KeyDistribution::LATEST};
+    else if (name == "e") w = {"e", {0.00, 0.00, 0.05, 0.95, 0.00, 0.00}, KeyDistribution::ZIPF};
+    else if (name == "f") w = {"f", {0.50, 0.00, 0.00, 0.00, 0.50, 0.00}, KeyDistribution::ZIPF};
+    else return false;
+    return true;
+}
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    Workload workload;
+    size_t records = 10000;
+    bool load = false;
+    size_t connections = 8;
+    double duration = 10;
+    double rate = 0;
+    size_t valueSize = 100;
+    uint64_t seed = 42;
+    bool raw = false;
+    std::string csvFile;
+    std::string jsonFile;
+};
+
+// Zero-padded so lexicographic order matches numeric order for range scans.
+static std::string makeKey(size_t index)
+{
+    std::string digits = std::to_string(index);
+    return "user" + std::string(digits.size() < KEY_DIGITS ? KEY_DIGITS - digits.size() : 0, '0') + digits;
+}
+
+// One keep-alive HTTP/1.1 connection. Reconnects lazily after an I/O error
+// or when the server asks to close.
+class HttpConnection
+{
+    private:
+    asio::io_context io;
+    tcp::socket socket;
+    std::string host;
+    std::string port;
+    asio::streambuf buffer;
+    bool connected;
+
+    void connect()
+    {
+        tcp::resolver resolver(io);
+        asio::connect(socket, resolver.resolve(host, port));
+        socket.set_option(tcp::no_delay(true));
+        connected = true;
+    }
+
+    void reset()
+    {
+        asio::error_code ignored;
+        socket.close(ignored);
+        buffer.consume(buffer.size());
+        connected = false;
+    }
+
+    public:
+    HttpConnection(const std::string& host, const std::string& port)
+        : socket(io), host(host), port(port), connected(false)
+    {
+    }
+
+    // Returns the status code, or 0 if the request failed at the socket level.
+    int request(const char* method, const std::string& target, const std::string& body, std::string& responseBody,
+                const char* contentType = "application/json")
+    {
+        try {
+            if (!connected) connect();
+
+            std::string request = std::string(method) + " " + target + " HTTP/1.1\r\n"
+                                  "Host: " + host + "\r\n";
+            if (!body.empty()) {
+                request += std::string("Content-Type: ") + contentType + "\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n";
+            }
+            request += "\r\n";
+            request += body;
+            asio::write(socket, asio::buffer(request));
+
+            size_t headerBytes = asio::read_until(socket, buffer, "\r\n\r\n");
+            std::string headers(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + headerBytes);
+            buffer.consume(headerBytes);
+            std::transform(headers.begin(), headers.end(), headers.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+            size_t space = headers.find(' ');
+            if (headers.compare(0, 5, "http/") != 0 || space == std::string::npos) {
+                reset();
+                return 0;
+            }
+            int status = std::atoi(headers.c_str() + space + 1);
+
+            size_t contentLength = 0;
+            size_t lengthHeader = headers.find("\r\ncontent-length:");
+            if (lengthHeader != std::string::npos) {
+                contentLength = std::strtoull(headers.c_str() + lengthHeader + 17, nullptr, 10);
+            }
+            if (buffer.size() < contentLength) {
+                asio::read(socket, buffer, asio::transfer_exactly(contentLength - buffer.size()));
+            }
+            responseBody.assign(asio::buffers_begin(buffer.data()), asio::buffers_begin(buffer.data()) + contentLength);
+            buffer.consume(contentLength);
+
+            if (headers.find("\r\nconnection: close") != std::string::npos) reset();
+            return status;
+        } catch (const std::exception&) {
+            reset();
+            return 0;
+        }
+    }
+};
+
+struct ConnectionStats {
+    std::vector<uint64_t> serviceNs;
+    std::vector<uint64_t> latencyNs;   // from the scheduled send time
+    size_t ops[OP_TYPES] = {};
+    size_t errors = 0;
+    size_t rejected = 0;               // 503 from load shedding
+    size_t misses = 0;
+};
+
+// State shared by all connections during a run.
+struct RunState {
+    std::atomic<size_t> nextInsert;
+    Clock::time_point start;
+    Clock::time_point end;
+};
+
+class Client
+{
+    private:
+    const Options& options;
+    HttpConnection connection;
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> unit;
+    ZipfianGenerator zipf;
+    std::string value;
+    std::string response;
+
+    std::string setBody(const std::string& key) const
+    {
+        return "{\"key\":\"" + key + "\",\"value\":\"" + value + "\"}";
+    }
+
+    int readKey(const std::string& key)
+    {
+        return connection.request("GET", options.raw ? "/kv/" + key : "/get?key=" + key, "", response);
+    }
+
+    int writeKey(const std::string& key)
+    {
+        if (options.raw) return connection.request("PUT", "/kv/" + key, value, response, "application/octet-stream");
+        return connection.request("POST", "/set", setBody(key), response);
+    }
+
+    int removeKey(const std::string& key)
+    {
+        return connection.request("DELETE", options.raw ? "/kv/" + key : "/remove?key=" + key, "", response);
+    }
+
+    size_t chooseKey(RunState& state)
+    {
+        size_t inserted = std::max<size_t>(state.nextInsert.load(std::memory_order_relaxed), 1);
+        switch (options.workload.dist) {
+            case KeyDistribution::LATEST: {
+                size_t back = zipf.next(rng);
+                return back < inserted ? inserted - 1 - back : 0;
+            }
+            case KeyDistribution::ZIPF:
+                return std::min(zipf.next(rng), inserted - 1);
+            default:
+                return static_cast<size_t>(unit(rng) * inserted) % inserted;
+        }
+    }
+
+    OpType chooseOp()
+    {
+        double u = unit(rng);
+        for (size_t i = 0; i < OP_TYPES; ++i) {
+            if (u < options.workload.mix[i]) return static_cast<OpType>(i);
+            u -= options.workload.mix[i];
+        }
+        return OpType::READ;
+    }
+
+    // A response counts as an error unless it is 2xx, or a 404 on a read.
+    void classify(int status, bool isRead, ConnectionStats& stats)
+    {
+        if (status >= 200 && status < 300) return;
+        if (isRead && status == 404) ++stats.misses;
+        else if (status == 503) ++stats.rejected;
+        else ++stats.errors;
+    }
+
+    public:
+    Client(const Options& options, const ZipfianGenerator& zipf, uint64_t seed)
+        : options(options), connection(options.host, options.port), rng(seed), unit(0.0, 1.0), zipf(zipf),
+          value(options.valueSize, 'x')
+    {
+    }
+
+    int insert(size_t index)
+    {
+        return writeKey(makeKey(index));
+    }
+
+    void execute(RunState& state, ConnectionStats& stats)
+    {
+        OpType op = chooseOp();
+        ++stats.ops[static_cast<size_t>(op)];
+        switch (op) {
+            case OpType::READ:
+                classify(readKey(makeKey(chooseKey(state))), true, stats);
+                break;
+            case OpType::UPDATE:
+                classify(writeKey(makeKey(chooseKey(state))), false, stats);
+                break;
+            case OpType::INSERT:
+                classify(insert(state.nextInsert.fetch_add(1)), false, stats);
+                break;
+            case OpType::SCAN: {
+                size_t length = 1 + static_cast<size_t>(unit(rng) * SCAN_MAX_LENGTH) % SCAN_MAX_LENGTH;
+                std::string target = "/keys/range?from=" + makeKey(chooseKey(state)) + "&limit=" + std::to_string(length);
+                classify(connection.request("GET", target, "", response), false, stats);
+                break;
+            }
+            case OpType::RMW: {
+                std::string key = makeKey(chooseKey(state));
+                int status = readKey(key);
+                if (status == 200 || status == 404) status = writeKey(key);
+                classify(status, false, stats);
+                break;
+            }
+            case OpType::REMOVE:
+                classify(removeKey(makeKey(chooseKey(state))), true, stats);
+                break;
+        }
+    }
+};
+
+static uint64_t nanosBetween(Clock::time_point from, Clock::time_point to)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+static void runConnection(const Options& options, const ZipfianGenerator& zipf, size_t id, RunState& state,
+                          ConnectionStats& stats)
+{
+    Client client(options, zipf, options.seed + id);
+    bool openLoop = options.rate > 0;
+    // Each connection carries an equal share of the rate, staggered so the
+    // connections do not all fire at the same instant.
+    std::chrono::nanoseconds interval(openLoop ? static_cast<int64_t>(1e9 * options.connections / options.rate) : 0);
+    Clock::time_point scheduled = state.start + interval * id / options.connections;
+
+    while (true) {
+        if (openLoop) {
+            if (scheduled >= state.end) break;
+            std::this_thread::sleep_until(scheduled);
+        }
+        Clock::time_point sent = Clock::now();
+        if (!openLoop) {
+            if (sent >= state.end) break;
+            scheduled = sent;
+        }
+        client.execute(state, stats);
+        Clock::time_point done = Clock::now();
+        stats.serviceNs.push_back(nanosBetween(sent, done));
+        stats.latencyNs.push_back(nanosBetween(scheduled, done));
+        scheduled += interval;
+    }
+}
+
+static bool loadRecords(const Options& options, const ZipfianGenerator& zipf)
+{
+    std::atomic<size_t> failures(0);
+    auto begin = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < options.connections; ++c) {
+        threads.emplace_back([&, c] {
+            Client client(options, zipf, options.seed + c);
+            for (size_t i = c; i < options.records; i += options.connections) {
+                int status = client.insert(i);
+                if (status < 200 || status >= 300) failures.fetch_add(1);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::cout << "Loaded " << options.records << " records in " << seconds << "s, "
+              << failures.load() << " failed" << std::endl;
+    return failures.load() == 0;
+}
+
+static double percentileUs(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    return sorted[idx] / 1000.0;
+}
+
+static bool parseArgs(int argc, char* argv[], Options& options)
+{
+    presetWorkload("a", options.workload);
+    bool customMix = false;
+    double mix[OP_TYPES] = {};
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        std::string arg = argv[i];
+        size_t opIndex = OP_TYPES;
+        for (size_t op = 0; op < OP_TYPES; ++op) {
+            if (arg == std::string("--") + OP_NAMES[op]) opIndex = op;
+        }
+        if (opIndex < OP_TYPES && hasValue) {
+            mix[opIndex] = std::atof(argv[++i]);
+            customMix = true;
+        } else if (arg == "--host" && hasValue) {
+            options.host = argv[++i];
+        } else if (arg == "--port" && hasValue) {
+            options.port = argv[++i];
+        } else if (arg == "--workload" && hasValue) {
+            if (!presetWorkload(argv[++i], options.workload)) {
+                std::cerr << "Unknown workload: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--records" && hasValue) {
+            options.records = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--load") {
+            options.load = true;
+        } else if (arg == "--connections" && hasValue) {
+            options.connections = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--duration" && hasValue) {
+            options.duration = std::atof(argv[++i]);
+        } else if (arg == "--rate" && hasValue) {
+            options.rate = std::atof(argv[++i]);
+        } else if (arg == "--value-size" && hasValue) {
+            options.valueSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--raw") {
+            options.raw = true;
+        } else if (arg == "--csv" && hasValue) {
+            options.csvFile = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            options.jsonFile = argv[++i];
+        } else {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (customMix) {
+        double total = 0;
+        for (double p : mix) total += p;
+        if (total <= 0) {
+            std::cerr << "Operation proportions must add up to more than 0" << std::endl;
+            return false;
+        }
+        for (size_t op = 0; op < OP_TYPES; ++op) options.workload.mix[op] = mix[op] / total;
+        options.workload.name += "-custom";
+    }
+    if (options.connections == 0 || options.records == 0 || options.duration <= 0) {
+        std::cerr << "--connections, --records and --duration must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 1;
+
+    const ZipfianGenerator zipf(options.records);
+    if (options.load && !loadRecords(options, zipf)) {
+        std::cerr << "Some records failed to load; is the server running on " << options.host << ":"
+                  << options.port << "?" << std::endl;
+    }
+
+    RunState state;
+    state.nextInsert = options.records;
+    std::vector<ConnectionStats> stats(options.connections);
+    std::vector<std::thread> threads;
+    // Leave the threads time to connect before the first scheduled request.
+    state.start = Clock::now() + std::chrono::milliseconds(100);
+    state.end = state.start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    for (size_t c = 0; c < options.connections; ++c) {
+        threads.emplace_back(runConnection, std::cref(options), std::cref(zipf), c, std::ref(state), std::ref(stats[c]));
+    }
+    for (auto& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - state.start).count();
+
+    ConnectionStats total;
+    for (auto& s : stats) {
+        total.serviceNs.insert(total.serviceNs.end(), s.serviceNs.begin(), s.serviceNs.end());
+        total.latencyNs.insert(total.latencyNs.end(), s.latencyNs.begin(), s.latencyNs.end());
+        for (size_t op = 0; op < OP_TYPES; ++op) total.ops[op] += s.ops[op];
+        total.errors += s.errors;
+        total.rejected += s.rejected;
+        total.misses += s.misses;
+    }
+    std::sort(total.serviceNs.begin(), total.serviceNs.end());
+    std::sort(total.latencyNs.begin(), total.latencyNs.end());
+
+    size_t ops = total.serviceNs.size();
+    double throughput = seconds > 0 ? ops / seconds : 0;
+    const char* mode = options.rate > 0 ? "open" : "closed";
+    double maxUs = total.latencyNs.empty() ? 0 : total.latencyNs.back() / 1000.0;
+    const double quantiles[] = {0.50, 0.99, 0.999};
+    const char* const quantileNames[] = {"p50", "p99", "p999"};
+
+    std::cout << "workload=" << options.workload.name << " api=" << (options.raw ? "raw" : "json") << " mode=" << mode << " target_rate=" << options.rate
+              << " connections=" << options.connections << " duration=" << seconds << "s\n"
+              << "  ops=" << ops << " throughput=" << throughput << " ops/s errors=" << total.errors
+              << " rejected=" << total.rejected << " misses=" << total.misses << "\n  mix:";
+    for (size_t op = 0; op < OP_TYPES; ++op) {
+        if (total.ops[op]) std::cout << " " << OP_NAMES[op] << "=" << total.ops[op];
+    }
+    std::cout << "\n  service_us";
+    for (size_t q = 0; q < 3; ++q) std::cout << " " << quantileNames[q] << "=" << percentileUs(total.serviceNs, quantiles[q]);
+    std::cout << "\n  latency_us";
+    for (size_t q = 0; q < 3; ++q) std::cout << " " << quantileNames[q] << "=" << percentileUs(total.latencyNs, quantiles[q]);
+    std::cout << " max=" << maxUs << std::endl;
+
+    if (!options.csvFile.empty()) {
+        bool writeHeader;
+        {
+            std::ifstream existing(options.csvFile);
+            writeHeader = !existing.is_open() || existing.peek() == std::ifstream::traits_type::eof();
+        }
+        std::ofstream csv(options.csvFile, std::ios::app);
+        if (!csv.is_open()) {
+            std::cerr << "Failed to open " << options.csvFile << std::endl;
+            return 1;
+        }
+        if (writeHeader) {
+            csv << "timestamp,workload,mode,target_rate,connections,seconds,ops,ops_per_sec,errors,rejected,misses,"
+                   "service_p50_us,service_p99_us,service_p999_us,latency_p50_us,latency_p99_us,latency_p999_us,"
+                   "latency_max_us\n";
+        }
+        csv << time(nullptr) << ',' << options.workload.name << ',' << mode << ',' << options.rate << ','
+            << options.connections << ',' << seconds << ',' << ops << ',' << throughput << ',' << total.errors << ','
+            << total.rejected << ',' << total.misses;
+        for (double q : quantiles) csv << ',' << percentileUs(total.serviceNs, q);
+        for (double q : quantiles) csv << ',' << percentileUs(total.latencyNs, q);
+        csv << ',' << maxUs << '\n';
+    }
+
+    if (!options.jsonFile.empty()) {
+        nlohmann::json j;
+        j["timestamp"] = time(nullptr);
+        j["config"] = {{"host", options.host}, {"port", options.port}, {"workload", options.workload.name},
+                       {"mode", mode}, {"target_rate", options.rate}, {"connections", options.connections},
+                       {"duration", options.duration}, {"records", options.records},
+                       {"value_size", options.valueSize}, {"api", options.raw ? "raw" : "json"}};
+        j["results"] = {{"seconds", seconds}, {"ops", ops}, {"ops_per_sec", throughput},
+                        {"errors", total.errors}, {"rejected", total.rejected}, {"misses", total.misses}};
+        for (size_t op = 0; op < OP_TYPES; ++op) j["results"]["mix"][OP_NAMES[op]] = total.ops[op];
+        for (size_t q = 0; q < 3; ++q) {
+            j["results"]["service_us"][quantileNames[q]] = percentileUs(total.serviceNs, quantiles[q]);
+            j["results"]["latency_us"][quantileNames[q]] = percentileUs(total.latencyNs, quantiles[q]);
+        }
+        j["results"]["latency_us"]["max"] = maxUs;
+        std::ofstream out(options.jsonFile);
+        if (!out.is_open()) {
+            std::cerr << "Failed to open " << options.jsonFile << std::endl;
+            return 1;
+        }
+        out << j.dump(4) << std::endl;
+    }
+    return 0;
+}
@@ -1,10 +1,131 @@
 #include "hash_map_rcu.h"
+#include "replication.h"
+#include "cluster.h"
 #include "server.h"
+#include "persistence.h"
+#include "trace.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
 
-int main() {
-    HashMap hashmap;
+// Usage: hash_map [--port N] [--data FILE] [--max-queue-depth N] [--ordered-index]
+//                 [--repl-port N] [--replicaof HOST:PORT]
+//                 [--cluster HOST:PORT,HOST:PORT,...] [--self HOST:PORT]
+//                 [--hash fnv|fnv-mixed] [--eviction lru|none]
+//                 [--reclaim refcount|epoch] [--concurrency lockfree|striped]
+//                 [--hotkey-sample N] [--near-cache N] [--compress-threshold BYTES]
+//                 [--huge-pages] [--heap FILE] [--memory-quota BYTES] [--trace-sample N]
+// A node whose --self is not in the --cluster list joins that cluster.
+// --hash through --concurrency pick the engine's policies (see hash_policies.h).
+// --hotkey-sample N feeds one operation in N to /admin/hotkeys (0 turns it off).
+// --near-cache N gives each server thread an N-entry cache of hot reads.
+// --compress-threshold BYTES stores longer values compressed (0, the default, never).
+// --huge-pages asks for transparent huge pages behind the entry slabs (Linux).
+// --heap FILE restarts from a memory-mapped image of the table instead of the
+// --data snapshot (which is only read if FILE has no image yet) and saves to it.
+// --memory-quota BYTES bounds the default map's entries (keyspaces set their own).
+// --trace-sample N traces one request in N for /admin/trace (default 100; 0 turns it off).
+int main(int argc, char* argv[]) {
+    uint16_t port = 8080;
+    std::string dataFile = "hashmap.json";
+    size_t maxQueueDepth = DEFAULT_MAX_QUEUE_DEPTH;
+    bool orderedIndex = false;
+    uint16_t replPort = 0;
+    std::string primaryHost;
+    uint16_t primaryPort = 0;
+    std::vector<std::string> clusterNodes;
+    std::string self;
+    EngineConfig engine;
+    uint32_t hotKeySample = DEFAULT_HOT_KEYS_SAMPLE;
+    size_t nearCacheSlots = 0;
+    size_t compressThreshold = 0;
+    std::string heapFile;
+    size_t memoryQuota = 0;
 
-    start_server(hashmap);
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--port") == 0 && hasValue) {
+            port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--data") == 0 && hasValue) {
+            dataFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--max-queue-depth") == 0 && hasValue) {
+            maxQueueDepth = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--ordered-index") == 0) {
+            orderedIndex = true;
+        } else if (std::strcmp(argv[i], "--repl-port") == 0 && hasValue) {
+            replPort = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--replicaof") == 0 && hasValue) {
+            std::string target = argv[++i];
+            size_t colon = target.rfind(':');
+            if (colon == std::string::npos) {
+                std::cerr << "--replicaof expects HOST:PORT" << std::endl;
+                return 1;
+            }
+            primaryHost = target.substr(0, colon);
+            primaryPort = static_cast<uint16_t>(std::atoi(target.c_str() + colon + 1));
+        } else if (std::strcmp(argv[i], "--cluster") == 0 && hasValue) {
+            std::stringstream list(argv[++i]);
+            std::string node;
+            while (std::getline(list, node, ',')) {
+                if (!node.empty()) clusterNodes.push_back(node);
+            }
+        } else if (std::strcmp(argv[i], "--self") == 0 && hasValue) {
+            self = argv[++i];
+        } else if (std::strcmp(argv[i], "--hotkey-sample") == 0 && hasValue) {
+            hotKeySample = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--near-cache") == 0 && hasValue) {
+            nearCacheSlots = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--compress-threshold") == 0 && hasValue) {
+            compressThreshold = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--memory-quota") == 0 && hasValue) {
+            memoryQuota = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--trace-sample") == 0 && hasValue) {
+            Trace::setSampleRate(static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(argv[i], "--heap") == 0 && hasValue) {
+            heapFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--huge-pages") == 0) {
+            Slab::useHugePages(true);
+        } else if ((std::strcmp(argv[i], "--hash") == 0 || std::strcmp(argv[i], "--eviction") == 0 ||
+                    std::strcmp(argv[i], "--reclaim") == 0 || std::strcmp(argv[i], "--concurrency") == 0) && hasValue) {
+            if (!engine.set(argv[i], argv[i + 1])) {
+                std::cerr << "Unknown value for " << argv[i] << ": " << argv[i + 1] << std::endl;
+                return 1;
+            }
+            ++i;
+        }
+    }
+
+    // Snapshot loading happens in the constructor and keeps values in the form
+    // they were saved in, so the threshold only affects new writes. The heap
+    // image loads on a background thread, so every setting it reads is applied
+    // before attachHeap() starts it.
+    std::unique_ptr<HashMap> engineMap = makeHashMap(engine, heapFile.empty() ? dataFile : std::string(), maxQueueDepth);
+    HashMap& hashmap = *engineMap;
+    std::cout << "Engine: " << hashmap.engine_name() << std::endl;
+    hashmap.setHotKeySampleRate(hotKeySample);
+    hashmap.enableNearCache(nearCacheSlots);
+    hashmap.setCompressionThreshold(compressThreshold);
+    hashmap.setMemoryQuota(memoryQuota);
+    if (!heapFile.empty()) {
+        std::string error;
+        if (hashmap.attachHeap(heapFile, error)) {
+            std::cout << "Heap image: mapped " << heapFile << ", loading in the background" << std::endl;
+        } else {
+            std::cout << "Heap image: " << error << "; loading " << dataFile << std::endl;
+            Persistence::loadFromFile(hashmap, dataFile);
+        }
+    }
+    if (orderedIndex) hashmap.enableOrderedIndex();
+
+    Replication replication(hashmap, replPort, primaryHost, primaryPort);
+
+    if (self.empty()) self = "127.0.0.1:" + std::to_string(port);
+    Cluster cluster(hashmap, self, clusterNodes);
+
+    Keyspaces keyspaces(maxQueueDepth);
+    start_server(hashmap, replication, cluster, keyspaces, port);
 
     return 0;
 }
@@ -0,0 +1,388 @@
+#include "mapped_heap.h"
+#include "fnv_hash.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct FileHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t headerBytes;
+    uint64_t bucketCount;
+    uint64_t entryCount;
+    uint64_t fileBytes;
+    int64_t savedAt;
+    uint64_t checksum;      // FNV-1a of every byte before this field
+};
+
+// Followed by the key and then the value, padded to 8 bytes.
+struct EntryHeader {
+    uint64_t next;          // offset of the next entry in the bucket, 0 = none
+    int64_t expiry;
+    int64_t lastAccessed;
+    uint32_t index;
+    uint32_t keyLength;
+    uint32_t valueLength;
+    uint32_t flags;
+    uint64_t checksum;      // see payloadChecksum()
+};
+
+const uint32_t ENTRY_COMPRESSED = 1;
+const uint64_t ALIGNMENT = 8;
+
+uint64_t aligned(uint64_t n)
+{
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+uint64_t headerChecksum(const FileHeader &header)
+{
+    return fnv1a_hash(std::string_view(reinterpret_cast<const char*>(&header), offsetof(FileHeader, checksum)));
+}
+
+uint64_t payloadChecksum(std::string_view key, std::string_view value)
+{
+    return fnv1a_hash(key) ^ fnv1a_hash_mixed(value);
+}
+
+// Buffered writes to a file descriptor, so the image can be synced to disk
+// before the rename that publishes it. Any failure sticks until finish().
+class ImageFile
+{
+    public:
+    explicit ImageFile(const std::string &fileName)
+    {
+#ifdef _WIN32
+        fd = _open(fileName.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+        failed = fd < 0;
+        buffer.reserve(BUFFER_BYTES);
+    }
+    ~ImageFile() { if (fd >= 0) closeFile(); }
+    ImageFile(const ImageFile&) = delete;
+    ImageFile& operator=(const ImageFile&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+
+    void write(const void *data, size_t size)
+    {
+        if (failed) return;
+        const char *bytes = static_cast<const char*>(data);
+        if (buffer.size() + size > BUFFER_BYTES) flushBuffer();
+        if (size >= BUFFER_BYTES) {
+            writeAll(bytes, size);
+        } else {
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+    }
+
+    // Writes what is buffered, waits for it to reach the disk and closes.
+    bool finish()
+    {
+        flushBuffer();
+#ifdef _WIN32
+        if (!failed && _commit(fd) != 0) failed = true;
+#else
+        if (!failed && fsync(fd) != 0) failed = true;
+#endif
+        if (closeFile() != 0) failed = true;
+        return !failed;
+    }
+
+    private:
+    static const size_t BUFFER_BYTES = 1 << 20;
+    int fd;
+    bool failed;
+    std::vector<char> buffer;
+
+    void flushBuffer()
+    {
+        if (!buffer.empty()) writeAll(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    void writeAll(const char *data, size_t size)
+    {
+        while (!failed && size > 0) {
+#ifdef _WIN32
+            int chunk = size > (1u << 30) ? (1 << 30) : static_cast<int>(size);
+            int n = _write(fd, data, chunk);
+#else
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            if (n <= 0) {
+                failed = true;
+                return;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+    int closeFile()
+    {
+#ifdef _WIN32
+        int result = _close(fd);
+#else
+        int result = ::close(fd);
+#endif
+        fd = -1;
+        return result;
+    }
+};
+
+// Moves the synced temporary file over `fileName` and makes the rename itself
+// durable.
+bool publish(const std::string &temp, const std::string &fileName)
+{
+#ifdef _WIN32
+    return MoveFileExA(temp.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (std::rename(temp.c_str(), fileName.c_str()) != 0) return false;
+    size_t slash = fileName.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : fileName.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#endif
+}
+
+}
+
+std::unique_ptr<MappedHeap> MappedHeap::open(const std::string &fileName, std::string &error)
+{
+    std::unique_ptr<MappedHeap> heap(new MappedHeap());
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = "cannot open " + fileName;
+        return nullptr;
+    }
+    heap->fileHandle = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || static_cast<uint64_t>(size.QuadPart) < sizeof(FileHeader)) {
+        error = fileName + " is too short to be a heap image";
+        return nullptr;
+    }
+    heap->mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!heap->mappingHandle) {
+        error = "cannot map " + fileName;
+        return nullptr;
+    }
+    heap->base = static_cast<const char*>(MapViewOfFile(heap->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!heap->base) {
+        error = "cannot map " + fileName;
+        return nullptr;
+    }
+    heap->length = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + fileName;
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        error = fileName + " is too short to be a heap image";
+        return nullptr;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        error = "cannot map " + fileName;
+        return nullptr;
+    }
+    heap->base = static_cast<const char*>(mapped);
+    heap->length = static_cast<size_t>(st.st_size);
+#endif
+
+    FileHeader header;
+    std::memcpy(&header, heap->base, sizeof(header));
+    if (std::memcmp(header.magic, MAPPED_HEAP_MAGIC, sizeof(header.magic)) != 0 || header.format != MAPPED_HEAP_FORMAT ||
+        header.headerBytes != sizeof(FileHeader) || header.checksum != headerChecksum(header)) {
+        error = fileName + " is not a heap image of this version";
+        return nullptr;
+    }
+    if (header.fileBytes != heap->length) {
+        error = fileName + " is truncated";
+        return nullptr;
+    }
+    uint64_t room = heap->length - sizeof(FileHeader);
+    if (header.bucketCount == 0 || (header.bucketCount & (header.bucketCount - 1)) != 0 ||
+        header.bucketCount > room / sizeof(uint64_t) ||
+        header.entryCount > (room - header.bucketCount * sizeof(uint64_t)) / sizeof(EntryHeader) ||
+        header.entryCount > UINT32_MAX) {
+        error = fileName + " has an invalid header";
+        return nullptr;
+    }
+    heap->bucketCount = header.bucketCount;
+    heap->entryCount = header.entryCount;
+    heap->dataStart = sizeof(FileHeader) + header.bucketCount * sizeof(uint64_t);
+    return heap;
+}
+
+MappedHeap::~MappedHeap()
+{
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+#else
+    if (base) munmap(const_cast<char*>(base), length);
+#endif
+}
+
+// `end` is where the following entry starts, or 0 if the entry does not fit
+// in the file, in which case nothing after it can be trusted either.
+bool MappedHeap::readEntry(uint64_t offset, Entry &out, uint64_t &nextInChain, uint64_t &end) const
+{
+    end = 0;
+    if (offset < dataStart || offset % ALIGNMENT != 0 || offset > length || length - offset < sizeof(EntryHeader)) return false;
+    EntryHeader header;
+    std::memcpy(&header, base + offset, sizeof(header));
+    uint64_t payload = static_cast<uint64_t>(header.keyLength) + header.valueLength;
+    if (payload > length - offset - sizeof(EntryHeader)) return false;
+    end = offset + aligned(sizeof(EntryHeader) + payload);
+    if (end > length) end = length;
+    // Chains only point forward, so a damaged link cannot send a walk in circles.
+    nextInChain = header.next > offset ? header.next : 0;
+
+    const char* key = base + offset + sizeof(EntryHeader);
+    out.key = std::string_view(key, header.keyLength);
+    out.value = std::string_view(key + header.keyLength, header.valueLength);
+    out.expiry = static_cast<time_t>(header.expiry);
+    out.lastAccessed = static_cast<time_t>(header.lastAccessed);
+    out.compressed = (header.flags & ENTRY_COMPRESSED) != 0;
+    out.index = header.index;
+    return header.index < entryCount && header.checksum == payloadChecksum(out.key, out.value);
+}
+
+uint64_t MappedHeap::bucketHead(uint64_t bucket) const
+{
+    uint64_t offset;
+    std::memcpy(&offset, base + sizeof(FileHeader) + bucket * sizeof(uint64_t), sizeof(offset));
+    return offset;
+}
+
+bool MappedHeap::find(std::string_view key, Entry &out) const
+{
+    uint64_t offset = bucketHead(fnv1a_hash(key) & (bucketCount - 1));
+    while (offset != 0) {
+        uint64_t nextInChain = 0;
+        uint64_t end;
+        bool valid = readEntry(offset, out, nextInChain, end);
+        if (end == 0) return false;
+        if (valid && out.key == key) return true;
+        offset = nextInChain;
+    }
+    return false;
+}
+
+bool MappedHeap::next(Cursor &cursor, Entry &out, bool &valid) const
+{
+    while (cursor.offset == 0) {
+        if (cursor.bucket >= bucketCount) return false;
+        cursor.offset = bucketHead(cursor.bucket++);
+    }
+    uint64_t nextInChain = 0;
+    uint64_t end;
+    valid = readEntry(cursor.offset, out, nextInChain, end);
+    cursor.offset = end ? nextInChain : 0;
+    return true;
+}
+
+// Entries are grouped by bucket, so every chain is a run of increasing offsets.
+bool MappedHeap::write(const std::string &fileName, const std::vector<Entry> &entries)
+{
+    std::vector<const Entry*> kept;
+    kept.reserve(entries.size());
+    for (const Entry& e : entries) {
+        if (e.key.size() <= UINT32_MAX && e.value.size() <= UINT32_MAX) kept.push_back(&e);
+    }
+    uint64_t bucketCount = 16;
+    while (bucketCount < kept.size()) bucketCount <<= 1;
+
+    std::vector<uint64_t> bucketOf(kept.size());
+    std::vector<size_t> starts(bucketCount + 1, 0);
+    for (size_t i = 0; i < kept.size(); ++i) {
+        bucketOf[i] = fnv1a_hash(kept[i]->key) & (bucketCount - 1);
+        starts[bucketOf[i] + 1]++;
+    }
+    for (size_t b = 0; b < bucketCount; ++b) starts[b + 1] += starts[b];
+    std::vector<size_t> order(kept.size());
+    std::vector<size_t> fill(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < kept.size(); ++i) order[fill[bucketOf[i]]++] = i;
+
+    std::vector<uint64_t> heads(bucketCount, 0);
+    std::vector<uint64_t> offsets(order.size());
+    uint64_t offset = sizeof(FileHeader) + bucketCount * sizeof(uint64_t);
+    for (size_t pos = 0; pos < order.size(); ++pos) {
+        const Entry& e = *kept[order[pos]];
+        offsets[pos] = offset;
+        if (pos == starts[bucketOf[order[pos]]]) heads[bucketOf[order[pos]]] = offset;
+        offset += aligned(sizeof(EntryHeader) + e.key.size() + e.value.size());
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAPPED_HEAP_MAGIC, sizeof(header.magic));
+    header.format = MAPPED_HEAP_FORMAT;
+    header.headerBytes = sizeof(FileHeader);
+    header.bucketCount = bucketCount;
+    header.entryCount = order.size();
+    header.fileBytes = offset;
+    header.savedAt = static_cast<int64_t>(time(nullptr));
+    header.checksum = headerChecksum(header);
+
+    const std::string temp = fileName + ".tmp";
+    ImageFile out(temp);
+    if (!out.isOpen()) return false;
+    out.write(&header, sizeof(header));
+    out.write(heads.data(), heads.size() * sizeof(uint64_t));
+    static const char padding[ALIGNMENT] = {};
+    for (size_t pos = 0; pos < order.size(); ++pos) {
+        const Entry& e = *kept[order[pos]];
+        bool lastInBucket = pos + 1 == starts[bucketOf[order[pos]] + 1];
+        EntryHeader entry{};
+        entry.next = lastInBucket ? 0 : offsets[pos + 1];
+        entry.expiry = static_cast<int64_t>(e.expiry);
+        entry.lastAccessed = static_cast<int64_t>(e.lastAccessed);
+        entry.index = static_cast<uint32_t>(pos);
+        entry.keyLength = static_cast<uint32_t>(e.key.size());
+        entry.valueLength = static_cast<uint32_t>(e.value.size());
+        entry.flags = e.compressed ? ENTRY_COMPRESSED : 0;
+        entry.checksum = payloadChecksum(e.key, e.value);
+        out.write(&entry, sizeof(entry));
+        out.write(e.key.data(), e.key.size());
+        out.write(e.value.data(), e.value.size());
+        uint64_t size = sizeof(EntryHeader) + e.key.size() + e.value.size();
+        out.write(padding, aligned(size) - size);
+    }
+    // The data must be on disk before the rename can be: otherwise a power
+    // loss can keep the new name and lose what it points to.
+    if (!out.finish()) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    if (!publish(temp, fileName)) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
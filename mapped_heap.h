@@ -0,0 +1,79 @@
+#ifndef MAPPED_HEAP_H
+#define MAPPED_HEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// On-disk image of the table that is used in place through a read-only
+// memory mapping. A header is followed by a power-of-two bucket array and the
+// entries; buckets and chains link entries by file offset, never by address,
+// so the image is valid wherever it is mapped. Opening one only maps the file
+// and checks the header, whatever the number of entries.
+//
+// Images are written whole to a temporary file, synced to disk, and renamed
+// over the old one (the directory is synced too), so a crash or power loss
+// leaves either the previous image or the new one. Entries are still checked as
+// they are read (bounds, chain order, checksum) and a bad one is skipped, so a
+// damaged file can lose entries but cannot make a reader leave the mapping.
+// The layout is native-endian and only meant to be read by the same build.
+const char MAPPED_HEAP_MAGIC[8] = {'F', 'K', 'V', 'H', 'E', 'A', 'P', '\0'};
+const uint32_t MAPPED_HEAP_FORMAT = 1;
+
+class MappedHeap
+{
+    public:
+    struct Entry {
+        std::string_view key;
+        std::string_view value;     // ValueCodec bytes when `compressed`
+        time_t expiry;
+        time_t lastAccessed;
+        bool compressed;
+        uint32_t index;             // 0..entries()-1, unique per entry
+    };
+
+    // Maps `fileName` and validates its header. Returns nullptr with `error`
+    // set if the file is missing, truncated, or not a heap image.
+    static std::unique_ptr<MappedHeap> open(const std::string &fileName, std::string &error);
+    // Writes `entries` as a fresh image. False if the file could not be written
+    // or synced; the previous image may then still be in place.
+    static bool write(const std::string &fileName, const std::vector<Entry> &entries);
+
+    ~MappedHeap();
+    MappedHeap(const MappedHeap&) = delete;
+    MappedHeap& operator=(const MappedHeap&) = delete;
+
+    size_t entries() const { return entryCount; }
+    // Looks `key` up through the bucket array.
+    bool find(std::string_view key, Entry &out) const;
+    // Position of a walk over every entry, bucket by bucket.
+    struct Cursor {
+        uint64_t bucket = 0;
+        uint64_t offset = 0;
+    };
+    // Steps `cursor` to the next entry; false after the last one. `valid` is
+    // false for a damaged entry, and `out` is only usable when it is true.
+    // Damage that hides where the next entry is ends that bucket's chain only.
+    bool next(Cursor &cursor, Entry &out, bool &valid) const;
+
+    private:
+    MappedHeap() = default;
+    uint64_t bucketHead(uint64_t bucket) const;
+    bool readEntry(uint64_t offset, Entry &out, uint64_t &nextInChain, uint64_t &end) const;
+
+    const char *base = nullptr;
+    size_t length = 0;
+    uint64_t bucketCount = 0;
+    uint64_t entryCount = 0;
+    uint64_t dataStart = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+#endif
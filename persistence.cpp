@@ -6,7 +6,56 @@
 #include <vector>
 #include <string>
 #include <ctime>              
-.
+#include <cstdint>
+#include <cstring>
+
+static const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Compressed values are binary, which JSON strings cannot hold, so they are
+// written as base64; the snapshot still shrinks by most of the compression.
+static std::string base64Encode(const std::string& in)
+{
+    std::string out;
+    out.reserve((in.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        uint32_t n = (static_cast<unsigned char>(in[i]) << 16) | (static_cast<unsigned char>(in[i + 1]) << 8) | static_cast<unsigned char>(in[i + 2]);
+        out.push_back(BASE64_CHARS[(n >> 18) & 63]);
+        out.push_back(BASE64_CHARS[(n >> 12) & 63]);
+        out.push_back(BASE64_CHARS[(n >> 6) & 63]);
+        out.push_back(BASE64_CHARS[n & 63]);
+    }
+    if (i < in.size()) {
+        uint32_t n = static_cast<unsigned char>(in[i]) << 16;
+        if (i + 1 < in.size()) n |= static_cast<unsigned char>(in[i + 1]) << 8;
+        out.push_back(BASE64_CHARS[(n >> 18) & 63]);
+        out.push_back(BASE64_CHARS[(n >> 12) & 63]);
+        out.push_back(i + 1 < in.size() ? BASE64_CHARS[(n >> 6) & 63] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+static bool base64Decode(const std::string& in, std::string& out)
+{
+    out.clear();
+    out.reserve(in.size() / 4 * 3);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : in) {
+        if (c == '=') break;
+        const char* pos = std::strchr(BASE64_CHARS, c);
+        if (!pos || c == '\0') return false;
+        buffer = (buffer << 6) | static_cast<uint32_t>(pos - BASE64_CHARS);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((buffer >> bits) & 0xff));
+        }
+    }
+    return true;
+}
+
 bool Persistence::saveToFile(const HashMap& map, const std::string& fileName) {
     nlohmann::json j;
     try {
@@ -15,10 +64,11 @@ bool Persistence::saveToFile(const HashMap& map, const std::string& fileName) {
         for (const auto& itemData : allData) {
             // Store data in the JSON object
             j[itemData.key] = {
-                {"value", itemData.value},
+                {"value", itemData.compressed ? base64Encode(itemData.value) : itemData.value},
                 {"expiry", itemData.expiry},
                 {"lastAccessed", itemData.lastAccessed}
             };
+            if (itemData.compressed) j[itemData.key]["compressed"] = true;
         }
 
         std::ofstream outfile(fileName);
@@ -81,7 +131,16 @@ bool Persistence::loadFromFile(HashMap& map, const std::string& fileName) {
                     continue;
                 }
             }
-            map.set(key, value, ttl); 
+            bool compressed = itemDataJson.value("compressed", false);
+            if (compressed) {
+                std::string encoded;
+                if (!base64Decode(value, encoded)) {
+                    std::cerr << "Persistence Warning: Skipping corrupt compressed value for key '" << key << "' in " << fileName << std::endl;
+                    continue;
+                }
+                value = std::move(encoded);
+            }
+            map.restore(key, value, ttl, compressed); 
         }
         
         return true;
@@ -0,0 +1,412 @@
+#include "replication.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using asio::ip::tcp;
+
+enum FrameType : uint8_t {
+    FRAME_HELLO = 'H',
+    FRAME_FULLSYNC = 'F',
+    FRAME_CONTINUE = 'C',
+    FRAME_SET = 'S',
+    FRAME_DEL = 'D',
+    FRAME_SNAPSHOT_END = 'E',
+    FRAME_PING = 'P'
+};
+
+const size_t REPL_BATCH_ENTRIES = 1024;
+const size_t REPL_SNAPSHOT_BATCH = 256;
+
+struct Frame {
+    uint8_t type = 0;
+    uint64_t offset = 0;
+    std::string key;
+    std::string value;
+    int64_t expiry = 0;
+};
+
+static void putU32(std::string& out, uint32_t v)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<char>((v >> shift) & 0xff));
+}
+
+static void putU64(std::string& out, uint64_t v)
+{
+    for (int shift = 56; shift >= 0; shift -= 8) out.push_back(static_cast<char>((v >> shift) & 0xff));
+}
+
+static uint64_t getBE(const unsigned char* p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+static void encodeFrame(std::string& out, uint8_t type, uint64_t offset, const std::string& key = "",
+                        const std::string& value = "", int64_t expiry = 0)
+{
+    out.push_back(static_cast<char>(type));
+    putU64(out, offset);
+    putU32(out, static_cast<uint32_t>(key.size()));
+    out.append(key);
+    putU32(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+    putU64(out, static_cast<uint64_t>(expiry));
+}
+
+static void encodeEntry(std::string& out, HashMap& hashmap, const ReplEntry& entry)
+{
+    HashMap::NodeData data;
+    if (hashmap.lookupEntry(entry.key, data)) {
+        encodeFrame(out, FRAME_SET, entry.offset, entry.key, data.value, data.expiry);
+    } else {
+        encodeFrame(out, FRAME_DEL, entry.offset, entry.key);
+    }
+}
+
+static Frame readFrame(tcp::socket& socket)
+{
+    Frame frame;
+    unsigned char header[13];
+    asio::read(socket, asio::buffer(header, sizeof(header)));
+    frame.type = header[0];
+    frame.offset = getBE(header + 1, 8);
+
+    // Lengths are checked before anything is allocated for them.
+    size_t keyLength = getBE(header + 9, 4);
+    if (keyLength > REPL_MAX_FRAME_BYTES) throw std::runtime_error("replication frame too large");
+    frame.key.resize(keyLength);
+    if (!frame.key.empty()) asio::read(socket, asio::buffer(&frame.key[0], frame.key.size()));
+
+    unsigned char len[4];
+    asio::read(socket, asio::buffer(len, sizeof(len)));
+    size_t valueLength = getBE(len, 4);
+    if (valueLength > REPL_MAX_FRAME_BYTES - keyLength) throw std::runtime_error("replication frame too large");
+    frame.value.resize(valueLength);
+    if (!frame.value.empty()) asio::read(socket, asio::buffer(&frame.value[0], frame.value.size()));
+
+    unsigned char expiry[8];
+    asio::read(socket, asio::buffer(expiry, sizeof(expiry)));
+    frame.expiry = static_cast<int64_t>(getBE(expiry, 8));
+    return frame;
+}
+
+static std::string newReplId()
+{
+    static const char hex[] = "0123456789abcdef";
+    std::random_device rd;
+    std::mt19937_64 gen(rd());
+    std::string id;
+    for (int i = 0; i < 16; ++i) id.push_back(hex[gen() & 0xf]);
+    return id;
+}
+
+void ReplicationLog::record(const std::string& key)
+{
+    {
+        std::lock_guard<std::mutex> lock(logMutex);
+        entries.push_back(ReplEntry{++lastOffset, key});
+        entryBytes += key.size();
+        while (entries.size() > REPL_BACKLOG_ENTRIES || entryBytes > REPL_BACKLOG_BYTES) {
+            entryBytes -= entries.front().key.size();
+            entries.pop_front();
+        }
+    }
+    logCV.notify_all();
+}
+
+uint64_t ReplicationLog::currentOffset()
+{
+    std::lock_guard<std::mutex> lock(logMutex);
+    return lastOffset;
+}
+
+bool ReplicationLog::readFrom(uint64_t from, std::vector<ReplEntry>& out, size_t maxEntries, std::chrono::milliseconds wait)
+{
+    std::unique_lock<std::mutex> lock(logMutex);
+    if (from > lastOffset) return false;
+    if (from == lastOffset && wait.count() > 0) {
+        logCV.wait_for(lock, wait, [&] { return lastOffset > from; });
+    }
+    if (from == lastOffset) return true;
+    if (entries.empty() || from + 1 < entries.front().offset) return false;
+
+    size_t start = static_cast<size_t>(from + 1 - entries.front().offset);
+    for (size_t i = start; i < entries.size() && out.size() < maxEntries; ++i) {
+        out.push_back(entries[i]);
+    }
+    return true;
+}
+
+Replication::Replication(HashMap& map, uint16_t listenPort, const std::string& primaryHost, uint16_t primaryPort)
+    : hashmap(map), log(std::make_shared<ReplicationLog>()), replId(newReplId()), running(true),
+      readOnly(!primaryHost.empty()), listenPort(listenPort), connectedReplicas(0),
+      primaryHost(primaryHost), primaryPort(primaryPort), replicaRunning(!primaryHost.empty()),
+      appliedOffset(0), primaryOffset(0), linkUp(false), lastContact(0)
+{
+    // A standalone node has no one to send the log to, so its writes skip it.
+    if (listenPort != 0 || !primaryHost.empty()) {
+        std::shared_ptr<ReplicationLog> sharedLog = log;
+        hashmap.setMutationListener([sharedLog](const std::string& key) { sharedLog->record(key); });
+    }
+
+    if (listenPort != 0) {
+        acceptor.reset(new tcp::acceptor(io, tcp::endpoint(asio::ip::make_address(REPL_BIND_ADDRESS), listenPort)));
+        acceptThread = std::thread(&Replication::acceptLoop, this);
+    }
+    if (replicaRunning) {
+        replicaThread = std::thread(&Replication::replicaLoop, this);
+    }
+}
+
+Replication::~Replication()
+{
+    running = false;
+    replicaRunning = false;
+    {
+        std::lock_guard<std::mutex> lock(replicaSocketMutex);
+        if (replicaSocket) {
+            try { replicaSocket->shutdown(tcp::socket::shutdown_both); } catch (...) {}
+        }
+    }
+    if (replicaThread.joinable()) replicaThread.join();
+
+    if (acceptThread.joinable()) {
+        // A blocking accept() is not interrupted by close(); wake it with a connection.
+        try {
+            tcp::socket wake(io);
+            wake.connect(tcp::endpoint(asio::ip::make_address(REPL_BIND_ADDRESS), listenPort));
+        } catch (...) {}
+        acceptThread.join();
+    }
+
+    log->wakeAll();
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    for (auto& session : sessions) {
+        if (session.thread.joinable()) session.thread.join();
+    }
+}
+
+void Replication::reapSessions()
+{
+    auto done = std::remove_if(sessions.begin(), sessions.end(), [](Session& session) {
+        if (!session.finished->load()) return false;
+        session.thread.join();
+        return true;
+    });
+    sessions.erase(done, sessions.end());
+}
+
+void Replication::acceptLoop()
+{
+    while (running.load(std::memory_order_relaxed)) {
+        auto socket = std::make_shared<tcp::socket>(io);
+        try {
+            acceptor->accept(*socket);
+        } catch (const std::exception& e) {
+            std::cerr << "Replication accept error: " << e.what() << std::endl;
+            continue;
+        }
+        if (!running.load(std::memory_order_relaxed)) break;
+
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        reapSessions();
+        auto finished = std::make_shared<std::atomic<bool>>(false);
+        sessions.push_back(Session{std::thread(&Replication::serveReplica, this, socket, finished), finished});
+    }
+}
+
+void Replication::serveReplica(std::shared_ptr<tcp::socket> socket, std::shared_ptr<std::atomic<bool>> finished)
+{
+    connectedReplicas.fetch_add(1, std::memory_order_relaxed);
+    try {
+        Frame hello = readFrame(*socket);
+        if (hello.type != FRAME_HELLO) throw std::runtime_error("expected HELLO");
+
+        std::string id;
+        {
+            std::lock_guard<std::mutex> lock(replIdMutex);
+            id = replId;
+        }
+
+        std::string out;
+        std::vector<ReplEntry> batch;
+        uint64_t from = hello.offset;
+        if (hello.key == id && log->readFrom(from, batch, 0, std::chrono::milliseconds(0))) {
+            encodeFrame(out, FRAME_CONTINUE, from, id);
+            asio::write(*socket, asio::buffer(out));
+        } else {
+            // Snapshot from the offset taken before the walk; entries changed during
+            // the walk are also in the log after `from` and are replayed on top.
+            from = log->currentOffset();
+            encodeFrame(out, FRAME_FULLSYNC, from, id);
+            uint64_t cursor = 0;
+            do {
+                HashMap::ScanPage page = hashmap.scan(cursor, REPL_SNAPSHOT_BATCH);
+                cursor = page.cursor;
+                for (const auto& key : page.keys) {
+                    HashMap::NodeData data;
+                    if (hashmap.lookupEntry(key, data)) {
+                        encodeFrame(out, FRAME_SET, 0, data.key, data.value, data.expiry);
+                    }
+                }
+                asio::write(*socket, asio::buffer(out));
+                out.clear();
+            } while (cursor != 0 && running.load(std::memory_order_relaxed));
+            encodeFrame(out, FRAME_SNAPSHOT_END, from);
+            asio::write(*socket, asio::buffer(out));
+        }
+
+        while (running.load(std::memory_order_relaxed)) {
+            batch.clear();
+            out.clear();
+            if (!log->readFrom(from, batch, REPL_BATCH_ENTRIES, REPL_PING_INTERVAL)) {
+                std::cerr << "Replica fell behind the replication backlog; dropping link" << std::endl;
+                break;
+            }
+            if (batch.empty()) {
+                encodeFrame(out, FRAME_PING, log->currentOffset());
+            } else {
+                for (const auto& entry : batch) encodeEntry(out, hashmap, entry);
+                from = batch.back().offset;
+            }
+            asio::write(*socket, asio::buffer(out));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Replication session ended: " << e.what() << std::endl;
+    }
+    connectedReplicas.fetch_sub(1, std::memory_order_relaxed);
+    finished->store(true);
+}
+
+void Replication::replicaLoop()
+{
+    while (replicaRunning.load(std::memory_order_relaxed)) {
+        try {
+            asio::io_context clientIo;
+            auto socket = std::make_shared<tcp::socket>(clientIo);
+            tcp::resolver resolver(clientIo);
+            asio::connect(*socket, resolver.resolve(primaryHost, std::to_string(primaryPort)));
+            {
+                std::lock_guard<std::mutex> lock(replicaSocketMutex);
+                if (!replicaRunning.load()) break;
+                replicaSocket = socket;
+            }
+
+            std::string hello;
+            {
+                std::lock_guard<std::mutex> lock(replIdMutex);
+                encodeFrame(hello, FRAME_HELLO, appliedOffset.load(), primaryReplId);
+            }
+            asio::write(*socket, asio::buffer(hello));
+            linkUp = true;
+            applyStream(*socket);
+        } catch (const std::exception& e) {
+            if (replicaRunning.load()) {
+                std::cerr << "Replication link to " << primaryHost << ":" << primaryPort << " failed: " << e.what() << std::endl;
+            }
+        }
+        linkUp = false;
+        {
+            std::lock_guard<std::mutex> lock(replicaSocketMutex);
+            replicaSocket.reset();
+        }
+
+        auto retryAt = std::chrono::steady_clock::now() + REPL_RECONNECT_DELAY;
+        while (replicaRunning.load() && std::chrono::steady_clock::now() < retryAt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+}
+
+void Replication::applyStream(tcp::socket& socket)
+{
+    std::string pendingReplId;
+    while (replicaRunning.load(std::memory_order_relaxed)) {
+        Frame frame = readFrame(socket);
+        lastContact = time(nullptr);
+
+        switch (frame.type) {
+            case FRAME_FULLSYNC: {
+                // Forget the old position until the snapshot is complete, so a link
+                // drop mid-snapshot forces another full resync.
+                std::lock_guard<std::mutex> lock(replIdMutex);
+                primaryReplId.clear();
+                appliedOffset = 0;
+                pendingReplId = frame.key;
+                hashmap.clear();
+                break;
+            }
+            case FRAME_SNAPSHOT_END: {
+                std::lock_guard<std::mutex> lock(replIdMutex);
+                primaryReplId = pendingReplId;
+                appliedOffset = frame.offset;
+                break;
+            }
+            case FRAME_CONTINUE:
+                break;
+            case FRAME_SET: {
+                time_t now = time(nullptr);
+                if (frame.expiry == 0) {
+                    hashmap.restore(frame.key, frame.value, 0);
+                } else if (frame.expiry > now) {
+                    hashmap.restore(frame.key, frame.value, static_cast<int>(frame.expiry - now));
+                } else {
+                    hashmap.restoreRemove(frame.key);
+                }
+                // Snapshot SETs carry offset 0 and do not advance the position.
+                if (frame.offset != 0) appliedOffset = frame.offset;
+                break;
+            }
+            case FRAME_DEL:
+                hashmap.restoreRemove(frame.key);
+                appliedOffset = frame.offset;
+                break;
+            case FRAME_PING:
+                break;
+            default:
+                throw std::runtime_error("unexpected replication frame");
+        }
+
+        if (frame.offset > primaryOffset.load()) primaryOffset = frame.offset;
+    }
+}
+
+bool Replication::promote()
+{
+    if (!readOnly.load()) return false;
+
+    replicaRunning = false;
+    {
+        std::lock_guard<std::mutex> lock(replicaSocketMutex);
+        if (replicaSocket) {
+            try { replicaSocket->shutdown(tcp::socket::shutdown_both); } catch (...) {}
+        }
+    }
+    if (replicaThread.joinable()) replicaThread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(replIdMutex);
+        replId = newReplId();
+    }
+    readOnly = false;
+    return true;
+}
+
+ReplicationStatus Replication::status()
+{
+    ReplicationStatus st;
+    st.role = readOnly.load() ? "replica" : "primary";
+    {
+        std::lock_guard<std::mutex> lock(replIdMutex);
+        st.replId = readOnly.load() ? primaryReplId : replId;
+    }
+    st.offset = log->currentOffset();
+    st.primaryOffset = primaryOffset.load();
+    st.appliedOffset = appliedOffset.load();
+    st.linkUp = linkUp.load();
+    st.lastContact = lastContact.load();
+    st.connectedReplicas = connectedReplicas.load();
+    return st;
+}
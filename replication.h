@@ -0,0 +1,133 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "hash_map_rcu.h"
+#include <asio.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Mutations kept for partial resync, bounded by count and by key bytes; a
+// replica further behind gets a full snapshot.
+const size_t REPL_BACKLOG_ENTRIES = 1 << 20;
+const size_t REPL_BACKLOG_BYTES = 64 * 1024 * 1024;
+// Largest key plus value accepted in one frame from a peer.
+const size_t REPL_MAX_FRAME_BYTES = 256 * 1024 * 1024;
+const std::chrono::milliseconds REPL_PING_INTERVAL(1000);
+const std::chrono::seconds REPL_RECONNECT_DELAY(1);
+const char* const REPL_BIND_ADDRESS = "127.0.0.1";
+
+// One replicated mutation: only the key that changed. Its state is read from
+// the table when the entry is sent.
+struct ReplEntry {
+    uint64_t offset;
+    std::string key;
+};
+
+// Ordered, bounded log of changed keys. Values are not copied into the log:
+// each entry is sent as the key's state at send time, which is at least as
+// new as the change it records, and every later change to the key is another
+// entry sent after it, so replaying in order converges on the table.
+class ReplicationLog
+{
+    private:
+    std::deque<ReplEntry> entries;
+    size_t entryBytes;
+    uint64_t lastOffset;
+    std::mutex logMutex;
+    std::condition_variable logCV;
+
+    public:
+    ReplicationLog() : entryBytes(0), lastOffset(0) {}
+
+    void record(const std::string& key);
+    uint64_t currentOffset();
+    // Appends entries with offset > from to `out`, waiting up to `wait` for new
+    // ones. Returns false when `from` is no longer covered by the backlog.
+    bool readFrom(uint64_t from, std::vector<ReplEntry>& out, size_t maxEntries, std::chrono::milliseconds wait);
+    void wakeAll() { logCV.notify_all(); }
+};
+
+struct ReplicationStatus {
+    std::string role;
+    std::string replId;
+    uint64_t offset;          // last local log offset
+    uint64_t primaryOffset;   // replica: last offset reported by the primary
+    uint64_t appliedOffset;   // replica: last primary offset applied
+    bool linkUp;
+    time_t lastContact;
+    size_t connectedReplicas;
+};
+
+// Primary/replica replication over a plain TCP stream.
+//
+// Every message is a frame: u8 type, u64 offset, u32 key length, key, u32
+// value length, value, i64 expiry (integers big-endian). A replica opens with
+// a HELLO frame carrying the replication id and offset it last applied. The
+// primary answers CONTINUE if it can serve that offset from its backlog, and
+// otherwise FULLSYNC + snapshot SETs + SNAPSHOT_END. After that it streams
+// SET/DEL frames in log order and PING frames with its offset while idle.
+// Each primary picks a fresh replication id when it starts or is promoted,
+// so offsets from another primary never resume partially.
+class Replication
+{
+    private:
+    HashMap& hashmap;
+    // Shared with the engine's mutation listener, which can outlive this object.
+    std::shared_ptr<ReplicationLog> log;
+    std::string replId;
+    std::mutex replIdMutex;
+    std::atomic<bool> running;
+    std::atomic<bool> readOnly;
+
+    // primary side
+    uint16_t listenPort;
+    std::thread acceptThread;
+    struct Session {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> finished;
+    };
+    std::vector<Session> sessions;
+    std::mutex sessionsMutex;
+    // Joins sessions whose replica has disconnected; called with sessionsMutex held.
+    void reapSessions();
+    std::atomic<size_t> connectedReplicas;
+    asio::io_context io;
+    std::unique_ptr<asio::ip::tcp::acceptor> acceptor;
+    void acceptLoop();
+    void serveReplica(std::shared_ptr<asio::ip::tcp::socket> socket, std::shared_ptr<std::atomic<bool>> finished);
+
+    // replica side
+    std::string primaryHost;
+    uint16_t primaryPort;
+    std::string primaryReplId;
+    std::thread replicaThread;
+    std::atomic<bool> replicaRunning;
+    std::atomic<uint64_t> appliedOffset;
+    std::atomic<uint64_t> primaryOffset;
+    std::atomic<bool> linkUp;
+    std::atomic<time_t> lastContact;
+    std::shared_ptr<asio::ip::tcp::socket> replicaSocket;
+    std::mutex replicaSocketMutex;
+    void replicaLoop();
+    void applyStream(asio::ip::tcp::socket& socket);
+
+    public:
+    // listenPort 0 disables serving replicas; an empty primaryHost starts as primary.
+    // Writes are only logged when the node serves replicas or is one.
+    Replication(HashMap& map, uint16_t listenPort, const std::string& primaryHost = "", uint16_t primaryPort = 0);
+    ~Replication();
+
+    bool isReadOnly() const { return readOnly.load(std::memory_order_acquire); }
+    // Stops following the primary and starts accepting writes.
+    bool promote();
+    ReplicationStatus status();
+};
+
+#endif
@@ -1,42 +1,763 @@
 #include "server.h"
+#include "watch_hub.h"
+#include "trace.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 
-void start_server(HashMap& hashmap)
+const int RETRY_AFTER_SECONDS = 1;
+const size_t DEFAULT_PAGE_SIZE = 100;
+const size_t MAX_PAGE_SIZE = 1000;
+const size_t DEFAULT_HOT_KEYS_LIMIT = 10;
+const uint64_t DEFAULT_TRACE_SECONDS = 10;
+const uint64_t MAX_TRACE_SECONDS = 300;
+
+// Fast rejection used when the engine sheds load or a queued task times out.
+static crow::response unavailable(OpStatus status)
+{
+    crow::response res(503, status == OpStatus::TIMEOUT ? "Request timed out" : "Server overloaded");
+    res.set_header("Retry-After", std::to_string(RETRY_AFTER_SECONDS));
+    return res;
+}
+
+// Maps a non-OK engine status to its HTTP response.
+static crow::response failure(OpStatus status)
+{
+    switch (status) {
+        case OpStatus::OVERLOADED:
+        case OpStatus::TIMEOUT:
+            return unavailable(status);
+        case OpStatus::NOT_FOUND:
+            return crow::response(404,"Key not found");
+        case OpStatus::INVALID:
+            return crow::response(400,"Value is not an integer or would overflow");
+        case OpStatus::CONFLICT:
+            return crow::response(409,"Version mismatch");
+        case OpStatus::FULL:
+            return crow::response(507,"Memory quota exceeded");
+        default:
+            return crow::response(500,"Internal error");
+    }
+}
+
+// Writes are refused on a replica until it is promoted.
+static crow::response readOnlyReplica()
+{
+    return crow::response(403,"Read-only replica");
+}
+
+// Returns true when `res` already holds the response: a 307 to the owner if
+// `key` belongs to another cluster node (method and body are preserved), or a
+// 503 if the key is still being migrated here and its previous owner did not
+// answer in time. Otherwise the key, if it exists, is on this node.
+static bool routeToOwner(Cluster& cluster, std::string_view key, const crow::request& req, crow::response& res)
+{
+    std::string owner = cluster.remoteOwner(key);
+    if (owner.empty()) {
+        if (cluster.pullIfMigrating(key)) return false;
+        res = crow::response(503, "Key is being migrated here; retry");
+        res.set_header("Retry-After", "1");
+        return true;
+    }
+    res = crow::response(307);
+    res.set_header("Location", "http://" + owner + req.raw_url);
+    res.set_header("X-Fastkv-Owner", owner);
+    return true;
+}
+
+// Keys in /kv/<key> paths arrive percent-encoded; Crow leaves path parameters as sent.
+static std::string urlDecode(const std::string& encoded)
+{
+    std::string out;
+    out.reserve(encoded.size());
+    for (size_t i = 0; i < encoded.size(); ++i) {
+        if (encoded[i] == '%' && i + 2 < encoded.size() && std::isxdigit(static_cast<unsigned char>(encoded[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(encoded[i + 2]))) {
+            out.push_back(static_cast<char>(std::stoi(encoded.substr(i + 1, 2), nullptr, 16)));
+            i += 2;
+        } else {
+            out.push_back(encoded[i]);
+        }
+    }
+    return out;
+}
+
+// TTL of a raw write: the X-Fastkv-TTL header, else ?ttl=, else none.
+static int rawTtl(const crow::request& req)
+{
+    const std::string& header = req.get_header_value("X-Fastkv-TTL");
+    if (!header.empty()) return std::atoi(header.c_str());
+    const char* param = req.url_params.get("ttl");
+    return param ? std::atoi(param) : 0;
+}
+
+// Accepts one range: "bytes=first-last", "bytes=first-" or "bytes=-count".
+// Anything else, several ranges included, is ignored and the whole value
+// sent, which RFC 9110 allows.
+static bool parseRange(const std::string& header, HashMap::ByteRange& range)
+{
+    const std::string unit = "bytes=";
+    if (header.compare(0, unit.size(), unit) != 0) return false;
+    std::string spec = header.substr(unit.size());
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos || spec.find(',') != std::string::npos) return false;
+
+    auto number = [](const std::string& digits, uint64_t& out) {
+        if (digits.empty() || digits.size() > 19) return false;
+        if (!std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) return false;
+        out = std::strtoull(digits.c_str(), nullptr, 10);
+        return true;
+    };
+    std::string from = spec.substr(0, dash);
+    std::string to = spec.substr(dash + 1);
+    if (from.empty()) {
+        range.suffix = true;
+        return number(to, range.length);
+    }
+    if (!number(from, range.first)) return false;
+    if (to.empty()) return true;
+    uint64_t last;
+    if (!number(to, last) || last < range.first) return false;
+    range.length = last - range.first + 1;
+    return true;
+}
+
+static size_t pageSize(const char* limit)
+{
+    if (!limit) return DEFAULT_PAGE_SIZE;
+    size_t n = std::strtoul(limit, nullptr, 10);
+    if (n == 0) return DEFAULT_PAGE_SIZE;
+    return std::min(n, MAX_PAGE_SIZE);
+}
+
+// "next" is only set when the page is full; pass it back as `after` to continue.
+static crow::response keyPage(const std::vector<std::string>& keys, size_t limit)
+{
+    crow::json::wvalue res;
+    res["keys"] = keys;
+    if (keys.size() == limit) res["next"] = keys.back();
+    return crow::response(res);
+}
+
+static std::vector<crow::json::wvalue> hotKeyList(const std::vector<HotKeyTracker::Entry>& entries)
+{
+    std::vector<crow::json::wvalue> list;
+    for (const auto& e : entries) {
+        crow::json::wvalue item;
+        item["key"] = e.key;
+        item["estimate"] = e.count;
+        item["error"] = e.error;
+        list.push_back(std::move(item));
+    }
+    return list;
+}
+
+static std::vector<crow::json::wvalue> bucketList(const std::vector<HashMap::BucketInfo>& buckets)
+{
+    std::vector<crow::json::wvalue> list;
+    for (const auto& b : buckets) {
+        crow::json::wvalue item;
+        item["bucket"] = b.bucket;
+        item["length"] = b.length;
+        item["contention"] = b.contention;
+        list.push_back(std::move(item));
+    }
+    return list;
+}
+
+static crow::json::wvalue keyspaceStats(const Keyspace& space)
+{
+    HashMap::Stats st = space.map->stats();
+    uint64_t reads = st.readHits + st.readMisses;
+    crow::json::wvalue res;
+    res["name"] = space.name;
+    res["engine"] = space.map->engine_name();
+    res["entries"] = st.entries;
+    res["memory_bytes"] = st.memoryBytes;
+    res["memory_quota"] = space.map->memory_quota();
+    res["default_ttl"] = space.defaultTtl;
+    res["read_hits"] = st.readHits;
+    res["read_misses"] = st.readMisses;
+    res["hit_ratio"] = reads ? static_cast<double>(st.readHits) / reads : 0.0;
+    res["rejected"] = space.map->rejected_tasks();
+    return res;
+}
+
+void start_server(HashMap& hashmap, Replication& replication, Cluster& cluster, Keyspaces& keyspaces, uint16_t port)
 {
     crow::SimpleApp app;
 
     CROW_ROUTE(app,"/set").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+        Trace::Scope trace(Trace::begin());
+        Trace::Span span("POST /set");
+        if (replication.isReadOnly()) return readOnlyReplica();
+        Trace::Span parse("parse_json");
         auto body=crow::json::load(req.body);
+        parse.end();
         if (!body) return crow::response(400,"Invalid JSON");
 
         std::string key = body["key"].s();
+        crow::response redirect;
+        if (routeToOwner(cluster, key, req, redirect)) return redirect;
         std::string value = body["value"].s();
         int ttl = body.has("ttl") ? body["ttl"].i() : 0;
 
-        hashmap.set(key,value,ttl);
-        return crow::response(200,"Key set successfully");
+        OpStatus status = hashmap.set(key,value,ttl);
+        if (status != OpStatus::OK) return failure(status);
+        return crow::response(202,"Key set accepted");
     });
 
     CROW_ROUTE(app,"/get").methods(crow::HTTPMethod::Get)([&](const crow::request& req)
 {
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span("GET /get");
     auto key = req.url_params.get("key");
     if (!key) return crow::response(400,"Missing key");
+    std::string_view keyView(key);
+    crow::response redirect;
+    if (routeToOwner(cluster, keyView, req, redirect)) return redirect;
 
-    std::string value = hashmap.get(key);
-    if (value.empty()) return crow::response(404,"Key not found"); 
+    // Reused by every request on this thread, so a lookup does not allocate
+    // before the response is built.
+    static thread_local std::string value;
+    uint64_t version = 0;
+    Trace::Span lookup("table_get");
+    OpStatus status = hashmap.get(keyView, value, &version);
+    lookup.end();
+    if (status != OpStatus::OK) return failure(status);
 
+    Trace::Span build("build_json");
     crow::json::wvalue res;
     res["key"] = key;
     res["value"] = value;
+    res["version"] = version;
     return crow::response(res);
 });
 
 CROW_ROUTE(app,"/remove").methods(crow::HTTPMethod::Delete)([&](const crow::request& req){
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span("DELETE /remove");
+    if (replication.isReadOnly()) return readOnlyReplica();
+    auto key = req.url_params.get("key");
+    if (!key) return crow::response(400,"Missing key");
+    crow::response redirect;
+    if (routeToOwner(cluster, key, req, redirect)) return redirect;
+
+    OpStatus status = cluster.removeKey(key);
+    if (status != OpStatus::OK) return failure(status);
+    return crow::response(200,"Key removed");
+});
+
+auto incrRoute = [&](const crow::request& req, int64_t sign){
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span(sign > 0 ? "POST /incr" : "POST /decr");
+    if (replication.isReadOnly()) return readOnlyReplica();
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("key")) return crow::response(400,"Invalid JSON");
+
+    std::string key = body["key"].s();
+    crow::response redirect;
+    if (routeToOwner(cluster, key, req, redirect)) return redirect;
+    int64_t by = body.has("by") ? body["by"].i() : 1;
+
+    int64_t value = 0;
+    OpStatus status = hashmap.incrBy(key, sign * by, value);
+    if (status != OpStatus::OK) return failure(status);
+
+    crow::json::wvalue res;
+    res["key"] = key;
+    res["value"] = value;
+    return crow::response(res);
+};
+
+CROW_ROUTE(app,"/incr").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+    return incrRoute(req, 1);
+});
+
+CROW_ROUTE(app,"/decr").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+    return incrRoute(req, -1);
+});
+
+// version 0 means "only if the key does not exist"; on 409 the body carries the current version.
+CROW_ROUTE(app,"/cas").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span("POST /cas");
+    if (replication.isReadOnly()) return readOnlyReplica();
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("key") || !body.has("value") || !body.has("version")) return crow::response(400,"Invalid JSON");
+
+    std::string key = body["key"].s();
+    crow::response redirect;
+    if (routeToOwner(cluster, key, req, redirect)) return redirect;
+    std::string value = body["value"].s();
+    uint64_t expected = body["version"].u();
+    int ttl = body.has("ttl") ? body["ttl"].i() : 0;
+
+    uint64_t version = 0;
+    OpStatus status = hashmap.compareAndSet(key, expected, value, ttl, version);
+    if (status != OpStatus::OK && status != OpStatus::CONFLICT) return failure(status);
+
+    crow::json::wvalue res;
+    res["key"] = key;
+    res["version"] = version;
+    return crow::response(status == OpStatus::OK ? 200 : 409, std::move(res));
+});
+
+CROW_ROUTE(app,"/append").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span("POST /append");
+    if (replication.isReadOnly()) return readOnlyReplica();
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("key") || !body.has("value")) return crow::response(400,"Invalid JSON");
+
+    std::string key = body["key"].s();
+    crow::response redirect;
+    if (routeToOwner(cluster, key, req, redirect)) return redirect;
+    uint64_t version = 0;
+    OpStatus status = hashmap.append(key, body["value"].s(), version);
+    if (status != OpStatus::OK) return failure(status);
+
+    crow::json::wvalue res;
+    res["key"] = key;
+    res["version"] = version;
+    return crow::response(res);
+});
+
+CROW_ROUTE(app,"/touch").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span("POST /touch");
+    if (replication.isReadOnly()) return readOnlyReplica();
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("key")) return crow::response(400,"Invalid JSON");
+
+    std::string key = body["key"].s();
+    crow::response redirect;
+    if (routeToOwner(cluster, key, req, redirect)) return redirect;
+    int ttl = body.has("ttl") ? body["ttl"].i() : 0;
+    OpStatus status = hashmap.touch(key, ttl);
+    if (status != OpStatus::OK) return failure(status);
+    return crow::response(200,"TTL updated");
+});
+
+// Raw values: the key comes from the path and the body is the value itself,
+// so nothing but the URL is parsed and values are neither escaped into JSON
+// nor copied into a JSON document. Crow de-chunks chunked uploads and streams
+// large response bodies from the buffer it is given.
+CROW_ROUTE(app,"/kv/<path>").methods(crow::HTTPMethod::Put)([&](const crow::request& req, const std::string& path){
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span("PUT /kv");
+    std::string key = urlDecode(path);
+    if (replication.isReadOnly()) return readOnlyReplica();
+    crow::response redirect;
+    if (routeToOwner(cluster, key, req, redirect)) return redirect;
+    OpStatus status = hashmap.set(key, req.body, rawTtl(req));
+    if (status != OpStatus::OK) return failure(status);
+    return crow::response(202,"Key set accepted");
+});
+
+// Honours a single-range Range header with 206 and Content-Range, copying only
+// the requested bytes out of the table. Whole-value reads go through get() and
+// so through the near cache. X-Fastkv-Version is the version /cas expects.
+CROW_ROUTE(app,"/kv/<path>").methods(crow::HTTPMethod::Get)([&](const crow::request& req, const std::string& path){
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span("GET /kv");
+    std::string key = urlDecode(path);
+    crow::response redirect;
+    if (routeToOwner(cluster, key, req, redirect)) return redirect;
+
+    HashMap::ByteRange range;
+    bool partial = parseRange(req.get_header_value("Range"), range);
+    std::string value;
+    uint64_t total = 0;
+    uint64_t version = 0;
+    OpStatus status = partial ? hashmap.getRange(key, range, value, total, &version) : hashmap.get(key, value, &version);
+    if (status != OpStatus::OK) return failure(status);
+    if (!partial) total = value.size();
+    if (partial && !range.satisfiable(total)) {
+        crow::response res(416, "Range not satisfiable");
+        res.set_header("Content-Range", "bytes */" + std::to_string(total));
+        return res;
+    }
+
+    uint64_t first = range.suffix ? total - value.size() : range.first;
+    crow::response res(partial ? 206 : 200);
+    res.set_header("Content-Type", "application/octet-stream");
+    res.set_header("Accept-Ranges", "bytes");
+    res.set_header("X-Fastkv-Version", std::to_string(version));
+    if (partial) {
+        res.set_header("Content-Range", "bytes " + std::to_string(first) + "-" + std::to_string(first + value.size() - 1) +
+                                        "/" + std::to_string(total));
+    }
+    res.body = std::move(value);
+    return res;
+});
+
+CROW_ROUTE(app,"/kv/<path>").methods(crow::HTTPMethod::Delete)([&](const crow::request& req, const std::string& path){
+    Trace::Scope trace(Trace::begin());
+    Trace::Span span("DELETE /kv");
+    std::string key = urlDecode(path);
+    if (replication.isReadOnly()) return readOnlyReplica();
+    crow::response redirect;
+    if (routeToOwner(cluster, key, req, redirect)) return redirect;
+
+    OpStatus status = cluster.removeKey(key);
+    if (status != OpStatus::OK) return failure(status);
+    return crow::response(200,"Key removed");
+});
+
+CROW_ROUTE(app,"/keys/prefix").methods(crow::HTTPMethod::Get)([&](const crow::request& req){
+    if (!hashmap.ordered_index_enabled()) return crow::response(501,"Ordered index disabled");
+    auto prefix = req.url_params.get("prefix");
+    if (!prefix) return crow::response(400,"Missing prefix");
+    auto after = req.url_params.get("after");
+    size_t limit = pageSize(req.url_params.get("limit"));
+
+    return keyPage(hashmap.scanPrefix(prefix, limit, after ? after : ""), limit);
+});
+
+CROW_ROUTE(app,"/keys/range").methods(crow::HTTPMethod::Get)([&](const crow::request& req){
+    if (!hashmap.ordered_index_enabled()) return crow::response(501,"Ordered index disabled");
+    auto from = req.url_params.get("from");
+    auto to = req.url_params.get("to");
+    auto after = req.url_params.get("after");
+    size_t limit = pageSize(req.url_params.get("limit"));
+
+    return keyPage(hashmap.scanRange(from ? from : "", to ? to : "", limit, after ? after : ""), limit);
+});
+
+// Cursor-based iteration: start at cursor=0 and stop when the returned cursor is 0.
+CROW_ROUTE(app,"/scan").methods(crow::HTTPMethod::Get)([&](const crow::request& req){
+    auto cursorParam = req.url_params.get("cursor");
+    uint64_t cursor = cursorParam ? std::strtoull(cursorParam, nullptr, 10) : 0;
+    size_t count = pageSize(req.url_params.get("count"));
+
+    HashMap::ScanPage page = hashmap.scan(cursor, count);
+    crow::json::wvalue res;
+    res["cursor"] = page.cursor;
+    res["keys"] = page.keys;
+    return crow::response(res);
+});
+
+// Key change notifications; see WatchHub::onMessage for the subscribe protocol.
+WatchHub watchHub(hashmap);
+CROW_WEBSOCKET_ROUTE(app,"/watch")
+    .onopen([&](crow::websocket::connection& conn){
+        watchHub.onOpen(conn);
+    })
+    .onclose([&](crow::websocket::connection& conn, const std::string&){
+        watchHub.onClose(conn);
+    })
+    .onmessage([&](crow::websocket::connection& conn, const std::string& data, bool){
+        watchHub.onMessage(conn, data);
+    });
+
+CROW_ROUTE(app,"/admin/replication").methods(crow::HTTPMethod::Get)([&](){
+    ReplicationStatus st = replication.status();
+    crow::json::wvalue res;
+    res["role"] = st.role;
+    res["repl_id"] = st.replId;
+    res["offset"] = st.offset;
+    res["connected_replicas"] = st.connectedReplicas;
+    if (st.role == "replica") {
+        res["link_up"] = st.linkUp;
+        res["primary_offset"] = st.primaryOffset;
+        res["applied_offset"] = st.appliedOffset;
+        res["lag"] = st.primaryOffset - std::min(st.appliedOffset, st.primaryOffset);
+        res["seconds_since_contact"] = st.lastContact ? static_cast<int64_t>(time(nullptr) - st.lastContact) : -1;
+    }
+    return crow::response(res);
+});
+
+CROW_ROUTE(app,"/admin/promote").methods(crow::HTTPMethod::Post)([&](){
+    if (!replication.promote()) return crow::response(409,"Already primary");
+    return crow::response(200,"Promoted to primary");
+});
+
+// Entry counts, heap image entries still loading, read hit ratio, worker batch
+// sizes, what compression is saving and slab occupancy.
+CROW_ROUTE(app,"/admin/stats").methods(crow::HTTPMethod::Get)([&](){
+    HashMap::Stats st = hashmap.stats();
+    uint64_t reads = st.readHits + st.readMisses;
+    crow::json::wvalue res;
+    res["engine"] = hashmap.engine_name();
+    res["entries"] = st.entries;
+    res["capacity"] = hashmap.current_capacity();
+    res["queue_depth"] = hashmap.queue_depth();
+    res["rejected"] = hashmap.rejected_tasks();
+    res["read_hits"] = st.readHits;
+    res["read_misses"] = st.readMisses;
+    res["hit_ratio"] = reads ? static_cast<double>(st.readHits) / reads : 0.0;
+    res["memory_bytes"] = st.memoryBytes;
+    res["memory_quota"] = hashmap.memory_quota();
+    res["heap_pending"] = hashmap.heap_pending();
+
+    crow::json::wvalue compression;
+    compression["threshold"] = hashmap.compression_threshold();
+    compression["compressed_entries"] = st.compressedEntries;
+    compression["logical_bytes"] = st.logicalValueBytes;
+    compression["stored_bytes"] = st.storedValueBytes;
+    compression["saved_bytes"] = st.logicalValueBytes - std::min(st.storedValueBytes, st.logicalValueBytes);
+    compression["ratio"] = st.logicalValueBytes ? static_cast<double>(st.storedValueBytes) / st.logicalValueBytes : 1.0;
+    res["compression"] = std::move(compression);
+
+    HashMap::BatchStats batch = hashmap.batchStats();
+    crow::json::wvalue batches;
+    batches["count"] = batch.batches;
+    batches["tasks"] = batch.tasks;
+    batches["mean_size"] = batch.batches ? static_cast<double>(batch.tasks) / batch.batches : 0.0;
+    batches["collapsed_sets"] = batch.collapsed;
+    batches["size_histogram"] = batch.histogram;
+    res["worker_batches"] = std::move(batches);
+
+    Slab::Stats slabs = Slab::stats();
+    std::vector<crow::json::wvalue> classes;
+    for (const auto& c : slabs.classes) {
+        crow::json::wvalue item;
+        item["chunk_size"] = c.chunkSize;
+        item["pages"] = c.pages;
+        item["chunks"] = c.chunks;
+        item["used"] = c.used;
+        classes.push_back(std::move(item));
+    }
+    crow::json::wvalue slab;
+    slab["page_size"] = SLAB_PAGE_SIZE;
+    slab["classes"] = std::move(classes);
+    slab["pool_pages"] = slabs.poolPages;
+    slab["pages_released"] = slabs.pagesReleased;
+    slab["large_bytes"] = slabs.largeBytes;
+    res["slabs"] = std::move(slab);
+    return crow::response(res);
+});
+
+// Sampled top keys plus bucket chain lengths and write contention. Estimates
+// are scaled by the sample rate and may overcount by up to "error".
+CROW_ROUTE(app,"/admin/hotkeys").methods(crow::HTTPMethod::Get)([&](const crow::request& req){
+    const char* limitParam = req.url_params.get("limit");
+    size_t limit = limitParam ? std::strtoul(limitParam, nullptr, 10) : DEFAULT_HOT_KEYS_LIMIT;
+    limit = std::min(limit == 0 ? DEFAULT_HOT_KEYS_LIMIT : limit, HOT_KEYS_CAPACITY);
+
+    crow::json::wvalue res;
+    res["sample_rate"] = hashmap.hot_key_sample_rate();
+    res["reads"] = hotKeyList(hashmap.hotReadKeys(limit));
+    res["writes"] = hotKeyList(hashmap.hotWriteKeys(limit));
+
+    HashMap::BucketStats stats = hashmap.bucketStats(limit);
+    crow::json::wvalue buckets;
+    buckets["count"] = stats.buckets;
+    buckets["non_empty"] = stats.nonEmpty;
+    buckets["max_chain"] = stats.maxChain;
+    buckets["mean_chain"] = stats.meanChain;
+    buckets["histogram"] = stats.histogram;
+    buckets["contention"] = stats.contention;
+    buckets["longest"] = bucketList(stats.longest);
+    buckets["most_contended"] = bucketList(stats.mostContended);
+    res["buckets"] = std::move(buckets);
+    return crow::response(res);
+});
+
+// Sampled request spans from the last `seconds`, in Chrome trace event format
+// (load in chrome://tracing or ui.perfetto.dev). Spans of one request share
+// args.trace; timestamps are microseconds since tracing started.
+CROW_ROUTE(app,"/admin/trace").methods(crow::HTTPMethod::Get)([&](const crow::request& req){
+    const char* secondsParam = req.url_params.get("seconds");
+    uint64_t seconds = secondsParam ? std::strtoull(secondsParam, nullptr, 10) : DEFAULT_TRACE_SECONDS;
+    seconds = std::min(seconds == 0 ? DEFAULT_TRACE_SECONDS : seconds, MAX_TRACE_SECONDS);
+
+    std::vector<crow::json::wvalue> events;
+    for (const Trace::Event& e : Trace::collect(seconds)) {
+        crow::json::wvalue item;
+        item["name"] = e.name;
+        item["cat"] = "fastkv";
+        item["ph"] = "X";
+        item["ts"] = e.startNs / 1000.0;
+        item["dur"] = e.durationNs / 1000.0;
+        item["pid"] = 1;
+        item["tid"] = e.thread;
+        item["args"]["trace"] = e.traceId;
+        if (e.argName) item["args"][e.argName] = e.arg;
+        events.push_back(std::move(item));
+    }
+    crow::json::wvalue res;
+    res["traceEvents"] = std::move(events);
+    res["displayTimeUnit"] = "ms";
+    res["otherData"]["sample_rate"] = Trace::sample_rate();
+    res["otherData"]["seconds"] = seconds;
+    return crow::response(res);
+});
+
+CROW_ROUTE(app,"/cluster/nodes").methods(crow::HTTPMethod::Get)([&](){
+    if (!cluster.isEnabled()) return crow::response(501,"Cluster mode disabled");
+    ClusterStatus st = cluster.status();
+    crow::json::wvalue res;
+    res["self"] = st.self;
+    res["epoch"] = st.epoch;
+    res["nodes"] = st.nodes;
+    res["migrating"] = st.migratingNodes;
+    return crow::response(res);
+});
+
+// Adds a node and tells every other member unless this is already a forwarded call.
+CROW_ROUTE(app,"/cluster/nodes").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+    if (!cluster.isEnabled()) return crow::response(501,"Cluster mode disabled");
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("node")) return crow::response(400,"Invalid JSON");
+
+    std::string node = body["node"].s();
+    std::vector<std::string> peers = cluster.addNode(node);
+    if (!body.has("forwarded")) {
+        std::string forward = nlohmann::json{{"node", node}, {"forwarded", true}}.dump();
+        for (const auto& peer : peers) {
+            std::string reply;
+            clusterRequest(peer, "POST", "/cluster/nodes", forward, reply);
+        }
+    }
+    return crow::response(200,"Node added");
+});
+
+// Removes a node the same way; the node itself is told too, so it hands off
+// its keys. Body: {"node":"HOST:PORT"}.
+CROW_ROUTE(app,"/cluster/nodes").methods(crow::HTTPMethod::Delete)([&](const crow::request& req){
+    if (!cluster.isEnabled()) return crow::response(501,"Cluster mode disabled");
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("node")) return crow::response(400,"Invalid JSON");
+
+    std::string node = body["node"].s();
+    std::vector<std::string> peers = cluster.removeNode(node);
+    if (!body.has("forwarded")) {
+        std::string forward = nlohmann::json{{"node", node}, {"forwarded", true}}.dump();
+        for (const auto& peer : peers) {
+            std::string reply;
+            clusterRequest(peer, "DELETE", "/cluster/nodes", forward, reply);
+        }
+    }
+    return crow::response(200,"Node removed");
+});
+
+CROW_ROUTE(app,"/cluster/migrated").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("node") || !body.has("epoch")) return crow::response(400,"Invalid JSON");
+    if (!cluster.markMigrated(body["node"].s(), body["epoch"].u())) return crow::response(409,"Not at that epoch");
+    return crow::response(200,"OK");
+});
+
+// Node-to-node key transfer; always served locally, never redirected.
+CROW_ROUTE(app,"/cluster/export").methods(crow::HTTPMethod::Get)([&](const crow::request& req){
+    auto key = req.url_params.get("key");
+    if (!key) return crow::response(400,"Missing key");
+
+    HashMap::NodeData data;
+    if (!cluster.exportKey(key, data)) return crow::response(404,"Key not found");
+    crow::json::wvalue res;
+    res["key"] = data.key;
+    res["value"] = data.value;
+    res["expiry"] = static_cast<int64_t>(data.expiry);
+    return crow::response(res);
+});
+
+CROW_ROUTE(app,"/cluster/import").methods(crow::HTTPMethod::Post)([&](const crow::request& req){
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("key") || !body.has("value")) return crow::response(400,"Invalid JSON");
+
+    time_t expiry = body.has("expiry") ? static_cast<time_t>(body["expiry"].i()) : 0;
+    OpStatus status = cluster.importKey(body["key"].s(), body["value"].s(), expiry);
+    // CONFLICT: the owner already has a newer value, which is kept.
+    if (status != OpStatus::OK && status != OpStatus::CONFLICT) return failure(status);
+    return crow::response(200,"Imported");
+});
+
+// Named keyspaces, each with its own table; see keyspaces.h. Keys in a
+// keyspace are served by this node only and are not routed by the cluster.
+// Body (all optional): {"quota_bytes":N,"default_ttl":N,"eviction":"lru|none",
+// "hash":...,"reclaim":...,"concurrency":...} with the engine's option values.
+CROW_ROUTE(app,"/ks/<string>").methods(crow::HTTPMethod::Put)([&](const crow::request& req, const std::string& name){
+    EngineConfig config;
+    size_t quota = 0;
+    int defaultTtl = 0;
+    if (!req.body.empty()) {
+        auto body=crow::json::load(req.body);
+        if (!body) return crow::response(400,"Invalid JSON");
+        if (body.has("quota_bytes")) quota = body["quota_bytes"].u();
+        if (body.has("default_ttl")) defaultTtl = body["default_ttl"].i();
+        for (const char* option : {"hash", "eviction", "reclaim", "concurrency"}) {
+            if (body.has(option) && !config.set(std::string("--") + option, body[option].s())) {
+                return crow::response(400,std::string("Unknown value for ") + option);
+            }
+        }
+    }
+    switch (keyspaces.create(name, config, quota, defaultTtl)) {
+        case Keyspaces::CreateResult::CREATED:
+            return crow::response(201,"Keyspace created");
+        case Keyspaces::CreateResult::EXISTS:
+            return crow::response(409,"Keyspace exists");
+        case Keyspaces::CreateResult::INVALID_NAME:
+            return crow::response(400,"Invalid keyspace name");
+        default:
+            return crow::response(403,"Keyspace limit reached");
+    }
+});
+
+// Returns at once; the keyspace's memory is freed in the background.
+CROW_ROUTE(app,"/ks/<string>").methods(crow::HTTPMethod::Delete)([&](const std::string& name){
+    if (!keyspaces.drop(name)) return crow::response(404,"Keyspace not found");
+    return crow::response(200,"Keyspace dropped");
+});
+
+CROW_ROUTE(app,"/ks/<string>/set").methods(crow::HTTPMethod::Post)([&](const crow::request& req, const std::string& name){
+    std::shared_ptr<Keyspace> space = keyspaces.find(name);
+    if (!space) return crow::response(404,"Keyspace not found");
+    auto body=crow::json::load(req.body);
+    if (!body || !body.has("key") || !body.has("value")) return crow::response(400,"Invalid JSON");
+
+    int ttl = body.has("ttl") ? body["ttl"].i() : space->defaultTtl;
+    OpStatus status = space->map->set(body["key"].s(), body["value"].s(), ttl);
+    if (status != OpStatus::OK) return failure(status);
+    return crow::response(202,"Key set accepted");
+});
+
+CROW_ROUTE(app,"/ks/<string>/get").methods(crow::HTTPMethod::Get)([&](const crow::request& req, const std::string& name){
+    std::shared_ptr<Keyspace> space = keyspaces.find(name);
+    if (!space) return crow::response(404,"Keyspace not found");
     auto key = req.url_params.get("key");
     if (!key) return crow::response(400,"Missing key");
 
-    bool success = hashmap.remove(key);
-    return success ? crow::response(200,"Key removed") : crow::response(404,"Key not found");
+    static thread_local std::string value;
+    uint64_t version = 0;
+    OpStatus status = space->map->get(key, value, &version);
+    if (status != OpStatus::OK) return failure(status);
+
+    crow::json::wvalue res;
+    res["key"] = key;
+    res["value"] = value;
+    res["version"] = version;
+    return crow::response(res);
+});
+
+CROW_ROUTE(app,"/ks/<string>/remove").methods(crow::HTTPMethod::Delete)([&](const crow::request& req, const std::string& name){
+    std::shared_ptr<Keyspace> space = keyspaces.find(name);
+    if (!space) return crow::response(404,"Keyspace not found");
+    auto key = req.url_params.get("key");
+    if (!key) return crow::response(400,"Missing key");
+
+    OpStatus status = space->map->remove(key);
+    if (status != OpStatus::OK) return failure(status);
+    return crow::response(200,"Key removed");
+});
+
+CROW_ROUTE(app,"/ks/<string>/stats").methods(crow::HTTPMethod::Get)([&](const std::string& name){
+    std::shared_ptr<Keyspace> space = keyspaces.find(name);
+    if (!space) return crow::response(404,"Keyspace not found");
+    return crow::response(keyspaceStats(*space));
+});
+
+CROW_ROUTE(app,"/admin/keyspaces").methods(crow::HTTPMethod::Get)([&](){
+    std::vector<crow::json::wvalue> list;
+    for (const auto& space : keyspaces.list()) list.push_back(keyspaceStats(*space));
+    crow::json::wvalue res;
+    res["keyspaces"] = std::move(list);
+    res["pending_drops"] = keyspaces.pending_drops();
+    return crow::response(res);
 });
 
-app.port(8080).bindaddr("127.0.0.1").multithreaded().run();
+app.port(port).bindaddr("127.0.0.1").multithreaded().run();
 }
@@ -2,8 +2,11 @@
 #define SERVER_H
 
 #include "crow.h"
-#include "hash_map.h"
+#include "hash_map_rcu.h"
+#include "replication.h"
+#include "cluster.h"
+#include "keyspaces.h"
 
-void start_server(HashMap& hashmap);
+void start_server(HashMap& hashmap, Replication& replication, Cluster& cluster, Keyspaces& keyspaces, uint16_t port);
 
 #endif
\ No newline at end of file
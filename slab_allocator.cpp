@@ -0,0 +1,275 @@
+#include "slab_allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+struct FreeChunk {
+    FreeChunk* next;
+};
+
+uintptr_t pageOf(const void* p)
+{
+    return reinterpret_cast<uintptr_t>(p) & ~static_cast<uintptr_t>(SLAB_PAGE_SIZE - 1);
+}
+
+struct SizeClass {
+    size_t chunkSize = 0;
+    std::mutex mutex;
+    FreeChunk* freeList = nullptr;
+    // Unused tail of the newest page. Chunks are cut from it on demand so a
+    // page is only touched (and made resident) as it fills.
+    char* carveNext = nullptr;
+    char* carveEnd = nullptr;
+    // Page base -> chunks currently handed out from it.
+    std::unordered_map<uintptr_t, uint32_t> pages;
+
+    size_t chunksPerPage() const { return SLAB_PAGE_SIZE / chunkSize; }
+};
+
+class Arena
+{
+    private:
+    std::mutex poolMutex;
+    std::vector<void*> pool;
+
+    public:
+    std::vector<size_t> sizes;
+    std::unique_ptr<SizeClass[]> classes;
+    std::atomic<uint64_t> largeBytes{0};
+    std::atomic<uint64_t> released{0};
+    std::atomic<bool> hugePages{false};
+
+    Arena()
+    {
+        for (double s = SLAB_MIN_CHUNK;; s *= SLAB_GROWTH_FACTOR) {
+            size_t size = std::min((static_cast<size_t>(s) + 7) & ~static_cast<size_t>(7), SLAB_MAX_CHUNK);
+            if (sizes.empty() || size > sizes.back()) sizes.push_back(size);
+            if (size == SLAB_MAX_CHUNK) break;
+        }
+        classes.reset(new SizeClass[sizes.size()]);
+        for (size_t i = 0; i < sizes.size(); ++i) classes[i].chunkSize = sizes[i];
+    }
+
+    size_t classFor(size_t size) const
+    {
+        return std::lower_bound(sizes.begin(), sizes.end(), size) - sizes.begin();
+    }
+
+    void* newPage()
+    {
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if (!pool.empty()) {
+                void* page = pool.back();
+                pool.pop_back();
+                return page;
+            }
+        }
+        void* page = ::operator new(SLAB_PAGE_SIZE, std::align_val_t(SLAB_PAGE_SIZE));
+#ifdef MADV_HUGEPAGE
+        if (hugePages.load(std::memory_order_relaxed)) madvise(page, SLAB_PAGE_SIZE, MADV_HUGEPAGE);
+#endif
+        return page;
+    }
+
+    void releasePage(void* page)
+    {
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            if (pool.size() < SLAB_POOL_PAGES) {
+                pool.push_back(page);
+                return;
+            }
+        }
+        ::operator delete(page, std::align_val_t(SLAB_PAGE_SIZE));
+        released.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t poolPages()
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        return pool.size();
+    }
+
+    // Moves `want` chunks of class `cls` into `out`: freed chunks first, then
+    // fresh ones from the newest page, then from a new page.
+    size_t refill(size_t cls, void** out, size_t want)
+    {
+        SizeClass& c = classes[cls];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        size_t got = 0;
+        while (got < want) {
+            void* chunk;
+            if (c.freeList) {
+                chunk = c.freeList;
+                c.freeList = c.freeList->next;
+            } else {
+                if (!c.carveNext || c.carveNext + c.chunkSize > c.carveEnd) {
+                    c.carveNext = static_cast<char*>(newPage());
+                    c.carveEnd = c.carveNext + c.chunksPerPage() * c.chunkSize;
+                    c.pages[reinterpret_cast<uintptr_t>(c.carveNext)] = 0;
+                }
+                chunk = c.carveNext;
+                c.carveNext += c.chunkSize;
+            }
+            c.pages[pageOf(chunk)]++;
+            out[got++] = chunk;
+        }
+        return got;
+    }
+
+    void flush(size_t cls, void* const* chunks, size_t count)
+    {
+        SizeClass& c = classes[cls];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        for (size_t i = 0; i < count; ++i) {
+            FreeChunk* chunk = static_cast<FreeChunk*>(chunks[i]);
+            chunk->next = c.freeList;
+            c.freeList = chunk;
+            c.pages[pageOf(chunk)]--;
+        }
+    }
+
+    // Releases every page of `c` with no chunk handed out, except the one
+    // being carved, which stays as slack for the next allocations.
+    void shrink(SizeClass& c)
+    {
+        std::unordered_set<uintptr_t> empty;
+        {
+            std::lock_guard<std::mutex> lock(c.mutex);
+            uintptr_t carving = c.carveNext ? pageOf(c.carveNext - 1) : 0;
+            for (const auto& page : c.pages) {
+                if (page.second == 0 && page.first != carving) empty.insert(page.first);
+            }
+            if (empty.empty()) return;
+
+            FreeChunk* kept = nullptr;
+            for (FreeChunk* chunk = c.freeList; chunk;) {
+                FreeChunk* next = chunk->next;
+                if (empty.count(pageOf(chunk)) == 0) {
+                    chunk->next = kept;
+                    kept = chunk;
+                }
+                chunk = next;
+            }
+            c.freeList = kept;
+            for (uintptr_t page : empty) c.pages.erase(page);
+        }
+        for (uintptr_t page : empty) releasePage(reinterpret_cast<void*>(page));
+    }
+};
+
+// Never destroyed: threads may still flush their magazines during exit.
+Arena& arena()
+{
+    static Arena* instance = new Arena();
+    return *instance;
+}
+
+struct Magazine {
+    size_t count = 0;
+    void* chunks[SLAB_MAGAZINE_SIZE];
+};
+
+struct Magazines {
+    std::vector<Magazine> byClass;
+
+    Magazine& forClass(size_t cls)
+    {
+        if (byClass.empty()) byClass.resize(arena().sizes.size());
+        return byClass[cls];
+    }
+    ~Magazines();
+};
+
+thread_local Magazines magazines;
+// Set once this thread's magazines are gone; later frees go straight to the class.
+thread_local bool magazinesDestroyed = false;
+
+Magazines::~Magazines()
+{
+    for (size_t cls = 0; cls < byClass.size(); ++cls) {
+        if (byClass[cls].count) arena().flush(cls, byClass[cls].chunks, byClass[cls].count);
+    }
+    magazinesDestroyed = true;
+}
+
+}
+
+void* Slab::allocate(size_t size)
+{
+    Arena& a = arena();
+    if (size > SLAB_MAX_CHUNK) {
+        a.largeBytes.fetch_add(size, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+    size_t cls = a.classFor(std::max<size_t>(size, 1));
+    if (magazinesDestroyed) {
+        void* chunk;
+        a.refill(cls, &chunk, 1);
+        return chunk;
+    }
+    Magazine& m = magazines.forClass(cls);
+    if (m.count == 0) m.count = a.refill(cls, m.chunks, SLAB_MAGAZINE_SIZE / 2);
+    return m.chunks[--m.count];
+}
+
+void Slab::deallocate(void* p, size_t size)
+{
+    if (!p) return;
+    Arena& a = arena();
+    if (size > SLAB_MAX_CHUNK) {
+        a.largeBytes.fetch_sub(size, std::memory_order_relaxed);
+        ::operator delete(p);
+        return;
+    }
+    size_t cls = a.classFor(std::max<size_t>(size, 1));
+    if (magazinesDestroyed) {
+        a.flush(cls, &p, 1);
+        return;
+    }
+    Magazine& m = magazines.forClass(cls);
+    if (m.count == SLAB_MAGAZINE_SIZE) {
+        m.count -= SLAB_MAGAZINE_SIZE / 2;
+        a.flush(cls, m.chunks + m.count, SLAB_MAGAZINE_SIZE / 2);
+    }
+    m.chunks[m.count++] = p;
+}
+
+void Slab::rebalance()
+{
+    Arena& a = arena();
+    for (size_t cls = 0; cls < a.sizes.size(); ++cls) a.shrink(a.classes[cls]);
+}
+
+Slab::Stats Slab::stats()
+{
+    Arena& a = arena();
+    Stats s;
+    for (size_t cls = 0; cls < a.sizes.size(); ++cls) {
+        SizeClass& c = a.classes[cls];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        if (c.pages.empty()) continue;
+        size_t used = 0;
+        for (const auto& page : c.pages) used += page.second;
+        s.classes.push_back(ClassStats{c.chunkSize, c.pages.size(), c.pages.size() * c.chunksPerPage(), used});
+    }
+    s.poolPages = a.poolPages();
+    s.largeBytes = a.largeBytes.load(std::memory_order_relaxed);
+    s.pagesReleased = a.released.load(std::memory_order_relaxed);
+    return s;
+}
+
+void Slab::useHugePages(bool enabled)
+{
+    arena().hugePages.store(enabled, std::memory_order_relaxed);
+}
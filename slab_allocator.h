@@ -0,0 +1,69 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Memcached-style slab allocator for table entries. Requests are rounded up
+// to a size class (16 bytes growing by 1.25x); each class carves fixed-size
+// chunks out of SLAB_PAGE_SIZE pages. Threads allocate from and free into
+// small per-class magazines and only take a class lock to refill or flush
+// them in batches. Requests larger than the biggest class go to the heap.
+//
+// rebalance() hands pages whose chunks are all free back to a shared pool,
+// where any class can pick them up, and returns pages beyond the pool's
+// limit to the system, so memory follows the current mix of value sizes.
+const size_t SLAB_PAGE_SIZE = 2 * 1024 * 1024;   // one transparent huge page
+const size_t SLAB_MIN_CHUNK = 16;
+const size_t SLAB_MAX_CHUNK = 256 * 1024;
+const double SLAB_GROWTH_FACTOR = 1.25;
+const size_t SLAB_MAGAZINE_SIZE = 32;
+const size_t SLAB_POOL_PAGES = 4;
+
+class Slab
+{
+    public:
+    struct ClassStats {
+        size_t chunkSize;
+        size_t pages;
+        size_t chunks;
+        size_t used;        // handed out, including chunks cached in magazines
+    };
+    struct Stats {
+        std::vector<ClassStats> classes;   // only classes that own pages
+        size_t poolPages;
+        uint64_t largeBytes;               // live allocations above SLAB_MAX_CHUNK
+        uint64_t pagesReleased;            // given back to the system so far
+    };
+
+    static void* allocate(size_t size);
+    static void deallocate(void* p, size_t size);
+    static void rebalance();
+    static Stats stats();
+    // Ask the kernel to back new pages with transparent huge pages (Linux only).
+    static void useHugePages(bool enabled);
+};
+
+// Stateless allocator so standard containers can draw from the slabs.
+template <class T>
+struct SlabAllocator {
+    using value_type = T;
+
+    SlabAllocator() = default;
+    template <class U>
+    SlabAllocator(const SlabAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(Slab::allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { Slab::deallocate(p, n * sizeof(T)); }
+};
+
+template <class T, class U>
+bool operator==(const SlabAllocator<T>&, const SlabAllocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const SlabAllocator<T>&, const SlabAllocator<U>&) { return false; }
+
+using SlabString = std::basic_string<char, std::char_traits<char>, SlabAllocator<char>>;
+
+#endif
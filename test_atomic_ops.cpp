@@ -0,0 +1,83 @@
+// compareAndSet, incrBy and touch.
+#include "test_check.h"
+#include <thread>
+#include <vector>
+
+static void testCompareAndSet(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    uint64_t version = 0, next = 0;
+    CHECK(map->setBlocking("k", "one", 0, version) == OpStatus::OK);
+
+    CHECK(map->compareAndSet("k", version + 1, "two", 0, next) == OpStatus::CONFLICT);
+    CHECK(map->compareAndSet("k", 0, "two", 0, next) == OpStatus::CONFLICT);
+    CHECK(map->compareAndSet("k", version, "two", 0, next) == OpStatus::OK);
+    CHECK(next != version);
+    CHECK(map->compareAndSet("k", version, "three", 0, next) == OpStatus::CONFLICT);
+
+    std::string value;
+    uint64_t current = 0;
+    CHECK(map->get("k", value, &current) == OpStatus::OK);
+    CHECK(value == "two");
+    CHECK(current == next);
+
+    // Expected version 0 inserts only if the key is absent.
+    CHECK(map->compareAndSet("fresh", 0, "x", 0, next) == OpStatus::OK);
+    CHECK(map->compareAndSet("fresh", 0, "y", 0, next) == OpStatus::CONFLICT);
+}
+
+static void testIncrement(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    int64_t value = 0;
+    CHECK(map->incrBy("n", 5, value) == OpStatus::OK);
+    CHECK(value == 5);
+    CHECK(map->incrBy("n", -7, value) == OpStatus::OK);
+    CHECK(value == -2);
+
+    uint64_t version = 0;
+    map->setBlocking("text", "abc", 0, version);
+    CHECK(map->incrBy("text", 1, value) == OpStatus::INVALID);
+    map->setBlocking("big", std::to_string(INT64_MAX), 0, version);
+    CHECK(map->incrBy("big", 1, value) == OpStatus::INVALID);
+
+    const int threads = 4, perThread = 500;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&map] {
+            int64_t ignored;
+            for (int i = 0; i < perThread; ++i) map->incrBy("shared", 1, ignored);
+        });
+    }
+    for (std::thread &worker : workers) worker.join();
+    CHECK(map->incrBy("shared", 0, value) == OpStatus::OK);
+    CHECK(value == threads * perThread);
+}
+
+static void testTouch(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    uint64_t version = 0;
+    std::string value;
+    CHECK(map->touch("missing", 10) == OpStatus::NOT_FOUND);
+
+    map->setBlocking("keep", "v", 1, version);
+    map->setBlocking("drop", "v", 0, version);
+    CHECK(map->touch("keep", 0) == OpStatus::OK);
+    CHECK(map->touch("drop", 1) == OpStatus::OK);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+
+    CHECK(map->get("keep", value) == OpStatus::OK);
+    CHECK(map->get("drop", value) == OpStatus::NOT_FOUND);
+    CHECK(map->touch("drop", 10) == OpStatus::NOT_FOUND);
+}
+
+int main()
+{
+    forEachEngine([](const EngineConfig &config) {
+        testCompareAndSet(config);
+        testIncrement(config);
+        testTouch(config);
+    });
+    return finish();
+}
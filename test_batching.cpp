@@ -0,0 +1,32 @@
+// Batch-draining workers: sets to one key queued together collapse into the
+// last of them.
+#include "test_check.h"
+#include <thread>
+
+static void testBatchCollapsing(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    const int writes = 20000;
+    std::string last;
+    for (int i = 0; i < writes; ++i) {
+        last = "v" + std::to_string(i);
+        while (map->set("hot", last) == OpStatus::OVERLOADED) std::this_thread::yield();
+    }
+
+    // Only the last write may survive, whichever sets were skipped.
+    std::string value;
+    for (int i = 0; i < 500 && !(map->get("hot", value) == OpStatus::OK && value == last); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(value == last);
+
+    HashMap::BatchStats stats = map->batchStats();
+    CHECK(stats.collapsed > 0);
+    CHECK(stats.tasks <= static_cast<uint64_t>(writes));
+}
+
+int main()
+{
+    forEachEngine(testBatchCollapsing);
+    return finish();
+}
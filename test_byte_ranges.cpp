@@ -0,0 +1,74 @@
+// getRange: slices, suffixes and ranges past the end, on plain and
+// compressed values, and which ranges /kv can satisfy at all.
+#include "test_check.h"
+
+static void testRangeReads(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    map->setCompressionThreshold(64);
+    uint64_t version = 0, total = 0;
+    std::string value;
+    map->setBlocking("small", "0123456789", 0, version);
+    std::string big;
+    for (int i = 0; i < 1000; ++i) big += "line " + std::to_string(i) + "\n";
+    map->setBlocking("big", big, 0, version);
+
+    HashMap::ByteRange middle;
+    middle.first = 2;
+    middle.length = 3;
+    CHECK(map->getRange("small", middle, value, total) == OpStatus::OK);
+    CHECK(value == "234");
+    CHECK(total == 10);
+
+    HashMap::ByteRange tail;
+    tail.suffix = true;
+    tail.length = 4;
+    CHECK(map->getRange("small", tail, value, total) == OpStatus::OK);
+    CHECK(value == "6789");
+
+    HashMap::ByteRange past;
+    past.first = 20;
+    CHECK(map->getRange("small", past, value, total) == OpStatus::OK);
+    CHECK(value.empty());
+    CHECK(total == 10);
+
+    HashMap::ByteRange slice;
+    slice.first = 100;
+    slice.length = 50;
+    CHECK(map->getRange("big", slice, value, total) == OpStatus::OK);
+    CHECK(value == big.substr(100, 50));
+    CHECK(total == big.size());
+
+    CHECK(map->getRange("missing", slice, value, total) == OpStatus::NOT_FOUND);
+
+    // Nothing in an empty value can be served: /kv answers 416 "bytes */0".
+    map->setBlocking("empty", "", 0, version);
+    CHECK(map->getRange("empty", tail, value, total) == OpStatus::OK);
+    CHECK(value.empty());
+    CHECK(total == 0);
+    CHECK(!tail.satisfiable(total));
+    CHECK(!middle.satisfiable(0));
+}
+
+static void testSatisfiable()
+{
+    HashMap::ByteRange range;
+    range.first = 9;
+    CHECK(range.satisfiable(10));
+    CHECK(!range.satisfiable(9));
+
+    HashMap::ByteRange suffix;
+    suffix.suffix = true;
+    suffix.length = 5;
+    CHECK(suffix.satisfiable(1));
+    CHECK(!suffix.satisfiable(0));
+    suffix.length = 0;
+    CHECK(!suffix.satisfiable(10));
+}
+
+int main()
+{
+    testSatisfiable();
+    forEachEngine(testRangeReads);
+    return finish();
+}
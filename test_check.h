@@ -0,0 +1,52 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+// Shared by the engine tests (test_*.cpp, run by make test). CHECK records a
+// failure and carries on; main returns finish() as its exit code.
+#include "hash_map_rcu.h"
+#include <iostream>
+
+inline int testFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << "  " << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+            ++testFailures; \
+        } \
+    } while (0)
+
+// Runs `test(config)` once per reclaim and concurrency policy.
+template <typename Test>
+void forEachEngine(Test test)
+{
+    const char *reclaims[] = {"refcount", "epoch"};
+    const char *concurrencies[] = {"lockfree", "striped"};
+    for (const char *reclaim : reclaims) {
+        for (const char *concurrency : concurrencies) {
+            EngineConfig config;
+            config.set("--reclaim", reclaim);
+            config.set("--concurrency", concurrency);
+            int before = testFailures;
+            test(config);
+            std::cout << "  --reclaim " << reclaim << " --concurrency " << concurrency
+                      << (testFailures == before ? ": ok" : ": FAILED") << std::endl;
+        }
+    }
+}
+
+inline std::unique_ptr<HashMap> makeTestMap(const EngineConfig &config = EngineConfig())
+{
+    return makeHashMap(config, "", DEFAULT_MAX_QUEUE_DEPTH);
+}
+
+inline int finish()
+{
+    if (testFailures) {
+        std::cerr << testFailures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#endif
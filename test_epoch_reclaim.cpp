@@ -0,0 +1,82 @@
+// EpochReclaim: a retired node is not freed while a reader that entered
+// before it was retired still holds its guard, and is freed once it lets go.
+//
+// A freed node goes to the collecting thread's slab magazine, whose next
+// allocation of the same size returns that chunk; so "the next new HashNode
+// reuses the address" is how these checks see that a node was freed.
+#include "test_check.h"
+#include <atomic>
+#include <thread>
+
+static bool wasFreed(HashNode *node)
+{
+    HashNode *probe = new HashNode("probe", "", 0, 0);
+    bool reused = probe == node;
+    delete probe;
+    return reused;
+}
+
+// Holds a guard on its own thread from construction until release().
+class Reader
+{
+    public:
+    explicit Reader(EpochReclaim &reclaim) : thread([this, &reclaim] {
+        EpochReclaim::Guard guard(reclaim);
+        entered.store(true);
+        while (!released.load()) std::this_thread::yield();
+    })
+    {
+        while (!entered.load()) std::this_thread::yield();
+    }
+    void release()
+    {
+        released.store(true);
+        thread.join();
+    }
+
+    private:
+    std::atomic<bool> entered{false}, released{false};
+    std::thread thread;
+};
+
+static void testReaderBlocksCollection()
+{
+    EpochReclaim reclaim;
+    Reader reader(reclaim);
+    HashNode *node = new HashNode("key", "value", 0, 1);
+    reclaim.retire(node);
+    for (int i = 0; i < 10; ++i) {
+        reclaim.collect();
+        CHECK(!wasFreed(node));
+    }
+
+    reader.release();
+    reclaim.collect();
+    CHECK(wasFreed(node));
+}
+
+static void testNestedGuard()
+{
+    EpochReclaim reclaim;
+    HashNode *node = new HashNode("key", "value", 0, 1);
+    {
+        EpochReclaim::Guard outer(reclaim);
+        {
+            EpochReclaim::Guard inner(reclaim);
+            reclaim.retire(node);
+        }
+        // Leaving the inner guard must not end the outer one.
+        reclaim.collect();
+        CHECK(!wasFreed(node));
+    }
+    reclaim.collect();
+    CHECK(wasFreed(node));
+}
+
+int main()
+{
+    testReaderBlocksCollection();
+    testNestedGuard();
+    std::cout << "  epoch reclaim: " << (testFailures ? "FAILED" : "ok") << std::endl;
+    return finish();
+}
@@ -0,0 +1,61 @@
+// Change events: a consumer blocked in waitEvent() gets every write another
+// thread makes, promptly, and wakeEventWaiters() releases it.
+#include "test_check.h"
+#include <atomic>
+#include <thread>
+
+const int EVENTS = 300;
+const std::chrono::seconds LONG_WAIT(5);
+
+static void testWaitEvent(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    map->enableEvents(true);
+
+    std::chrono::steady_clock::duration slowest{0};
+    std::vector<std::string> keys;
+    std::thread consumer([&] {
+        ChangeEvent event;
+        while (keys.size() < EVENTS) {
+            auto start = std::chrono::steady_clock::now();
+            if (!map->waitEvent(event, std::chrono::duration_cast<std::chrono::milliseconds>(LONG_WAIT))) break;
+            slowest = std::max(slowest, std::chrono::steady_clock::now() - start);
+            keys.push_back(event.key);
+        }
+    });
+    uint64_t version = 0;
+    for (int i = 0; i < EVENTS; ++i) {
+        map->setBlocking("k" + std::to_string(i), "v", 0, version);
+        // Gaps let the consumer block between events, which is when a
+        // notification can race with it going to sleep.
+        if (i % 3 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    consumer.join();
+
+    CHECK(keys.size() == EVENTS);
+    for (size_t i = 0; i < keys.size(); ++i) CHECK(keys[i] == "k" + std::to_string(i));
+    // A missed notification costs at most a slice, never the whole timeout.
+    CHECK(slowest < LONG_WAIT / 2);
+    CHECK(map->dropped_events() == 0);
+
+    // Only a waiter already inside waitEvent() is woken, so keep waking.
+    std::atomic<bool> woken{false};
+    auto start = std::chrono::steady_clock::now();
+    std::thread waiter([&] {
+        ChangeEvent event;
+        CHECK(!map->waitEvent(event, std::chrono::duration_cast<std::chrono::milliseconds>(LONG_WAIT)));
+        woken.store(true);
+    });
+    while (!woken.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        map->wakeEventWaiters();
+    }
+    waiter.join();
+    CHECK(std::chrono::steady_clock::now() - start < LONG_WAIT / 2);
+}
+
+int main()
+{
+    forEachEngine(testWaitEvent);
+    return finish();
+}
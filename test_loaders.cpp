@@ -0,0 +1,45 @@
+// Read-through loaders: concurrent misses on one key make a single call.
+#include "test_check.h"
+#include <thread>
+#include <vector>
+
+static void testLoaderSingleFlight(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    std::atomic<int> calls(0);
+    map->setLoader("user:", [&calls](const std::string &key, std::string &value, int &ttl) {
+        calls.fetch_add(1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (key == "user:none") return OpStatus::NOT_FOUND;
+        value = "loaded " + key;
+        ttl = 60;
+        return OpStatus::OK;
+    }, 0);
+
+    const int readers = 8;
+    std::vector<std::string> values(readers);
+    std::vector<OpStatus> statuses(readers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; ++i) {
+        threads.emplace_back([&, i] { statuses[i] = map->get("user:1", values[i]); });
+    }
+    for (std::thread &thread : threads) thread.join();
+    CHECK(calls.load() == 1);
+    for (int i = 0; i < readers; ++i) {
+        CHECK(statuses[i] == OpStatus::OK);
+        CHECK(values[i] == "loaded user:1");
+    }
+
+    // The loaded value is cached; other prefixes never reach the loader.
+    std::string value;
+    CHECK(map->get("user:1", value) == OpStatus::OK);
+    CHECK(map->get("other", value) == OpStatus::NOT_FOUND);
+    CHECK(map->get("user:none", value) == OpStatus::NOT_FOUND);
+    CHECK(calls.load() == 2);
+}
+
+int main()
+{
+    forEachEngine(testLoaderSingleFlight);
+    return finish();
+}
@@ -0,0 +1,154 @@
+// MappedHeap images: a written image reads back, and a truncated or damaged
+// one is refused or loses only the damaged entries.
+#include "test_check.h"
+#include "fnv_hash.h"
+#include "mapped_heap.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+// FileHeader layout (mapped_heap.cpp): bucketCount at 16, checksum at 48 over
+// the bytes before it.
+const size_t BUCKET_COUNT_AT = 16;
+const size_t CHECKSUM_AT = 48;
+
+static std::string readFile(const std::string &fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string &fileName, const std::string &bytes)
+{
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+static void resealHeader(std::string &bytes)
+{
+    uint64_t checksum = fnv1a_hash(std::string_view(bytes.data(), CHECKSUM_AT));
+    std::memcpy(&bytes[CHECKSUM_AT], &checksum, sizeof(checksum));
+}
+
+static bool opens(const std::string &fileName, const std::string &expectedError)
+{
+    std::string error;
+    std::unique_ptr<MappedHeap> heap = MappedHeap::open(fileName, error);
+    if (heap) return expectedError.empty();
+    return !expectedError.empty() && error.find(expectedError) != std::string::npos;
+}
+
+static void testRoundTrip(const std::string &fileName)
+{
+    std::vector<std::string> keys, values;
+    for (int i = 0; i < 100; ++i) {
+        keys.push_back("key" + std::to_string(i));
+        values.push_back(std::string(i, 'v'));
+    }
+    std::vector<MappedHeap::Entry> entries;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        entries.push_back({keys[i], values[i], static_cast<time_t>(i), 7, i % 2 == 0, 0});
+    }
+    CHECK(MappedHeap::write(fileName, entries));
+    CHECK(!std::filesystem::exists(fileName + ".tmp"));
+
+    std::string error;
+    std::unique_ptr<MappedHeap> heap = MappedHeap::open(fileName, error);
+    CHECK(heap != nullptr);
+    if (!heap) return;
+    CHECK(heap->entries() == keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        MappedHeap::Entry found;
+        CHECK(heap->find(keys[i], found));
+        CHECK(found.value == values[i]);
+        CHECK(found.expiry == static_cast<time_t>(i));
+        CHECK(found.compressed == (i % 2 == 0));
+    }
+    MappedHeap::Entry found;
+    CHECK(!heap->find("absent", found));
+
+    // Rewriting replaces the image.
+    entries.resize(1);
+    CHECK(MappedHeap::write(fileName, entries));
+    heap = MappedHeap::open(fileName, error);
+    CHECK(heap != nullptr && heap->entries() == 1);
+}
+
+static void testRefused(const std::string &fileName, const std::string &image)
+{
+    CHECK(opens(fileName + ".missing", "cannot open"));
+
+    writeFile(fileName, image.substr(0, 10));
+    CHECK(opens(fileName, "too short"));
+
+    writeFile(fileName, image.substr(0, image.size() - 8));
+    CHECK(opens(fileName, "truncated"));
+    writeFile(fileName, image + std::string(8, '\0'));
+    CHECK(opens(fileName, "truncated"));
+
+    std::string bytes = image;
+    bytes[0] = 'X';
+    writeFile(fileName, bytes);
+    CHECK(opens(fileName, "not a heap image"));
+
+    // A changed field without a matching checksum.
+    bytes = image;
+    bytes[BUCKET_COUNT_AT] ^= 1;
+    writeFile(fileName, bytes);
+    CHECK(opens(fileName, "not a heap image"));
+
+    // Consistent checksums around impossible values.
+    const uint64_t badCounts[] = {0, 3, uint64_t(1) << 40};
+    for (uint64_t count : badCounts) {
+        bytes = image;
+        std::memcpy(&bytes[BUCKET_COUNT_AT], &count, sizeof(count));
+        resealHeader(bytes);
+        writeFile(fileName, bytes);
+        CHECK(opens(fileName, "invalid header"));
+    }
+
+    writeFile(fileName, image);
+    CHECK(opens(fileName, ""));
+}
+
+static void testDamagedEntry(const std::string &fileName)
+{
+    std::vector<MappedHeap::Entry> entries = {
+        {"first", "aaaaaaaa", 0, 0, false, 0},
+        {"second", "bbbbbbbb", 0, 0, false, 0},
+    };
+    CHECK(MappedHeap::write(fileName, entries));
+    std::string bytes = readFile(fileName);
+    size_t at = bytes.find("bbbbbbbb");
+    CHECK(at != std::string::npos);
+    if (at == std::string::npos) return;
+    bytes[at] = 'c';
+    writeFile(fileName, bytes);
+
+    std::string error;
+    std::unique_ptr<MappedHeap> heap = MappedHeap::open(fileName, error);
+    CHECK(heap != nullptr);
+    if (!heap) return;
+    MappedHeap::Entry found;
+    CHECK(heap->find("first", found) && found.value == "aaaaaaaa");
+    CHECK(!heap->find("second", found));
+
+    MappedHeap::Cursor cursor;
+    bool valid = false;
+    int good = 0, bad = 0;
+    while (heap->next(cursor, found, valid)) ++(valid ? good : bad);
+    CHECK(good == 1);
+    CHECK(bad == 1);
+}
+
+int main()
+{
+    const std::string fileName = (std::filesystem::temp_directory_path() / "fastkv_test_heap.img").string();
+    testRoundTrip(fileName);
+    testRefused(fileName, readFile(fileName));
+    testDamagedEntry(fileName);
+    std::filesystem::remove(fileName);
+    std::cout << "  mapped heap: " << (testFailures ? "FAILED" : "ok") << std::endl;
+    return finish();
+}
@@ -0,0 +1,58 @@
+// Near cache: a thread that has a key cached sees every write another thread
+// makes to it.
+#include "test_check.h"
+#include <atomic>
+#include <thread>
+
+const int ROUNDS = 200;
+
+// The reader caches "hot" (and reads it once more, so the next read would be a
+// hit), then hands over to the writer and checks its write on the next read.
+static void testWritesFromAnotherThread(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    map->enableNearCache(64);
+    uint64_t version = 0;
+    map->setBlocking("hot", "v0", 0, version);
+
+    std::atomic<int> written{0}, cached{0};
+    std::thread writer([&] {
+        uint64_t next = 0;
+        int64_t counter = 0;
+        for (int round = 1; round <= ROUNDS; ++round) {
+            while (cached.load(std::memory_order_acquire) < round) std::this_thread::yield();
+            switch (round % 4) {
+            case 0: map->setBlocking("hot", "v" + std::to_string(round), 0, next); break;
+            case 1: map->remove("hot"); break;
+            case 2: map->incrBy("hot", round, counter); break;
+            case 3: map->compareAndSet("hot", 0, "cas" + std::to_string(round), 0, next); break;
+            }
+            // A write to another key must not disturb the cached one.
+            map->setBlocking("other" + std::to_string(round), "x", 0, next);
+            written.store(round, std::memory_order_release);
+        }
+    });
+
+    std::string value;
+    for (int round = 1; round <= ROUNDS; ++round) {
+        map->get("hot", value);
+        map->get("hot", value);
+        cached.store(round, std::memory_order_release);
+        while (written.load(std::memory_order_acquire) < round) std::this_thread::yield();
+
+        OpStatus status = map->get("hot", value);
+        switch (round % 4) {
+        case 0: CHECK(status == OpStatus::OK && value == "v" + std::to_string(round)); break;
+        case 1: CHECK(status == OpStatus::NOT_FOUND); break;
+        case 2: CHECK(status == OpStatus::OK && value == std::to_string(round)); break;
+        case 3: CHECK(status == OpStatus::OK && value == std::to_string(round - 1)); break;
+        }
+    }
+    writer.join();
+}
+
+int main()
+{
+    forEachEngine(testWritesFromAnotherThread);
+    return finish();
+}
@@ -0,0 +1,105 @@
+// Ordered index: prefix and range scans page through exactly the keys a
+// reference set holds, in order, with writes made before and after the index
+// was enabled and from several threads at once.
+#include "test_check.h"
+#include <set>
+#include <thread>
+
+static std::vector<std::string> pagePrefix(HashMap &map, const std::string &prefix, size_t limit)
+{
+    std::vector<std::string> all;
+    std::string after;
+    while (true) {
+        std::vector<std::string> page = map.scanPrefix(prefix, limit, after);
+        CHECK(page.size() <= limit);
+        if (page.empty()) break;
+        all.insert(all.end(), page.begin(), page.end());
+        after = page.back();
+    }
+    return all;
+}
+
+static std::vector<std::string> pageRange(HashMap &map, const std::string &from, const std::string &to, size_t limit)
+{
+    std::vector<std::string> all;
+    std::string after;
+    while (true) {
+        std::vector<std::string> page = map.scanRange(from, to, limit, after);
+        CHECK(page.size() <= limit);
+        if (page.empty()) break;
+        all.insert(all.end(), page.begin(), page.end());
+        after = page.back();
+    }
+    return all;
+}
+
+static std::vector<std::string> withPrefix(const std::set<std::string> &keys, const std::string &prefix)
+{
+    std::vector<std::string> out;
+    for (const std::string &key : keys) {
+        if (key.compare(0, prefix.size(), prefix) == 0) out.push_back(key);
+    }
+    return out;
+}
+
+// [from, to); an empty `to` has no upper bound.
+static std::vector<std::string> inRange(const std::set<std::string> &keys, const std::string &from, const std::string &to)
+{
+    std::vector<std::string> out;
+    for (const std::string &key : keys) {
+        if (key >= from && (to.empty() || key < to)) out.push_back(key);
+    }
+    return out;
+}
+
+static void testScans(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    std::set<std::string> keys;
+    uint64_t version = 0;
+    for (const char *key : {"a", "user", "usex", "user:", "use", "z\xff", "z\xff\xff", "z\xff\xff" "1"}) {
+        map->setBlocking(key, "v", 0, version);
+        keys.insert(key);
+    }
+    // Keys written before the index exists are picked up when it is built.
+    map->enableOrderedIndex();
+    CHECK(map->ordered_index_enabled());
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&map, t] {
+            uint64_t next = 0;
+            for (int i = t; i < 400; i += 4) map->setBlocking("user:" + std::to_string(i), "v", 0, next);
+        });
+    }
+    for (std::thread &writer : writers) writer.join();
+    for (int i = 0; i < 400; ++i) keys.insert("user:" + std::to_string(i));
+    for (int i = 0; i < 400; i += 7) {
+        map->remove("user:" + std::to_string(i));
+        keys.erase("user:" + std::to_string(i));
+    }
+    map->remove("usex");
+    keys.erase("usex");
+    // Overwriting a key leaves it listed once.
+    map->setBlocking("user:1", "w", 0, version);
+
+    for (size_t limit : {1, 7, 1000}) {
+        CHECK(pagePrefix(*map, "user:", limit) == withPrefix(keys, "user:"));
+        CHECK(pagePrefix(*map, "user", limit) == withPrefix(keys, "user"));
+        CHECK(pagePrefix(*map, "z\xff", limit) == withPrefix(keys, "z\xff"));
+        CHECK(pagePrefix(*map, "", limit) == withPrefix(keys, ""));
+        CHECK(pageRange(*map, "a", "user:1", limit) == inRange(keys, "a", "user:1"));
+        CHECK(pageRange(*map, "user:2", "user:3", limit) == inRange(keys, "user:2", "user:3"));
+        CHECK(pageRange(*map, "user:", "", limit) == inRange(keys, "user:", ""));
+        CHECK(pageRange(*map, "", "", limit) == inRange(keys, "", ""));
+    }
+    CHECK(map->scanPrefix("nothing", 10).empty());
+    CHECK(map->scanRange("b", "b", 10).empty());
+    CHECK(map->scanRange("c", "b", 10).empty());
+}
+
+int main()
+{
+    forEachEngine(testScans);
+    return finish();
+}
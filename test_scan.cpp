@@ -0,0 +1,84 @@
+// scan(): a full walk returns every key present for the whole walk, while
+// other threads insert and remove keys around it.
+#include "test_check.h"
+#include <atomic>
+#include <set>
+#include <thread>
+
+// With the 1000 churn keys live at a time, this stays under MAX_CAPACITY so
+// eviction never removes a stable key.
+const int STABLE_KEYS = 1000;
+
+static std::set<std::string> scanAll(HashMap &map, size_t count, size_t &pages)
+{
+    std::set<std::string> seen;
+    uint64_t cursor = 0;
+    pages = 0;
+    do {
+        HashMap::ScanPage page = map.scan(cursor, count);
+        seen.insert(page.keys.begin(), page.keys.end());
+        cursor = page.cursor;
+        ++pages;
+        // Let writers run between pages, as between a client's requests.
+        std::this_thread::yield();
+    } while (cursor != 0 && pages < 1000000);
+    return seen;
+}
+
+static void testEmptyAndSparse(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    size_t pages = 0;
+    CHECK(scanAll(*map, 10, pages).empty());
+    // Empty buckets visited per call are bounded, so a sparse table takes
+    // several calls even with a large count.
+    CHECK(pages > 1);
+
+    uint64_t version = 0;
+    map->setBlocking("only", "v", 0, version);
+    std::set<std::string> seen = scanAll(*map, 1000, pages);
+    CHECK(seen.size() == 1 && seen.count("only") == 1);
+}
+
+static void testConcurrentWrites(const EngineConfig &config)
+{
+    auto map = makeTestMap(config);
+    uint64_t version = 0;
+    for (int i = 0; i < STABLE_KEYS; ++i) map->setBlocking("stable" + std::to_string(i), "v", 0, version);
+
+    std::atomic<bool> scanning{true};
+    std::atomic<int> writes{0};
+    std::thread churn([&] {
+        uint64_t next = 0;
+        for (int i = 0; scanning.load(std::memory_order_relaxed); ++i) {
+            map->setBlocking("churn" + std::to_string(i % 5000), "v", 0, next);
+            if (i >= 1000) map->remove("churn" + std::to_string((i - 1000) % 5000));
+            writes.store(i + 1, std::memory_order_relaxed);
+        }
+    });
+    while (writes.load(std::memory_order_relaxed) < 1000) std::this_thread::yield();
+
+    for (size_t count : {1, 7, 100}) {
+        size_t pages = 0;
+        int writesBefore = writes.load(std::memory_order_relaxed);
+        std::set<std::string> seen = scanAll(*map, count, pages);
+        int missing = 0;
+        for (int i = 0; i < STABLE_KEYS; ++i) missing += seen.count("stable" + std::to_string(i)) == 0;
+        CHECK(missing == 0);
+        for (const std::string &key : seen) CHECK(key.compare(0, 6, "stable") == 0 || key.compare(0, 5, "churn") == 0);
+        CHECK(pages < 1000000);
+        // The walk really did overlap the writes.
+        CHECK(writes.load(std::memory_order_relaxed) > writesBefore);
+    }
+    scanning.store(false, std::memory_order_relaxed);
+    churn.join();
+}
+
+int main()
+{
+    forEachEngine([](const EngineConfig &config) {
+        testEmptyAndSparse(config);
+        testConcurrentWrites(config);
+    });
+    return finish();
+}
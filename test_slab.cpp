@@ -0,0 +1,98 @@
+// Slab allocator: freed chunks are reused, and rebalance() gives empty pages
+// to the pool and the rest back to the system.
+#include "test_check.h"
+#include "slab_allocator.h"
+#include <cstring>
+#include <set>
+#include <thread>
+
+const size_t CHUNK_REQUEST = 10000;
+
+static const Slab::ClassStats* classFor(const Slab::Stats &stats, size_t size)
+{
+    const Slab::ClassStats *best = nullptr;
+    for (const Slab::ClassStats &c : stats.classes) {
+        if (c.chunkSize >= size && (!best || c.chunkSize < best->chunkSize)) best = &c;
+    }
+    return best;
+}
+
+static void testReuse()
+{
+    void *first = Slab::allocate(100);
+    Slab::deallocate(first, 100);
+    // Same class, so the chunk just freed comes straight back.
+    void *again = Slab::allocate(99);
+    CHECK(again == first);
+
+    std::vector<char*> chunks;
+    std::set<char*> distinct;
+    for (int i = 0; i < 1000; ++i) {
+        char *p = static_cast<char*>(Slab::allocate(100));
+        std::memset(p, i & 0xff, 100);
+        chunks.push_back(p);
+        distinct.insert(p);
+    }
+    CHECK(distinct.size() == chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        CHECK(static_cast<unsigned char>(chunks[i][0]) == (i & 0xff) && static_cast<unsigned char>(chunks[i][99]) == (i & 0xff));
+        Slab::deallocate(chunks[i], 100);
+    }
+    Slab::deallocate(again, 99);
+
+    // Above the largest class the heap is used and counted.
+    uint64_t largeBefore = Slab::stats().largeBytes;
+    void *large = Slab::allocate(SLAB_MAX_CHUNK + 1);
+    CHECK(Slab::stats().largeBytes == largeBefore + SLAB_MAX_CHUNK + 1);
+    Slab::deallocate(large, SLAB_MAX_CHUNK + 1);
+    CHECK(Slab::stats().largeBytes == largeBefore);
+}
+
+static void testPageRelease()
+{
+    const size_t pages = SLAB_POOL_PAGES + 6;
+    uint64_t releasedBefore = Slab::stats().pagesReleased;
+
+    // The thread's magazines are flushed when it exits, so afterwards every
+    // chunk it used is back with its class.
+    std::thread worker([pages] {
+        std::vector<void*> chunks;
+        while (true) {
+            chunks.push_back(Slab::allocate(CHUNK_REQUEST));
+            const Slab::ClassStats *c = classFor(Slab::stats(), CHUNK_REQUEST);
+            if (c && c->pages >= pages) break;
+        }
+        const Slab::ClassStats *c = classFor(Slab::stats(), CHUNK_REQUEST);
+        CHECK(c && c->used >= chunks.size());
+        for (void *p : chunks) Slab::deallocate(p, CHUNK_REQUEST);
+    });
+    worker.join();
+
+    Slab::Stats stats = Slab::stats();
+    const Slab::ClassStats *c = classFor(stats, CHUNK_REQUEST);
+    CHECK(c && c->used == 0 && c->pages == pages);
+
+    Slab::rebalance();
+    stats = Slab::stats();
+    c = classFor(stats, CHUNK_REQUEST);
+    // Only the page still being carved stays with the class.
+    CHECK(!c || c->pages <= 1);
+    CHECK(stats.poolPages == SLAB_POOL_PAGES);
+    CHECK(stats.pagesReleased - releasedBefore >= pages - 1 - SLAB_POOL_PAGES);
+
+    // Another class takes its new page from the pool.
+    std::thread other([] {
+        void *p = Slab::allocate(1000);
+        CHECK(Slab::stats().poolPages == SLAB_POOL_PAGES - 1);
+        Slab::deallocate(p, 1000);
+    });
+    other.join();
+}
+
+int main()
+{
+    testReuse();
+    testPageRelease();
+    std::cout << "  slab allocator: " << (testFailures ? "FAILED" : "ok") << std::endl;
+    return finish();
+}
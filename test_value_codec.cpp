@@ -0,0 +1,95 @@
+// ValueCodec: round trips, and corrupt or oversized input fails cleanly.
+#include "test_check.h"
+#include "value_codec.h"
+#include <random>
+
+static std::string sampleText(size_t size)
+{
+    static const char *words[] = {"alpha ", "beta ", "gamma ", "delta ", "{\"id\":", "\"name\":", "null, "};
+    std::mt19937 random(7);
+    std::string text;
+    while (text.size() < size) text += words[random() % 7];
+    text.resize(size);
+    return text;
+}
+
+static std::string randomBytes(size_t size)
+{
+    std::mt19937 random(11);
+    std::string bytes(size, '\0');
+    for (char &c : bytes) c = static_cast<char>(random());
+    return bytes;
+}
+
+static std::string withLength(std::string encoded, uint32_t length)
+{
+    for (size_t i = 0; i < 4; ++i) encoded[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+    return encoded;
+}
+
+static void testRoundTrip()
+{
+    const std::string inputs[] = {
+        sampleText(100), sampleText(70000), std::string(1 << 20, '\0'), std::string(1000, 'a') + randomBytes(1000),
+        std::string("abcabcabcabcabcabcabcabcabcabcabcabcabc"),
+    };
+    for (const std::string &raw : inputs) {
+        std::string encoded, decoded;
+        CHECK(ValueCodec::compress(raw, encoded));
+        CHECK(encoded.size() < raw.size());
+        CHECK(ValueCodec::rawLength(encoded) == raw.size());
+        CHECK(ValueCodec::decompress(encoded, decoded));
+        CHECK(decoded == raw);
+        // The ratio decompress trusts holds for the most compressible input.
+        CHECK(raw.size() <= (encoded.size() - 4) * VALUE_CODEC_MAX_RATIO);
+    }
+
+    std::string encoded;
+    CHECK(!ValueCodec::compress(randomBytes(4096), encoded));
+    CHECK(!ValueCodec::compress("", encoded));
+    CHECK(!ValueCodec::compress("short", encoded));
+}
+
+static void testCorrupt()
+{
+    const std::string raw = sampleText(5000);
+    std::string encoded, decoded;
+    CHECK(ValueCodec::compress(raw, encoded));
+
+    CHECK(!ValueCodec::decompress("", decoded));
+    CHECK(!ValueCodec::decompress(encoded.substr(0, 4), decoded));
+    for (size_t cut = 5; cut < encoded.size(); cut += 7) CHECK(!ValueCodec::decompress(encoded.substr(0, cut), decoded));
+    CHECK(!ValueCodec::decompress(withLength(encoded, raw.size() + 1), decoded));
+    CHECK(!ValueCodec::decompress(withLength(encoded, raw.size() - 1), decoded));
+
+    // Flipped payload bytes must fail or decode to something of the stated
+    // length, never read or write outside the buffers.
+    std::mt19937 random(3);
+    for (int i = 0; i < 2000; ++i) {
+        std::string damaged = encoded;
+        damaged[4 + random() % (damaged.size() - 4)] ^= static_cast<char>(1 + random() % 255);
+        if (ValueCodec::decompress(damaged, decoded)) CHECK(decoded.size() == raw.size());
+    }
+}
+
+static void testOversize()
+{
+    std::string decoded = "untouched";
+    // A tiny payload claiming 4 GB, and a length over the cap.
+    CHECK(!ValueCodec::decompress(withLength(std::string(6, '\0'), UINT32_MAX), decoded));
+    std::string big(VALUE_CODEC_MAX_RAW / VALUE_CODEC_MAX_RATIO + 16, '\0');
+    CHECK(!ValueCodec::decompress(withLength(big, static_cast<uint32_t>(VALUE_CODEC_MAX_RAW + 1)), decoded));
+    CHECK(decoded.size() < 1000);
+
+    std::string encoded;
+    CHECK(!ValueCodec::compress(std::string(VALUE_CODEC_MAX_RAW + 1, 'a'), encoded));
+}
+
+int main()
+{
+    testRoundTrip();
+    testCorrupt();
+    testOversize();
+    std::cout << "  value codec: " << (testFailures ? "FAILED" : "ok") << std::endl;
+    return finish();
+}
@@ -0,0 +1,172 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct Ring {
+    uint32_t thread = 0;
+    // Events written so far; the newest TRACE_RING_CAPACITY are in `slots`.
+    std::atomic<uint64_t> head{0};
+    Trace::Event slots[TRACE_RING_CAPACITY];
+};
+
+// Rings outlive their threads: a ring freed at thread exit is handed to the
+// next thread that samples a request, so the count follows peak concurrency
+// rather than the number of threads ever started.
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::vector<Ring*> idle;
+    std::atomic<uint32_t> sampleRate{DEFAULT_TRACE_SAMPLE};
+    std::atomic<uint64_t> nextTraceId{1};
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    Ring* acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idle.empty()) {
+            Ring* ring = idle.back();
+            idle.pop_back();
+            return ring;
+        }
+        rings.emplace_back(new Ring());
+        rings.back()->thread = static_cast<uint32_t>(rings.size());
+        return rings.back().get();
+    }
+
+    void release(Ring* ring)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(ring);
+    }
+};
+
+// Never destroyed: threads may still record spans during exit.
+Registry& registry()
+{
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+struct RingHolder {
+    Ring* ring = nullptr;
+    ~RingHolder()
+    {
+        if (ring) registry().release(ring);
+    }
+};
+
+thread_local RingHolder holder;
+thread_local uint64_t currentTrace = 0;
+thread_local uint64_t sampleState = 0;
+
+// xorshift64*; seeded per thread from its address and the clock.
+uint64_t nextRandom()
+{
+    if (sampleState == 0) {
+        sampleState = reinterpret_cast<uintptr_t>(&sampleState) ^
+                      static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^ 0x9E3779B97F4A7C15ULL;
+        if (sampleState == 0) sampleState = 1;
+    }
+    sampleState ^= sampleState >> 12;
+    sampleState ^= sampleState << 25;
+    sampleState ^= sampleState >> 27;
+    return sampleState * 0x2545F4914F6CDD1DULL;
+}
+
+}
+
+void Trace::setSampleRate(uint32_t oneIn)
+{
+    registry().sampleRate.store(oneIn, std::memory_order_relaxed);
+}
+
+uint32_t Trace::sample_rate()
+{
+    return registry().sampleRate.load(std::memory_order_relaxed);
+}
+
+uint64_t Trace::now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry().epoch).count());
+}
+
+uint64_t Trace::current()
+{
+    return currentTrace;
+}
+
+uint64_t Trace::begin()
+{
+    uint32_t rate = registry().sampleRate.load(std::memory_order_relaxed);
+    if (rate == 0 || (rate > 1 && nextRandom() % rate != 0)) return 0;
+    return registry().nextTraceId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Trace::record(const char *name, uint64_t startNs, uint64_t endNs, const char *argName, int64_t arg)
+{
+    if (currentTrace == 0) return;
+    if (!holder.ring) holder.ring = registry().acquire();
+    Ring* ring = holder.ring;
+    uint64_t index = ring->head.load(std::memory_order_relaxed);
+    Event& e = ring->slots[index % TRACE_RING_CAPACITY];
+    e.name = name;
+    e.traceId = currentTrace;
+    e.startNs = startNs;
+    e.durationNs = endNs > startNs ? endNs - startNs : 0;
+    e.thread = ring->thread;
+    e.argName = argName;
+    e.arg = arg;
+    ring->head.store(index + 1, std::memory_order_release);
+}
+
+// Reads each ring like a seqlock: copy what the head says is there, then
+// re-read the head and keep only slots the writer cannot have reached since.
+std::vector<Trace::Event> Trace::collect(uint64_t seconds)
+{
+    Registry& r = registry();
+    uint64_t end = now();
+    uint64_t window = seconds * 1000000000ULL;
+    uint64_t cutoff = end > window ? end - window : 0;
+
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (const auto& ring : r.rings) rings.push_back(ring.get());
+    }
+
+    std::vector<Event> events;
+    std::vector<Event> copy;
+    for (Ring* ring : rings) {
+        uint64_t before = ring->head.load(std::memory_order_acquire);
+        uint64_t first = before > TRACE_RING_CAPACITY ? before - TRACE_RING_CAPACITY : 0;
+        copy.clear();
+        for (uint64_t i = first; i < before; ++i) copy.push_back(ring->slots[i % TRACE_RING_CAPACITY]);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = ring->head.load(std::memory_order_relaxed);
+        // The writer may already be filling slot `after`, which holds event
+        // after - TRACE_RING_CAPACITY, so that one is not trusted either.
+        uint64_t intact = after + 1 > TRACE_RING_CAPACITY ? after + 1 - TRACE_RING_CAPACITY : 0;
+        for (uint64_t i = std::max(first, intact); i < before; ++i) {
+            const Event& e = copy[i - first];
+            if (e.startNs >= cutoff) events.push_back(e);
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.startNs < b.startNs; });
+    return events;
+}
+
+Trace::Scope::Scope(uint64_t id) : previous(currentTrace)
+{
+    currentTrace = id;
+}
+
+Trace::Scope::~Scope()
+{
+    currentTrace = previous;
+}
@@ -0,0 +1,88 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const size_t TRACE_RING_CAPACITY = 4096;
+const uint32_t DEFAULT_TRACE_SAMPLE = 100;
+
+// Sampled request tracing. A request that wins the 1-in-N draw gets a trace
+// id; spans recorded while it is current on a thread (and on the worker that
+// runs its queued task) go to that thread's ring buffer. Unsampled requests
+// pay for the draw and a thread-local check per span, nothing else.
+//
+// Each ring has a single writer and is read without locks: collect() copies
+// a ring and then drops whatever the writer may have overwritten meanwhile.
+class Trace
+{
+    public:
+    struct Event {
+        const char *name;       // string literal
+        uint64_t traceId;
+        uint64_t startNs;       // since the process started tracing
+        uint64_t durationNs;
+        uint32_t thread;        // small number per thread, stable while it lives
+        const char *argName;    // optional argument; nullptr if none
+        int64_t arg;
+    };
+
+    // One request in `oneIn` is traced; 0 turns tracing off.
+    static void setSampleRate(uint32_t oneIn);
+    static uint32_t sample_rate();
+    static uint64_t now();
+    // Trace id of the request being handled on this thread, 0 if unsampled.
+    static uint64_t current();
+    // A new trace id if this request is sampled, else 0.
+    static uint64_t begin();
+    static void record(const char *name, uint64_t startNs, uint64_t endNs, const char *argName = nullptr, int64_t arg = 0);
+    // Events that started within the last `seconds`, oldest first.
+    static std::vector<Event> collect(uint64_t seconds);
+
+    // Makes `id` this thread's current trace until the scope ends.
+    class Scope
+    {
+        private:
+        uint64_t previous;
+
+        public:
+        explicit Scope(uint64_t id);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // Times its own lifetime, or up to end(), if the current request is sampled.
+    class Span
+    {
+        private:
+        const char *name;
+        bool active;
+        uint64_t start = 0;
+        const char *argName = nullptr;
+        int64_t arg = 0;
+
+        public:
+        explicit Span(const char *spanName) : name(spanName), active(current() != 0)
+        {
+            if (active) start = now();
+        }
+        ~Span() { end(); }
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+        void setArg(const char *nameOfArg, int64_t value)
+        {
+            argName = nameOfArg;
+            arg = value;
+        }
+        void end()
+        {
+            if (!active) return;
+            record(name, start, now(), argName, arg);
+            active = false;
+        }
+    };
+};
+
+#endif
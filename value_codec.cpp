@@ -0,0 +1,160 @@
+#include "value_codec.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+const size_t HEADER_SIZE = 4;
+const size_t MIN_MATCH = 4;
+// LZ4 block rules: the last 5 bytes are always literals and no match starts
+// within the last 12.
+const size_t LAST_LITERALS = 5;
+const size_t MATCH_START_LIMIT = 12;
+const size_t MAX_OFFSET = 65535;
+const int HASH_BITS = 12;
+
+static uint32_t read32(const unsigned char* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hashSequence(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void writeLength(std::string& out, size_t length)
+{
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+static void writeSequence(std::string& out, const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    size_t matchCode = matchLength - MIN_MATCH;
+    unsigned char token = static_cast<unsigned char>(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+    out.push_back(static_cast<char>(token));
+    if (literalLength >= 15) writeLength(out, literalLength - 15);
+    out.append(reinterpret_cast<const char*>(literals), literalLength);
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15) writeLength(out, matchCode - 15);
+}
+
+bool ValueCodec::compress(std::string_view raw, std::string& out)
+{
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(raw.data());
+    const size_t n = raw.size();
+    if (n > VALUE_CODEC_MAX_RAW) return false;
+
+    out.clear();
+    out.reserve(n);
+    for (size_t i = 0; i < HEADER_SIZE; ++i) out.push_back(static_cast<char>((n >> (8 * i)) & 0xff));
+
+    size_t anchor = 0;
+    if (n > MATCH_START_LIMIT) {
+        // Positions are stored plus one so that 0 means "empty".
+        uint32_t table[1 << HASH_BITS] = {};
+        size_t i = 0;
+        const size_t limit = n - MATCH_START_LIMIT;
+        while (i < limit) {
+            uint32_t sequence = read32(in + i);
+            uint32_t& slot = table[hashSequence(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(i + 1);
+            if (candidate == 0 || i - (candidate - 1) > MAX_OFFSET || read32(in + candidate - 1) != sequence) {
+                ++i;
+                continue;
+            }
+
+            size_t ref = candidate - 1;
+            while (i > anchor && ref > 0 && in[i - 1] == in[ref - 1]) {
+                --i;
+                --ref;
+            }
+            size_t length = MIN_MATCH;
+            const size_t maxLength = n - LAST_LITERALS - i;
+            while (length < maxLength && in[i + length] == in[ref + length]) ++length;
+
+            writeSequence(out, in + anchor, i - anchor, i - ref, length);
+            i += length;
+            anchor = i;
+            if (out.size() >= n) return false;
+        }
+    }
+
+    size_t literalLength = n - anchor;
+    out.push_back(static_cast<char>((literalLength < 15 ? literalLength : 15) << 4));
+    if (literalLength >= 15) writeLength(out, literalLength - 15);
+    out.append(reinterpret_cast<const char*>(in + anchor), literalLength);
+    return out.size() < n;
+}
+
+size_t ValueCodec::rawLength(std::string_view encoded)
+{
+    if (encoded.size() < HEADER_SIZE) return 0;
+    size_t n = 0;
+    for (size_t i = 0; i < HEADER_SIZE; ++i) n |= static_cast<size_t>(static_cast<unsigned char>(encoded[i])) << (8 * i);
+    return n;
+}
+
+// Every read and copy is bounds-checked, so a corrupt payload fails instead
+// of touching memory outside either buffer.
+bool ValueCodec::decompress(std::string_view encoded, std::string& out)
+{
+    if (encoded.size() < HEADER_SIZE + 1) return false;
+    const size_t n = rawLength(encoded);
+    if (n > VALUE_CODEC_MAX_RAW || n > (encoded.size() - HEADER_SIZE) * VALUE_CODEC_MAX_RATIO) return false;
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(encoded.data());
+    const unsigned char* const end = in + encoded.size();
+    in += HEADER_SIZE;
+
+    out.resize(n);
+    char* dst = n ? &out[0] : nullptr;
+    size_t pos = 0;
+
+    auto readLength = [&](size_t& length) {
+        unsigned char byte;
+        do {
+            if (in >= end) return false;
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (in < end) {
+        unsigned char token = *in++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(literalLength)) return false;
+        if (literalLength > static_cast<size_t>(end - in) || literalLength > n - pos) return false;
+        std::memcpy(dst + pos, in, literalLength);
+        in += literalLength;
+        pos += literalLength;
+        if (in == end) break;   // the final sequence has no match
+
+        if (end - in < 2) return false;
+        size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+        size_t matchLength = token & 0x0f;
+        if (matchLength == 15 && !readLength(matchLength)) return false;
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > pos || matchLength > n - pos) return false;
+        // The source may overlap the bytes being written; copying in chunks no
+        // longer than the gap replicates the pattern, and the gap doubles each time.
+        const char* src = dst + pos - offset;
+        char* cursor = dst + pos;
+        for (size_t left = matchLength; left > 0;) {
+            size_t chunk = std::min(left, static_cast<size_t>(cursor - src));
+            std::memcpy(cursor, src, chunk);
+            cursor += chunk;
+            left -= chunk;
+        }
+        pos += matchLength;
+    }
+    return pos == n;
+}
@@ -0,0 +1,32 @@
+#ifndef VALUE_CODEC_H
+#define VALUE_CODEC_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Fast byte-oriented compression for stored values. The payload is an LZ4
+// block (literal runs and 64 KB back-references, no entropy coding) preceded
+// by the decoded length as 4 little-endian bytes, so a reader can size its
+// buffer before decoding.
+
+// Longer values are not compressed, and decompress refuses a header claiming
+// more, so a corrupt length cannot make it allocate more than this.
+const size_t VALUE_CODEC_MAX_RAW = size_t(256) << 20;
+// No LZ4 block decodes to more than 255 bytes per encoded byte.
+const size_t VALUE_CODEC_MAX_RATIO = 255;
+
+class ValueCodec
+{
+    public:
+    // Writes the encoded form of `raw` to `out`. Returns false, leaving `out`
+    // unspecified, if that would not be smaller than `raw`.
+    static bool compress(std::string_view raw, std::string& out);
+    // Replaces `out` with the decoded bytes. False if `encoded` is malformed,
+    // including a length its payload could not decode to.
+    static bool decompress(std::string_view encoded, std::string& out);
+    // Decoded length from the header, or 0 if `encoded` is too short.
+    static size_t rawLength(std::string_view encoded);
+};
+
+#endif
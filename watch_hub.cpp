@@ -0,0 +1,94 @@
+#include "watch_hub.h"
+#include <algorithm>
+#include <chrono>
+
+// The destructor wakes the dispatcher; the timeout only bounds a stop that
+// races with it going to sleep.
+const std::chrono::milliseconds WATCH_IDLE_WAIT(1000);
+
+static const char* eventName(ChangeEvent::Type type)
+{
+    switch (type) {
+        case ChangeEvent::Type::SET: return "set";
+        case ChangeEvent::Type::REMOVE: return "remove";
+        case ChangeEvent::Type::EXPIRE: return "expire";
+        case ChangeEvent::Type::EVICT: return "evict";
+    }
+    return "unknown";
+}
+
+WatchHub::WatchHub(HashMap& map) : hashmap(map), running(true)
+{
+    dispatcherThread = std::thread(&WatchHub::dispatch, this);
+}
+
+WatchHub::~WatchHub()
+{
+    running = false;
+    hashmap.wakeEventWaiters();
+    if (dispatcherThread.joinable()) dispatcherThread.join();
+    hashmap.enableEvents(false);
+}
+
+void WatchHub::onOpen(crow::websocket::connection& conn)
+{
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    subscribers[&conn];
+    hashmap.enableEvents(true);
+}
+
+void WatchHub::onClose(crow::websocket::connection& conn)
+{
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    subscribers.erase(&conn);
+    if (subscribers.empty()) hashmap.enableEvents(false);
+}
+
+void WatchHub::onMessage(crow::websocket::connection& conn, const std::string& data)
+{
+    auto msg = crow::json::load(data);
+    if (!msg || !msg.has("op")) {
+        conn.send_text("{\"error\":\"invalid message\"}");
+        return;
+    }
+    std::string op = msg["op"].s();
+    bool subscribe = op == "subscribe";
+    if (!subscribe && op != "unsubscribe") {
+        conn.send_text("{\"error\":\"unknown op\"}");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    Subscription& sub = subscribers[&conn];
+    auto update = [subscribe](std::vector<std::string>& list, const std::string& value) {
+        auto it = std::find(list.begin(), list.end(), value);
+        if (subscribe && it == list.end()) list.push_back(value);
+        if (!subscribe && it != list.end()) list.erase(it);
+    };
+    if (msg.has("key")) update(sub.keys, msg["key"].s());
+    if (msg.has("prefix")) update(sub.prefixes, msg["prefix"].s());
+}
+
+void WatchHub::dispatch()
+{
+    ChangeEvent event;
+    while (running.load(std::memory_order_relaxed)) {
+        if (!hashmap.waitEvent(event, WATCH_IDLE_WAIT)) continue;
+
+        crow::json::wvalue msg;
+        msg["event"] = eventName(event.type);
+        msg["key"] = event.key;
+        if (event.type == ChangeEvent::Type::SET) msg["version"] = event.version;
+        std::string payload = msg.dump();
+
+        std::lock_guard<std::mutex> lock(subscribersMutex);
+        for (auto& entry : subscribers) {
+            const Subscription& sub = entry.second;
+            bool match = std::find(sub.keys.begin(), sub.keys.end(), event.key) != sub.keys.end();
+            for (size_t i = 0; !match && i < sub.prefixes.size(); ++i) {
+                match = event.key.compare(0, sub.prefixes[i].size(), sub.prefixes[i]) == 0;
+            }
+            if (match) entry.first->send_text(payload);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef WATCH_HUB_H
+#define WATCH_HUB_H
+
+#include "crow.h"
+#include "hash_map_rcu.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Fans change events out to /watch WebSocket subscribers. A single dispatcher
+// thread drains the engine's event ring, so writers never wait on clients.
+class WatchHub
+{
+    private:
+    struct Subscription {
+        std::vector<std::string> keys;
+        std::vector<std::string> prefixes;
+    };
+
+    HashMap& hashmap;
+    std::unordered_map<crow::websocket::connection*, Subscription> subscribers;
+    std::mutex subscribersMutex;
+
+    std::atomic<bool> running;
+    std::thread dispatcherThread;
+    void dispatch();
+
+    public:
+    explicit WatchHub(HashMap& map);
+    ~WatchHub();
+
+    void onOpen(crow::websocket::connection& conn);
+    void onClose(crow::websocket::connection& conn);
+    // Messages: {"op":"subscribe"|"unsubscribe","key":"..."} or {...,"prefix":"..."}
+    void onMessage(crow::websocket::connection& conn, const std::string& data);
+};
+
+#endif
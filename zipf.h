@@ -0,0 +1,49 @@
+#ifndef ZIPF_H
+#define ZIPF_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+
+// Zipfian integers in [0, n) with index 0 the most popular, following Gray et
+// al. ("Quickly generating billion-record synthetic databases"), the generator
+// YCSB uses. theta must be in (0, 1). Construction is O(n); copies are cheap,
+// so build one and copy it into each thread.
+class ZipfianGenerator
+{
+    private:
+    size_t n;
+    double theta;
+    double zetan;
+    double alpha;
+    double eta;
+    std::uniform_real_distribution<double> unit;
+
+    static double zeta(size_t count, double theta)
+    {
+        double sum = 0;
+        for (size_t i = 1; i <= count; ++i) sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        return sum;
+    }
+
+    public:
+    ZipfianGenerator(size_t n, double theta = 0.99)
+        : n(std::max<size_t>(n, 1)), theta(theta), zetan(zeta(this->n, theta)), alpha(1.0 / (1.0 - theta)),
+          eta((1.0 - std::pow(2.0 / this->n, 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan)), unit(0.0, 1.0)
+    {
+    }
+
+    template <typename Rng>
+    size_t next(Rng& rng)
+    {
+        double u = unit(rng);
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta)) return std::min<size_t>(1, n - 1);
+        size_t idx = static_cast<size_t>(n * std::pow(eta * u - eta + 1.0, alpha));
+        return std::min(idx, n - 1);
+    }
+};
+
+#endif